@@ -18,18 +18,60 @@ local Hooks = require("Hooks")
 
 local Base = {}
 
+-- Event tables are reused, so that answering pings doesn't leave garbage behind for every one of them. An event belongs
+-- to its hooks until the last of them returns, waits included. After that it is cleared and handed to the next one, so
+-- a hook that wants anything from it later has to copy the fields it needs. Touching an event while it waits in the
+-- pool raises an error, so that a hook that keeps one around finds out, instead of quietly reading nil.
+local eventPool = {}
+local maxPooledEvents = 32
+
+local releasedEvent = {}
+local function useReleasedEvent()
+    error("this event was released once its hooks returned, copy the fields you need from it instead", 2)
+end
+releasedEvent.__index = useReleasedEvent
+releasedEvent.__newindex = useReleasedEvent
+
+local function acquireEvent()
+    local count = #eventPool
+    if count == 0 then
+        return {}
+    end
+
+    local event = eventPool[count]
+    eventPool[count] = nil
+    return setmetatable(event, nil)
+end
+
+local function releaseEvent(event)
+    for key in pairs(event) do
+        event[key] = nil
+    end
+
+    -- Events that don't fit in the pool are released too, as hooks can't tell which ones will
+    setmetatable(event, releasedEvent)
+    if #eventPool < maxPooledEvents then
+        eventPool[#eventPool + 1] = event
+    end
+end
+
 function Base.onRequestStatus(client)
-    local event = {}
+    local event = acquireEvent()
     event.client = client
     Hooks.publish("requestStatus", event)
-    return event.responseData or {description = {text = "A Minecraft Server"}}
+    -- Every plugin has its own copy of Base, so the server picks between their responses, and has its own default,
+    -- which it only encodes once
+    local responseData = event.responseData
+    releaseEvent(event)
+    return responseData
 end
 
 function Base.onRequestLogin(client, username)
-    local event = {}
+    local event = acquireEvent()
     event.client = client
     event.username = username
     Hooks.publish("requestLogin", event)
+    releaseEvent(event)
 end
 
 return Base
@@ -9,10 +9,10 @@
     if you do.
  --]]
 
+-- Subscriptions are kept by the server itself, so that it can tell nobody is listening for an event and not call into
+-- Lua for it at all.
 local Hooks = {}
 
-local hookMap = {}
-
 function Hooks.add(name, func)
     if type(name) ~= "string" then
         error("expected 'string' for argument #1, but got " .. type(name))
@@ -22,12 +22,7 @@ function Hooks.add(name, func)
         error("expected 'function' for argument #2, but got " .. type(func))
     end
 
-    local hookFuncs = hookMap[name]
-    if hookFuncs == nil then
-        hookFuncs = {}
-        hookMap[name] = hookFuncs
-    end
-    table.insert(hookFuncs, func)
+    NativeHooks.add(name, func)
 end
 
 function Hooks.remove(name, func)
@@ -39,22 +34,22 @@ function Hooks.remove(name, func)
         error("expected 'function' for argument #2, but got '" .. type(func) .. "'")
     end
 
-    local hookFuncs = hookMap[name]
-    if hookFuncs == nil then
-        error("invalid hook " .. name)
-    end
-
-    table.remove(hookFuncs, func)
+    NativeHooks.remove(name, func)
 end
 
+-- Runs in the coroutine of the event being published, so hooks may wait on things like sleep() and Backend.ping(). The
+-- functions are a copy, so hooks can add and remove hooks while they run.
+--
+-- Each hook is called with an instruction budget of its own, and its error is logged without stopping the hooks after
+-- it. A hook that runs past its budget can't catch that error with pcall, as it is raised again until the hook returns.
+--
+-- The event tables Base publishes are reused once every hook has returned, so hooks must not keep them around.
 function Hooks.publish(name, ...)
-    if hookMap[name] == nil then
-        hookMap[name] = {}
-        return
-    end
-    for k, f in pairs(hookMap[name]) do
-        f(...)
+    for _, func in ipairs(NativeHooks.functions(name)) do
+        NativeHooks.call(name, func, ...)
     end
 end
 
+Hooks.subscribers = NativeHooks.subscribers
+
 return Hooks
@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2021, James Puleo <james@jame.xyz>
+ *
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#pragma once
+
+#include <AK/Format.h>
+#include <AK/StringView.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+// What the benchmarks have in common. Each one runs what it measures a fixed number of times after warming up, and
+// prints the average, so the numbers from before and after a change can be compared on the same machine.
+namespace Benchmark
+{
+// Keeps the compiler from optimizing away work whose result is never used
+template<typename T>
+ALWAYS_INLINE void do_not_optimize(const T& value)
+{
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+// The same clock as the server's, kept here so that benchmarks of the libraries don't depend on the server
+inline u64 monotonic_nanoseconds()
+{
+    timespec now{};
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return static_cast<u64>(now.tv_sec) * 1'000'000'000 + now.tv_nsec;
+}
+
+// Adds up the time spent between start() and stop(), over many laps
+class Stopwatch
+{
+public:
+    void start() { m_started_at = monotonic_nanoseconds(); }
+
+    void stop()
+    {
+        m_total_nanoseconds += monotonic_nanoseconds() - m_started_at;
+        m_laps++;
+    }
+
+    u64 total_nanoseconds() const { return m_total_nanoseconds; }
+    double average_microseconds() const { return m_laps == 0 ? 0 : m_total_nanoseconds / 1000.0 / m_laps; }
+
+private:
+    u64 m_started_at{};
+    u64 m_total_nanoseconds{};
+    size_t m_laps{};
+};
+
+// Runs the callback once to warm up, then the given number of times, and prints and returns the average time a run took
+// in microseconds
+template<typename Callback>
+double run(StringView name, size_t iterations, Callback callback)
+{
+    callback();
+
+    Stopwatch stopwatch;
+    stopwatch.start();
+    for (size_t i = 0; i < iterations; i++)
+        callback();
+    stopwatch.stop();
+
+    auto average_microseconds = stopwatch.total_nanoseconds() / 1000.0 / iterations;
+    outln("  {:<48} {:>12.3}us", name, average_microseconds);
+    return average_microseconds;
+}
+
+inline void print_speedup(StringView name, double baseline_microseconds, double microseconds)
+{
+    outln("  {:<48} {:>12.2}x", name, microseconds == 0 ? 0 : baseline_microseconds / microseconds);
+}
+
+// Runs the callback in a child process, and returns the most memory the child had resident, in KiB. Each measurement
+// gets a fresh process, so that what one allocated doesn't count towards the next.
+template<typename Callback>
+long peak_resident_kilobytes(Callback callback)
+{
+    auto pid = fork();
+    if (pid < 0)
+    {
+        perror("fork");
+        return -1;
+    }
+
+    if (pid == 0)
+    {
+        callback();
+        _exit(0);
+    }
+
+    int status;
+    rusage usage{};
+    if (wait4(pid, &status, 0, &usage) < 0)
+    {
+        perror("wait4");
+        return -1;
+    }
+
+    return usage.ru_maxrss;
+}
+}
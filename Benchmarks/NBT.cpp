@@ -0,0 +1,414 @@
+/*
+ * Copyright (c) 2021, James Puleo <james@jame.xyz>
+ *
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#include <AK/MemoryStream.h>
+#include <Benchmarks/Benchmark.h>
+#include <LibCompress/Gzip.h>
+#include <LibCore/File.h>
+#include <LibMinecraft/NBT/ByteSwap.h>
+#include <LibMinecraft/NBT/CompressedOutputStream.h>
+#include <LibMinecraft/NBT/Document.h>
+#include <LibMinecraft/NBT/Index.h>
+#include <LibMinecraft/NBT/Value.h>
+#include <LibMinecraft/NBT/Writer.h>
+#include <LibMinecraft/SpongeSchematic.h>
+
+using namespace Minecraft;
+
+// Benchmarks for the ways we have of reading and writing NBT. Give it a schematic (or any other NBT file, compressed or
+// not) to measure with real data, otherwise it makes up a schematic of its own:
+//
+//     NBTBenchmark [file.schem]
+
+static constexpr size_t iterations = 20;
+
+// A Sponge schematic with a palette, a cube of block data, and block entities with nested compounds, which is about the
+// shape of what we usually parse
+static ByteBuffer make_schematic()
+{
+    constexpr i16 size = 96;
+    constexpr i32 palette_size = 100;
+    constexpr size_t block_entity_count = 4000;
+
+    auto* palette = new NBT::Value::Compound;
+    for (i32 i = 0; i < palette_size; i++)
+        palette->set(String::formatted("minecraft:block_{}[facing=north,powered=false]", i), BigEndian<i32>(i));
+
+    Vector<i8> block_data;
+    block_data.ensure_capacity(size * size * size);
+    for (size_t i = 0; i < static_cast<size_t>(size * size * size); i++)
+        block_data.unchecked_append(static_cast<i8>((i * 31) % palette_size));
+
+    auto* block_entities = new NBT::Value::List;
+    for (size_t i = 0; i < block_entity_count; i++)
+    {
+        auto* item = new NBT::Value::Compound;
+        item->set("id", String("minecraft:diamond"));
+        item->set("Count", static_cast<i8>(64));
+        item->set("Slot", static_cast<i8>(i % 27));
+
+        auto* items = new NBT::Value::List;
+        items->append(NBT::Value(move(item)));
+
+        auto* block_entity = new NBT::Value::Compound;
+        block_entity->set("Id", String("minecraft:chest"));
+        block_entity->set("Pos", Vector<i32>{static_cast<i32>(i % size), static_cast<i32>(i / size % size), 0});
+        block_entity->set("Items", NBT::Value(move(items)));
+        block_entities->append(NBT::Value(move(block_entity)));
+    }
+
+    auto* root = new NBT::Value::Compound;
+    root->set("Version", BigEndian<i32>(2));
+    root->set("DataVersion", BigEndian<i32>(2730));
+    root->set("Width", BigEndian<i16>(size));
+    root->set("Height", BigEndian<i16>(size));
+    root->set("Length", BigEndian<i16>(size));
+    root->set("PaletteMax", BigEndian<i32>(palette_size));
+    root->set("Palette", NBT::Value(move(palette)));
+    root->set("BlockData", move(block_data));
+    root->set("BlockEntities", NBT::Value(move(block_entities)));
+
+    return NBT::Writer::encode("Schematic", NBT::Value(move(root))).release_value();
+}
+
+static Optional<ByteBuffer> read_file(const char* path)
+{
+    auto file = Core::File::construct(path);
+    if (!file->open(Core::OpenMode::ReadOnly))
+    {
+        warnln("Unable to open {}: {}", path, file->error_string());
+        return {};
+    }
+
+    auto contents = file->read_all();
+    if (!Compress::GzipDecompressor::is_likely_compressed(contents))
+        return contents;
+
+    auto decompressed = Compress::GzipDecompressor::decompress_all(contents);
+    if (!decompressed.has_value())
+        warnln("Unable to decompress {}", path);
+    return decompressed;
+}
+
+// Value allocates every node, key and array on its own, where a Document puts them all in one arena
+static void benchmark_documents(ReadonlyBytes nbt)
+{
+    outln("Parsing into a tree of Values, and into an arena allocated Document:");
+
+    Benchmark::Stopwatch value_parse;
+    Benchmark::Stopwatch value_destroy;
+    Benchmark::Stopwatch document_parse;
+    Benchmark::Stopwatch document_destroy;
+
+    for (size_t i = 0; i < iterations; i++)
+    {
+        InputMemoryStream stream(nbt);
+        value_parse.start();
+        auto maybe_value = NBT::Value::try_parse(stream);
+        value_parse.stop();
+        VERIFY(!maybe_value.is_error());
+
+        auto* value = new NBT::Value(maybe_value.release_value());
+        value_destroy.start();
+        delete value;
+        value_destroy.stop();
+
+        document_parse.start();
+        auto maybe_document = NBT::Document::parse(nbt);
+        document_parse.stop();
+        VERIFY(!maybe_document.is_error());
+
+        auto* document = maybe_document.release_value().leak_ptr();
+        document_destroy.start();
+        delete document;
+        document_destroy.stop();
+    }
+
+    auto value_peak = Benchmark::peak_resident_kilobytes([&] {
+        InputMemoryStream stream(nbt);
+        auto value = NBT::Value::try_parse(stream);
+        Benchmark::do_not_optimize(value);
+    });
+    auto document_peak = Benchmark::peak_resident_kilobytes([&] {
+        auto document = NBT::Document::parse(nbt);
+        Benchmark::do_not_optimize(document);
+    });
+
+    outln("  {:<20} {:>14} {:>14} {:>16}", "", "parse", "destroy", "peak resident");
+    outln("  {:<20} {:>12.1}us {:>12.1}us {:>12} KiB", "Value", value_parse.average_microseconds(),
+          value_destroy.average_microseconds(), value_peak);
+    outln("  {:<20} {:>12.1}us {:>12.1}us {:>12} KiB", "Document", document_parse.average_microseconds(),
+          document_destroy.average_microseconds(), document_peak);
+}
+
+// How arrays were read before they were read in bulk, one element at a time through the stream
+template<typename T>
+static Vector<T> read_array_per_element(InputStream& stream, size_t length)
+{
+    Vector<T> values;
+    values.ensure_capacity(length);
+    BigEndian<T> value;
+    for (size_t i = 0; i < length; i++)
+    {
+        stream >> value;
+        values.unchecked_append(value);
+    }
+    return values;
+}
+
+template<typename T>
+static Vector<T> read_array_in_bulk(InputStream& stream, size_t length)
+{
+    Vector<T> values;
+    values.resize(length);
+    stream.read_or_error({values.data(), values.size() * sizeof(T)});
+    convert_between_host_and_big_endian(values.span());
+    return values;
+}
+
+// Block states and heightmaps are stored as long arrays, and light as byte arrays, which make up most of a chunk
+static void benchmark_arrays()
+{
+    constexpr size_t element_count = 1 << 20;
+
+    outln("Reading a LongArray and an IntArray of {} elements each:", element_count);
+
+    auto longs = ByteBuffer::create_uninitialized(element_count * sizeof(i64));
+    auto ints = ByteBuffer::create_uninitialized(element_count * sizeof(i32));
+    for (size_t i = 0; i < element_count; i++)
+    {
+        BigEndian<i64> long_value = i * 0x9e3779b97f4a7c15;
+        BigEndian<i32> int_value = i * 0x9e3779b9;
+        __builtin_memcpy(longs.data() + i * sizeof(i64), &long_value, sizeof(i64));
+        __builtin_memcpy(ints.data() + i * sizeof(i32), &int_value, sizeof(i32));
+    }
+
+    auto per_element = Benchmark::run("LongArray, per element", iterations, [&] {
+        InputMemoryStream stream(longs);
+        Benchmark::do_not_optimize(read_array_per_element<i64>(stream, element_count));
+    });
+    auto in_bulk = Benchmark::run("LongArray, in bulk and byte swapped", iterations, [&] {
+        InputMemoryStream stream(longs);
+        Benchmark::do_not_optimize(read_array_in_bulk<i64>(stream, element_count));
+    });
+    Benchmark::print_speedup("LongArray speedup", per_element, in_bulk);
+
+    per_element = Benchmark::run("IntArray, per element", iterations, [&] {
+        InputMemoryStream stream(ints);
+        Benchmark::do_not_optimize(read_array_per_element<i32>(stream, element_count));
+    });
+    in_bulk = Benchmark::run("IntArray, in bulk and byte swapped", iterations, [&] {
+        InputMemoryStream stream(ints);
+        Benchmark::do_not_optimize(read_array_in_bulk<i32>(stream, element_count));
+    });
+    Benchmark::print_speedup("IntArray speedup", per_element, in_bulk);
+
+    // A whole document of arrays, as a Document that copies them, and one that borrows them from the buffer
+    auto* root = new NBT::Value::Compound;
+    for (size_t i = 0; i < 16; i++)
+    {
+        Vector<i64> section_states;
+        section_states.resize(element_count / 16);
+        root->set(String::formatted("BlockStates{}", i), move(section_states));
+    }
+    auto document_bytes = NBT::Writer::encode("", NBT::Value(move(root))).release_value();
+
+    Benchmark::run("Value::try_parse", iterations, [&] {
+        InputMemoryStream stream(document_bytes);
+        Benchmark::do_not_optimize(NBT::Value::try_parse(stream));
+    });
+    auto copied = Benchmark::run("Document::parse, copying arrays", iterations, [&] {
+        Benchmark::do_not_optimize(NBT::Document::parse(document_bytes, NBT::Document::ArrayStorage::Copy));
+    });
+    auto borrowed = Benchmark::run("Document::parse, borrowing arrays", iterations, [&] {
+        Benchmark::do_not_optimize(NBT::Document::parse(document_bytes, NBT::Document::ArrayStorage::Borrow));
+    });
+    Benchmark::print_speedup("Borrowing speedup", copied, borrowed);
+}
+
+// Throws away what is written to it, so we only measure what it took to produce
+class DiscardingOutputStream final : public OutputStream
+{
+public:
+    size_t write(ReadonlyBytes bytes) override
+    {
+        m_size += bytes.size();
+        return bytes.size();
+    }
+
+    bool write_or_error(ReadonlyBytes bytes) override
+    {
+        write(bytes);
+        return true;
+    }
+
+    size_t size() const { return m_size; }
+
+private:
+    size_t m_size{};
+};
+
+static void benchmark_round_trip(ReadonlyBytes nbt)
+{
+    outln("Writing NBT, and reading it back:");
+
+    InputMemoryStream stream(nbt);
+    auto maybe_value = NBT::Value::try_parse(stream);
+    VERIFY(!maybe_value.is_error());
+    auto& value = maybe_value.value();
+
+    auto encode = Benchmark::run("Writer::encode", iterations, [&] {
+        Benchmark::do_not_optimize(NBT::Writer::encode("", value));
+    });
+    auto parse = Benchmark::run("Value::try_parse", iterations, [&] {
+        InputMemoryStream stream(nbt);
+        Benchmark::do_not_optimize(NBT::Value::try_parse(stream));
+    });
+    outln("  {:<48} {:>10.1}MiB/s", "Round trip throughput", nbt.size() / (encode + parse) / 1.048576);
+
+    Benchmark::run("Reader events to Writer, without a tree", iterations, [&] {
+        DiscardingOutputStream output;
+        NBT::Writer writer(output);
+        NBT::Reader reader(nbt);
+        while (true)
+        {
+            auto event = reader.next();
+            VERIFY(!event.is_error());
+            VERIFY(!writer.write_event(event.value()).is_error());
+            if (event.value().kind == NBT::Reader::Event::Kind::DocumentEnd)
+                break;
+        }
+        Benchmark::do_not_optimize(output.size());
+    });
+
+    size_t compressed_size = 0;
+    Benchmark::run("Writer through a streaming gzip sink", iterations, [&] {
+        DiscardingOutputStream output;
+        NBT::CompressedOutputStream compressed(output, NBT::CompressedOutputStream::Format::Gzip);
+        NBT::Writer writer(compressed);
+        VERIFY(!writer.write_document("", value).is_error());
+        compressed.finish();
+        compressed_size = output.size();
+    });
+    outln("  {:<48} {:>12} bytes", "Compressed size", compressed_size);
+}
+
+// Reading a few fields out of a document, which with a tree of Values means parsing all of it first
+// Quoted names hold the characters that otherwise separate the parts of a path, which is easy to get wrong, and would
+// quietly make the lookups below measure nothing
+static void check_index_paths()
+{
+    auto* palette = new NBT::Value::Compound;
+    palette->set("minecraft:stone", BigEndian<i32>(1));
+    palette->set("minecraft:oak_log[axis=y]", BigEndian<i32>(2));
+    palette->set("dotted.name", BigEndian<i32>(3));
+
+    auto* root = new NBT::Value::Compound;
+    root->set("Palette", NBT::Value(move(palette)));
+    auto bytes = NBT::Writer::encode("Schematic", NBT::Value(move(root))).release_value();
+
+    auto maybe_index = NBT::Index::create(bytes);
+    VERIFY(!maybe_index.is_error());
+    auto& index = *maybe_index.value();
+
+    auto value_at = [&](StringView path) -> Optional<i32> {
+        auto node = index.resolve(path);
+        if (!node.has_value())
+            return {};
+        return static_cast<i32>(index.materialize(*node).value().as<BigEndian<i32>>());
+    };
+
+    VERIFY(value_at("Palette[\"minecraft:stone\"]") == 1);
+    VERIFY(value_at("Schematic.Palette[\"minecraft:oak_log[axis=y]\"]") == 2);
+    VERIFY(value_at("Palette[\"dotted.name\"]") == 3);
+    VERIFY(!value_at("Palette[\"minecraft:stone\"").has_value());
+    VERIFY(!value_at("Palette[\"minecraft:stone]").has_value());
+}
+
+static void benchmark_index(ReadonlyBytes nbt)
+{
+    check_index_paths();
+
+    outln("Indexing a document and looking up paths in it, against parsing all of it:");
+
+    auto build = Benchmark::run("Index::create", iterations, [&] {
+        Benchmark::do_not_optimize(NBT::Index::create(nbt));
+    });
+    auto parse = Benchmark::run("Value::try_parse", iterations, [&] {
+        InputMemoryStream stream(nbt);
+        Benchmark::do_not_optimize(NBT::Value::try_parse(stream));
+    });
+    Benchmark::print_speedup("Indexing speedup over parsing", parse, build);
+
+    auto maybe_index = NBT::Index::create(nbt);
+    VERIFY(!maybe_index.is_error());
+    auto& index = *maybe_index.value();
+
+    // These are in the schematic we make up, and most are in real ones
+    auto palette_entry = "Palette[\"minecraft:block_0[facing=north,powered=false]\"]"sv;
+    for (auto path : {"Width"sv, "BlockEntities[100].Pos"sv, palette_entry})
+    {
+        if (!index.resolve(path).has_value())
+        {
+            outln("  {} isn't in this document", path);
+            continue;
+        }
+
+        Benchmark::run(String::formatted("resolve and materialize {}", path), iterations * 1000, [&] {
+            auto node = index.resolve(path);
+            Benchmark::do_not_optimize(index.materialize(*node));
+        });
+    }
+}
+
+// The schema decoder reads a schematic straight into its fields, where the old path parsed a tree first and looked each
+// field up in it
+static void benchmark_schematic(ReadonlyBytes nbt)
+{
+    outln("Parsing a Sponge schematic, straight from NBT and through a tree of Values:");
+
+    if (auto schematic = SpongeSchematic::parse_schematic(nbt); schematic.is_error())
+    {
+        outln("  Not a schematic we can parse: {}", schematic.error());
+        return;
+    }
+
+    auto two_pass = Benchmark::run("Value::try_parse, then parse_schematic", iterations, [&] {
+        InputMemoryStream stream(nbt);
+        auto value = NBT::Value::try_parse(stream);
+        Benchmark::do_not_optimize(SpongeSchematic::parse_schematic(value.value()));
+    });
+    auto schema = Benchmark::run("parse_schematic through the schema", iterations, [&] {
+        Benchmark::do_not_optimize(SpongeSchematic::parse_schematic(nbt));
+    });
+    Benchmark::print_speedup("Schema speedup", two_pass, schema);
+}
+
+int main(int argc, char** argv)
+{
+    ByteBuffer nbt;
+    if (argc > 1)
+    {
+        auto maybe_nbt = read_file(argv[1]);
+        if (!maybe_nbt.has_value())
+            return 1;
+        nbt = maybe_nbt.release_value();
+    }
+    else
+    {
+        nbt = make_schematic();
+    }
+
+    outln("Benchmarking with {} bytes of NBT, averaged over {} runs", nbt.size(), iterations);
+
+    benchmark_documents(nbt);
+    benchmark_arrays();
+    benchmark_round_trip(nbt);
+    benchmark_index(nbt);
+    benchmark_schematic(nbt);
+
+    return 0;
+}
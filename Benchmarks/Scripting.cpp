@@ -0,0 +1,765 @@
+/*
+ * Copyright (c) 2021, James Puleo <james@jame.xyz>
+ *
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#include <AK/Format.h>
+#include <AK/Function.h>
+#include <AK/HashMap.h>
+#include <AK/NonnullOwnPtrVector.h>
+#include <AK/Queue.h>
+#include <AK/StringBuilder.h>
+#include <Benchmarks/Benchmark.h>
+#include <LibCore/DirIterator.h>
+#include <LibCore/File.h>
+#include <Server/Scripting/BytecodeCache.h>
+#include <Server/Scripting/Format.h>
+#include <Server/Scripting/Lua.h>
+#include <Server/Scripting/Queue.h>
+#include <Server/Scripting/TimingWheel.h>
+#include <limits.h>
+#include <math.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// Benchmarks for the scripting runtime. These drive Lua, and the pieces of Server/Scripting that don't need a running
+// server, directly, so they measure the runtime rather than the network:
+//
+//     ScriptingBenchmark
+
+static constexpr size_t iterations = 20;
+
+static lua_State* create_state(const char* source)
+{
+    auto* state = luaL_newstate();
+    VERIFY(state);
+    luaL_openlibs(state);
+
+    if (luaL_dostring(state, source) != LUA_OK)
+    {
+        warnln("Failed to load benchmark script: {}", lua_tostring(state, -1));
+        VERIFY_NOT_REACHED();
+    }
+
+    return state;
+}
+
+// Stands in for the Engine, which the client methods need to find before they can do anything
+struct FakeEngine
+{
+    u64 calls{};
+};
+
+static HashMap<lua_State*, FakeEngine*> s_engines;
+
+static int client_id_from_global_map(lua_State* state)
+{
+    auto* engine = s_engines.get(state).value();
+    engine->calls++;
+    lua_pushinteger(state, *reinterpret_cast<u32*>(luaL_checkudata(state, 1, "Client")));
+    return 1;
+}
+
+static int client_id_from_upvalue(lua_State* state)
+{
+    auto* engine = reinterpret_cast<FakeEngine*>(lua_touserdata(state, lua_upvalueindex(1)));
+    engine->calls++;
+    lua_pushinteger(state, *reinterpret_cast<u32*>(luaL_checkudata(state, 1, "Client")));
+    return 1;
+}
+
+static void create_client_metatable(lua_State* state, FakeEngine* engine_upvalue)
+{
+    luaL_newmetatable(state, "Client");
+    lua_pushvalue(state, -1);
+    lua_setfield(state, -2, "__index");
+
+    if (engine_upvalue)
+    {
+        lua_pushlightuserdata(state, engine_upvalue);
+        lua_pushcclosure(state, client_id_from_upvalue, 1);
+    }
+    else
+    {
+        lua_pushcfunction(state, client_id_from_global_map);
+    }
+    lua_setfield(state, -2, "id");
+
+    lua_pop(state, 1);
+}
+
+static void push_new_client(lua_State* state, u32 client_id)
+{
+    auto* client_ud = lua_newuserdata(state, sizeof(u32));
+    *reinterpret_cast<u32*>(client_ud) = client_id;
+    luaL_setmetatable(state, "Client");
+}
+
+// Hooks used to get a new userdata for the client on every call, and the methods they called found their Engine in a
+// global map. Now each client's userdata is made once and kept in the registry, and the Engine is an upvalue.
+static void benchmark_hook_dispatch()
+{
+    constexpr size_t dispatches = 100'000;
+    constexpr u32 client_count = 64;
+
+    outln("Calling a hook {} times, over {} clients, which calls a client method twice:", dispatches, client_count);
+
+    static constexpr const char* source = "function hook(client) return client:id() + client:id() end";
+
+    auto call_hook = [](lua_State* state, auto push_client) {
+        for (size_t i = 0; i < dispatches; i++)
+        {
+            lua_getglobal(state, "hook");
+            push_client(static_cast<u32>(i % client_count));
+            lua_call(state, 1, 1);
+            lua_pop(state, 1);
+        }
+    };
+
+    FakeEngine old_engine;
+    auto* old_state = create_state(source);
+    s_engines.set(old_state, &old_engine);
+    create_client_metatable(old_state, nullptr);
+
+    auto fresh = Benchmark::run("New userdata, Engine from a global map", iterations, [&] {
+        call_hook(old_state, [&](u32 client_id) { push_new_client(old_state, client_id); });
+    });
+
+    FakeEngine new_engine;
+    auto* new_state = create_state(source);
+    create_client_metatable(new_state, &new_engine);
+
+    Vector<int> client_refs;
+    for (u32 client_id = 0; client_id < client_count; client_id++)
+    {
+        push_new_client(new_state, client_id);
+        client_refs.append(luaL_ref(new_state, LUA_REGISTRYINDEX));
+    }
+
+    auto cached = Benchmark::run("Cached userdata, Engine as an upvalue", iterations, [&] {
+        call_hook(new_state, [&](u32 client_id) { lua_rawgeti(new_state, LUA_REGISTRYINDEX, client_refs[client_id]); });
+    });
+    Benchmark::print_speedup("Cached speedup", fresh, cached);
+
+    Benchmark::do_not_optimize(old_engine.calls + new_engine.calls);
+
+    s_engines.remove(old_state);
+    lua_close(old_state);
+    lua_close(new_state);
+}
+
+// Runs the callback on a thread of its own, as the scripting threads are plain pthreads too
+class BenchmarkThread
+{
+    AK_MAKE_NONCOPYABLE(BenchmarkThread);
+    AK_MAKE_NONMOVABLE(BenchmarkThread);
+
+public:
+    explicit BenchmarkThread(Function<void()> callback) : m_callback(move(callback))
+    {
+        auto rc = pthread_create(&m_thread, nullptr, thread_main, this);
+        VERIFY(rc == 0);
+    }
+
+    void join() { pthread_join(m_thread, nullptr); }
+
+private:
+    static void* thread_main(void* thread)
+    {
+        reinterpret_cast<BenchmarkThread*>(thread)->m_callback();
+        return nullptr;
+    }
+
+    Function<void()> m_callback;
+    pthread_t m_thread{};
+};
+
+// What the queues carried before they were lock-free
+template<typename T>
+class LockedQueue
+{
+public:
+    LockedQueue() { pthread_mutex_init(&m_mutex, nullptr); }
+    ~LockedQueue() { pthread_mutex_destroy(&m_mutex); }
+
+    void push(T value)
+    {
+        pthread_mutex_lock(&m_mutex);
+        m_values.enqueue(move(value));
+        pthread_mutex_unlock(&m_mutex);
+    }
+
+    Optional<T> pop()
+    {
+        pthread_mutex_lock(&m_mutex);
+        Optional<T> value;
+        if (!m_values.is_empty())
+            value = m_values.dequeue();
+        pthread_mutex_unlock(&m_mutex);
+        return value;
+    }
+
+private:
+    pthread_mutex_t m_mutex;
+    AK::Queue<T> m_values;
+};
+
+struct QueuedMessage
+{
+    u64 posted_at{};
+};
+
+// The producers push their share of the messages as fast as they can, while this thread pops them, so this measures
+// how long a message waits for the consumer when the queue is busy
+template<typename Push, typename Pop>
+static void pass_messages(size_t producer_count, size_t message_count, Scripting::QueueStatistics& statistics,
+                          Push push, Pop pop)
+{
+    NonnullOwnPtrVector<BenchmarkThread> producers;
+    for (size_t i = 0; i < producer_count; i++)
+    {
+        producers.append(make<BenchmarkThread>([&] {
+            for (size_t j = 0; j < message_count / producer_count; j++)
+            {
+                statistics.did_post();
+                push(QueuedMessage {Benchmark::monotonic_nanoseconds()});
+            }
+        }));
+    }
+
+    // The scripting threads sleep in poll() when their queues are empty, but spinning keeps wakeups out of this
+    for (size_t received = 0; received < message_count / producer_count * producer_count;)
+    {
+        auto message = pop();
+        if (!message.has_value())
+            continue;
+
+        statistics.did_handle(message->posted_at);
+        received++;
+    }
+
+    for (auto& producer : producers)
+        producer.join();
+}
+
+static void print_latency(StringView name, const Scripting::QueueStatistics& statistics)
+{
+    outln("  {:<48} {:>12.3}us average, {:.3}us at most", name, statistics.average_latency_milliseconds() * 1000,
+          statistics.max_latency_milliseconds() * 1000);
+}
+
+// Events come from the I/O thread, and other plugins' threads over the bus, into an MPSC queue. Actions go back to the
+// I/O thread over an SPSC ring, which the scripting thread waits on when it is full.
+static void benchmark_queues()
+{
+    constexpr size_t message_count = 100'000;
+    constexpr size_t producer_count = 3;
+
+    outln("Passing {} messages between threads, from {} producers, and from one:", message_count, producer_count);
+
+    {
+        LockedQueue<QueuedMessage> queue;
+        Scripting::QueueStatistics statistics;
+        auto locked = Benchmark::run("Mutex queue, many producers", iterations, [&] {
+            pass_messages(
+                producer_count, message_count, statistics, [&](auto message) { queue.push(message); },
+                [&] { return queue.pop(); });
+        });
+        print_latency("Mutex queue latency", statistics);
+
+        Scripting::MPSCQueue<QueuedMessage> mpsc_queue;
+        Scripting::QueueStatistics mpsc_statistics;
+        auto mpsc = Benchmark::run("MPSC queue, many producers", iterations, [&] {
+            pass_messages(
+                producer_count, message_count, mpsc_statistics, [&](auto message) { mpsc_queue.push(message); },
+                [&] { return mpsc_queue.pop(); });
+        });
+        print_latency("MPSC queue latency", mpsc_statistics);
+        Benchmark::print_speedup("MPSC speedup", locked, mpsc);
+    }
+
+    {
+        LockedQueue<QueuedMessage> queue;
+        Scripting::QueueStatistics statistics;
+        auto locked = Benchmark::run("Mutex queue, one producer", iterations, [&] {
+            pass_messages(
+                1, message_count, statistics, [&](auto message) { queue.push(message); }, [&] { return queue.pop(); });
+        });
+        print_latency("Mutex queue latency", statistics);
+
+        // Waiting when it's full, like Thread::post_action() does
+        auto spsc_queue = make<Scripting::SPSCQueue<QueuedMessage, 1024>>();
+        Scripting::QueueStatistics spsc_statistics;
+        auto spsc = Benchmark::run("SPSC queue, one producer", iterations, [&] {
+            pass_messages(
+                1, message_count, spsc_statistics,
+                [&](auto message) {
+                    while (!spsc_queue->try_push(move(message)))
+                        sched_yield();
+                },
+                [&] { return spsc_queue->try_pop(); });
+        });
+        print_latency("SPSC queue latency", spsc_statistics);
+        Benchmark::print_speedup("SPSC speedup", locked, spsc);
+    }
+}
+
+// How the scripting threads kept their timers before the timing wheel. Working out the poll timeout and finding the
+// timers that are due both went over every timer.
+class ScanningTimers
+{
+public:
+    explicit ScanningTimers(u64) {}
+
+    u64 add(u64 now_milliseconds, u64 interval_milliseconds, Scripting::TimingWheel::Callback callback)
+    {
+        auto timer_id = m_next_timer_id++;
+        m_timers.set(timer_id, {interval_milliseconds, now_milliseconds + interval_milliseconds, move(callback)});
+        return timer_id;
+    }
+
+    void remove(u64 timer_id) { m_timers.remove(timer_id); }
+
+    Optional<u64> milliseconds_until_next_tick(u64 now_milliseconds) const
+    {
+        Optional<u64> earliest_deadline;
+        for (auto& timer : m_timers)
+        {
+            if (!earliest_deadline.has_value() || timer.value.deadline < *earliest_deadline)
+                earliest_deadline = timer.value.deadline;
+        }
+
+        if (!earliest_deadline.has_value())
+            return {};
+
+        return *earliest_deadline > now_milliseconds ? *earliest_deadline - now_milliseconds : 0;
+    }
+
+    void advance(u64 now_milliseconds)
+    {
+        Vector<u64> due_timer_ids;
+        for (auto& timer : m_timers)
+        {
+            if (timer.value.deadline <= now_milliseconds)
+                due_timer_ids.append(timer.key);
+        }
+
+        for (auto timer_id : due_timer_ids)
+        {
+            auto timer = m_timers.find(timer_id);
+            if (timer == m_timers.end())
+                continue;
+
+            if (timer->value.callback(timer_id))
+                m_timers.remove(timer_id);
+            else
+                timer->value.deadline += timer->value.interval;
+        }
+    }
+
+private:
+    struct Timer
+    {
+        u64 interval;
+        u64 deadline;
+        Scripting::TimingWheel::Callback callback;
+    };
+
+    HashMap<u64, Timer> m_timers;
+    u64 m_next_timer_id{1};
+};
+
+// Intervals from a millisecond up to a minute, the same ones every run
+static Vector<u64> make_timer_intervals(size_t count)
+{
+    Vector<u64> intervals;
+    intervals.ensure_capacity(count);
+
+    u64 seed = 0x2545f4914f6cdd1d;
+    for (size_t i = 0; i < count; i++)
+    {
+        seed = seed * 6364136223846793005 + 1442695040888963407;
+        intervals.unchecked_append(1 + (seed >> 33) % 60'000);
+    }
+
+    return intervals;
+}
+
+// A thread wakes up once a millisecond with this many timers running, asks how long it may sleep, and fires whatever
+// is due. Every timer is periodic, so the same number stay running throughout.
+template<typename Timers>
+static double run_timers(StringView name, size_t timer_count, size_t wakeups)
+{
+    u64 now_milliseconds = 0;
+    Timers timers(now_milliseconds);
+    u64 fired = 0;
+
+    for (auto interval : make_timer_intervals(timer_count))
+    {
+        timers.add(now_milliseconds, interval, [&](u64) {
+            fired++;
+            return false;
+        });
+    }
+
+    auto microseconds = Benchmark::run(name, iterations, [&] {
+        for (size_t i = 0; i < wakeups; i++)
+        {
+            now_milliseconds++;
+            Benchmark::do_not_optimize(timers.milliseconds_until_next_tick(now_milliseconds));
+            timers.advance(now_milliseconds);
+        }
+    });
+
+    Benchmark::do_not_optimize(fired);
+    return microseconds;
+}
+
+static void benchmark_timers()
+{
+    constexpr size_t timer_count = 100'000;
+    constexpr size_t wakeups = 100;
+
+    outln("Running {} periodic timers, through {} wakeups a millisecond apart, and adding and removing them:",
+          timer_count, wakeups);
+
+    auto scanning = run_timers<ScanningTimers>("Scanning a hash map of timers", timer_count, wakeups);
+    auto wheel = run_timers<Scripting::TimingWheel>("Timing wheel", timer_count, wakeups);
+    Benchmark::print_speedup("Timing wheel speedup", scanning, wheel);
+
+    auto intervals = make_timer_intervals(timer_count);
+    Vector<u64> timer_ids;
+    timer_ids.ensure_capacity(timer_count);
+
+    auto add_and_remove = [&](auto& timers) {
+        timer_ids.clear_with_capacity();
+        for (auto interval : intervals)
+            timer_ids.unchecked_append(timers.add(0, interval, [](u64) { return true; }));
+        for (auto timer_id : timer_ids)
+            timers.remove(timer_id);
+    };
+
+    ScanningTimers scanning_timers(0);
+    auto scanning_churn = Benchmark::run("Hash map, adding and removing every timer", iterations,
+                                         [&] { add_and_remove(scanning_timers); });
+    Scripting::TimingWheel wheel_timers(0);
+    auto wheel_churn = Benchmark::run("Timing wheel, adding and removing every timer", iterations,
+                                      [&] { add_and_remove(wheel_timers); });
+    Benchmark::print_speedup("Timing wheel speedup", scanning_churn, wheel_churn);
+}
+
+// A plugin of a few thousand lines, with enough functions and tables in it that parsing takes a while
+static String make_plugin_source()
+{
+    StringBuilder builder;
+    builder.append("local Plugin = {}\n");
+    for (size_t i = 0; i < 500; i++)
+    {
+        builder.appendff("function Plugin.handler_{}(client, event)\n", i);
+        builder.appendff("    local names = {{ \"first_{}\", \"second_{}\", \"third_{}\" }}\n", i, i, i);
+        builder.append("    for index, name in ipairs(names) do\n");
+        builder.append("        if event[name] ~= nil and index % 2 == 0 then\n");
+        builder.appendff("            client:sendMessage(string.format(\"%s: %d\", name, index * {}))\n", i);
+        builder.append("        end\n");
+        builder.append("    end\n");
+        builder.append("end\n");
+    }
+    builder.append("return Plugin\n");
+    return builder.to_string();
+}
+
+static void remove_directory(const String& path)
+{
+    Core::DirIterator iterator(path, Core::DirIterator::SkipDots);
+    while (iterator.has_next())
+    {
+        auto entry = iterator.next_full_path();
+        if (Core::File::is_directory(entry))
+            remove_directory(entry);
+        else
+            unlink(entry.characters());
+    }
+    rmdir(path.characters());
+}
+
+// Every plugin's state loads Base and its own scripts when the server starts, or when it is reloaded. The cache has
+// them load bytecode instead of parsing the source again.
+static void benchmark_bytecode_cache()
+{
+    // The cache lives in the working directory, so work in a directory of our own
+    char original_directory[PATH_MAX];
+    char directory_template[] = "/tmp/ScriptingBenchmark.XXXXXX";
+    auto* directory = mkdtemp(directory_template);
+    if (!getcwd(original_directory, sizeof(original_directory)) || !directory || chdir(directory) < 0)
+    {
+        perror("Failed to make a directory for the bytecode cache");
+        return;
+    }
+
+    auto source = make_plugin_source();
+    auto file = Core::File::construct("plugin.lua");
+    if (!file->open(Core::OpenMode::WriteOnly) || !file->write(source))
+    {
+        warnln("Failed to write the plugin to load");
+        return;
+    }
+    file->close();
+
+    outln("Loading a plugin of {} bytes of source, from source and from the bytecode cache:", source.length());
+
+    auto* state = luaL_newstate();
+    VERIFY(state);
+
+    auto parsed = Benchmark::run("Parsing the source (luaL_loadfile)", iterations, [&] {
+        auto rc = luaL_loadfile(state, "plugin.lua");
+        VERIFY(rc == LUA_OK);
+        lua_pop(state, 1);
+    });
+
+    // The first load misses, and writes the entry that the rest of them load
+    auto cached = Benchmark::run("Loading bytecode from the cache", iterations, [&] {
+        auto result = Scripting::BytecodeCache::load_file(state, "plugin.lua");
+        VERIFY(!result.is_error());
+        lua_pop(state, 1);
+    });
+    Benchmark::print_speedup("Cache speedup", parsed, cached);
+
+    auto statistics = Scripting::BytecodeCache::statistics();
+    outln("  {:<48} {:>12} of {}", "Cache hits", statistics.hits, statistics.hits + statistics.misses);
+
+    lua_close(state);
+
+    [[maybe_unused]] auto rc = chdir(original_directory);
+    remove_directory(directory);
+}
+
+// format() as it was before format strings were cached: the format string is parsed on every call, the arguments are
+// type erased into two Vectors, and the String AK formats into is copied again to push it
+static int format_without_cache(lua_State* state)
+{
+    auto format_string = luaL_checkstring(state, 1);
+    Vector<u64, 16> values;
+    Vector<AK::TypeErasedParameter, 16> type_erased_parameters;
+
+    auto top = lua_gettop(state);
+    for (auto i = 2; i <= top; i++)
+    {
+        AK::TypeErasedParameter parameter;
+        parameter.type = AK::TypeErasedParameter::Type::Custom;
+
+        auto value_index = values.size();
+        if (lua_type(state, i) == LUA_TNUMBER)
+        {
+            auto value = lua_tonumber(state, i);
+            [[maybe_unused]] double whole_part;
+            if (modf(value, &whole_part) == 0)
+            {
+                values.append(value);
+                parameter.formatter = AK::__format_value<i64>;
+            }
+            else
+            {
+                values.append(*reinterpret_cast<u64*>(&value));
+                parameter.formatter = AK::__format_value<LUA_NUMBER>;
+            }
+        }
+        else
+        {
+            values.append(reinterpret_cast<u64>(lua_tostring(state, i)));
+            parameter.formatter = AK::__format_value<char*>;
+        }
+
+        parameter.value = reinterpret_cast<void*>(&values.at(value_index));
+        type_erased_parameters.append(move(parameter));
+    }
+
+    AK::TypeErasedFormatParams parameters;
+    parameters.set_parameters(type_erased_parameters);
+
+    auto formatted = String::vformatted(format_string, parameters);
+    lua_pushstring(state, formatted.characters());
+    return 1;
+}
+
+static int format_with_cache(lua_State* state)
+{
+    auto* cache = reinterpret_cast<Scripting::FormatCache*>(lua_touserdata(state, lua_upvalueindex(1)));
+    cache->push_formatted(state, 1);
+    return 1;
+}
+
+// Plugins format chat messages and status text with format(), which used to parse the format string every call
+static void benchmark_format()
+{
+    constexpr size_t calls = 100'000;
+
+    outln("Formatting {} chat messages, with strings, integers and a float with a format spec:", calls);
+
+    static constexpr const char* source = R"(
+        function run(calls)
+            local length = 0
+            for i = 1, calls do
+                local message = format("{} joined the game, {} of {} players online ({:.2} tps)", "Notch", i % 100, 100,
+                                       19.5 + (i % 10) / 100)
+                length = length + #message
+            end
+            return length
+        end
+    )";
+
+    auto run = [](lua_State* state) {
+        lua_getglobal(state, "run");
+        lua_pushinteger(state, calls);
+        lua_call(state, 1, 1);
+        Benchmark::do_not_optimize(lua_tointeger(state, -1));
+        lua_pop(state, 1);
+    };
+
+    auto* old_state = create_state(source);
+    lua_register(old_state, "format", format_without_cache);
+    auto uncached = Benchmark::run("Parsing every call, formatting into a String", iterations, [&] { run(old_state); });
+
+    Scripting::FormatCache cache;
+    auto* new_state = create_state(source);
+    lua_pushlightuserdata(new_state, &cache);
+    lua_pushcclosure(new_state, format_with_cache, 1);
+    lua_setglobal(new_state, "format");
+    auto cached = Benchmark::run("Cached template, reused builder", iterations, [&] { run(new_state); });
+    Benchmark::print_speedup("Cached speedup", uncached, cached);
+
+    lua_close(old_state);
+    lua_close(new_state);
+}
+
+struct CollectorStatistics
+{
+    u64 steps{};
+    u64 cycles{};
+    u64 total_nanoseconds{};
+    u64 max_pause_nanoseconds{};
+};
+
+// Steps the collector the way Engine::collect_garbage does while the thread is idle
+static void step_collector(lua_State* state, CollectorStatistics& statistics)
+{
+    static constexpr u64 budget_nanoseconds = 1'000'000;
+
+    auto started_at = Benchmark::monotonic_nanoseconds();
+    do
+    {
+        if (lua_gc(state, LUA_GCSTEP, 64) == 1)
+        {
+            statistics.cycles++;
+            break;
+        }
+    } while (Benchmark::monotonic_nanoseconds() - started_at < budget_nanoseconds);
+
+    auto pause_nanoseconds = Benchmark::monotonic_nanoseconds() - started_at;
+    statistics.steps++;
+    statistics.total_nanoseconds += pause_nanoseconds;
+    statistics.max_pause_nanoseconds = max(statistics.max_pause_nanoseconds, pause_nanoseconds);
+}
+
+// Base used to publish every status and login request with a new event table. It now takes them from a pool, and
+// clears them once the hooks have returned.
+static void benchmark_event_tables()
+{
+    constexpr size_t requests = 100'000;
+    constexpr size_t requests_per_wakeup = 100;
+
+    outln("Publishing {} status requests, stepping the collector after every {} of them:", requests,
+          requests_per_wakeup);
+
+    static constexpr const char* source = R"(
+        local function hook(event)
+            event.responseData = event.client
+        end
+
+        local eventPool = {}
+        local releasedEvent = {}
+
+        local function acquireEvent()
+            local count = #eventPool
+            if count == 0 then
+                return {}
+            end
+
+            local event = eventPool[count]
+            eventPool[count] = nil
+            return setmetatable(event, nil)
+        end
+
+        local function releaseEvent(event)
+            for key in pairs(event) do
+                event[key] = nil
+            end
+
+            setmetatable(event, releasedEvent)
+            if #eventPool < 32 then
+                eventPool[#eventPool + 1] = event
+            end
+        end
+
+        function fresh(requests)
+            for i = 1, requests do
+                local event = { client = i }
+                hook(event)
+            end
+        end
+
+        function pooled(requests)
+            for i = 1, requests do
+                local event = acquireEvent()
+                event.client = i
+                hook(event)
+                releaseEvent(event)
+            end
+        end
+    )";
+
+    auto run = [](StringView name, const char* function) {
+        auto* state = create_state(source);
+        lua_gc(state, LUA_GCCOLLECT, 0);
+        lua_gc(state, LUA_GCSETPAUSE, 400);
+
+        CollectorStatistics statistics;
+        auto microseconds = Benchmark::run(name, iterations, [&] {
+            for (size_t i = 0; i < requests; i += requests_per_wakeup)
+            {
+                lua_getglobal(state, function);
+                lua_pushinteger(state, requests_per_wakeup);
+                lua_call(state, 1, 0);
+                step_collector(state, statistics);
+            }
+        });
+
+        outln("  {:<48} {:>12} steps, {} cycles, {:.3}us in total, longest pause {:.3}us", "Collector",
+              statistics.steps, statistics.cycles, statistics.total_nanoseconds / 1000.0,
+              statistics.max_pause_nanoseconds / 1000.0);
+
+        lua_close(state);
+        return microseconds;
+    };
+
+    auto fresh = run("New event table for every request", "fresh");
+    auto pooled = run("Pooled event tables", "pooled");
+    Benchmark::print_speedup("Pooled speedup", fresh, pooled);
+}
+
+int main(int, char**)
+{
+    outln("Benchmarking the scripting runtime, averaged over {} runs", iterations);
+
+    benchmark_hook_dispatch();
+    benchmark_queues();
+    benchmark_timers();
+    benchmark_bytecode_cache();
+    benchmark_format();
+    benchmark_event_tables();
+
+    return 0;
+}
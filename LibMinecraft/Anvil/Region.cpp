@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2021, James Puleo <james@jame.xyz>
+ *
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#include <AK/MemoryStream.h>
+#include <LibCompress/Gzip.h>
+#include <LibCompress/Zlib.h>
+#include <LibMinecraft/Anvil/Region.h>
+
+namespace Minecraft::Anvil
+{
+// The header is made up of a table of chunk locations, followed by a table of chunk timestamps, each one sector long.
+static constexpr size_t locations_offset = 0;
+static constexpr size_t timestamps_offset = Region::sector_size;
+static constexpr size_t header_size = Region::sector_size * 2;
+
+// If this bit is set in the compression type, the chunk is stored in a separate .mcc file instead.
+static constexpr u8 external_chunk_flag = 0x80;
+
+Result<NonnullRefPtr<Region>, String> Region::open(const String& path)
+{
+    auto maybe_file = MappedFile::map(path);
+    if (maybe_file.is_error())
+        return maybe_file.release_error();
+
+    // An empty region file is valid, and just means no chunks have been written to it.
+    if (maybe_file.value()->size() != 0 && maybe_file.value()->size() < header_size)
+        return String::formatted("Region file {} is too small to hold a header", path);
+
+    return adopt_ref(*new Region(maybe_file.release_value()));
+}
+
+u32 Region::read_header_entry(size_t offset, u8 x, u8 z) const
+{
+    VERIFY(x < chunks_per_side && z < chunks_per_side);
+
+    if (m_file->size() < header_size)
+        return 0;
+
+    BigEndian<u32> entry;
+    __builtin_memcpy(&entry, m_file->bytes().data() + offset + (x + z * chunks_per_side) * sizeof(u32),
+                     sizeof(entry));
+    return entry;
+}
+
+u32 Region::location(u8 x, u8 z) const { return read_header_entry(locations_offset, x, z); }
+
+u32 Region::timestamp(u8 x, u8 z) const { return read_header_entry(timestamps_offset, x, z); }
+
+Result<NBT::Value, String> Region::read_chunk(u8 x, u8 z, size_t* decoded_size) const
+{
+    auto chunk_location = location(x, z);
+    if (chunk_location == 0)
+        return String::formatted("Chunk {}, {} is not present in this region", x, z);
+
+    // The upper three bytes are the offset in sectors, the lowest byte is how many sectors the chunk takes up.
+    auto sector_offset = chunk_location >> 8;
+    auto sector_count = chunk_location & 0xFF;
+
+    auto bytes = m_file->bytes();
+    auto chunk_offset = static_cast<size_t>(sector_offset) * sector_size;
+
+    if (chunk_offset + 5 > bytes.size() || sector_offset * sector_size < header_size)
+        return String::formatted("Chunk {}, {} has an invalid location", x, z);
+
+    BigEndian<u32> length;
+    __builtin_memcpy(&length, bytes.data() + chunk_offset, sizeof(length));
+
+    // The length includes the compression type byte.
+    if (length == 0 || length > sector_count * sector_size || chunk_offset + 4 + length > bytes.size())
+        return String::formatted("Chunk {}, {} has an invalid length", x, z);
+
+    auto compression_type = bytes[chunk_offset + 4];
+    if (compression_type & external_chunk_flag)
+        return String::formatted("Chunk {}, {} is stored externally, which is unsupported", x, z);
+
+    auto compressed_bytes = bytes.slice(chunk_offset + 5, length - 1);
+
+    Optional<ByteBuffer> maybe_decompressed;
+
+    switch (static_cast<Compression>(compression_type))
+    {
+        case Compression::Gzip:
+            maybe_decompressed = Compress::GzipDecompressor::decompress_all(compressed_bytes);
+            break;
+        case Compression::Zlib:
+            maybe_decompressed = Compress::Zlib::decompress_all(compressed_bytes);
+            break;
+        case Compression::Uncompressed:
+        {
+            // We can parse straight out of the mapping, there's no need to copy it.
+            if (decoded_size)
+                *decoded_size = compressed_bytes.size();
+
+            InputMemoryStream stream(compressed_bytes);
+            return NBT::Value::try_parse(stream);
+        }
+        default:
+            return String::formatted("Chunk {}, {} uses unknown compression type {}", x, z, compression_type);
+    }
+
+    if (!maybe_decompressed.has_value())
+        return String::formatted("Chunk {}, {} failed to decompress", x, z);
+
+    if (decoded_size)
+        *decoded_size = maybe_decompressed->size();
+
+    InputMemoryStream stream(*maybe_decompressed);
+    return NBT::Value::try_parse(stream);
+}
+}
@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) 2021, James Puleo <james@jame.xyz>
+ *
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#pragma once
+
+#include <AK/ByteBuffer.h>
+#include <AK/NonnullRefPtr.h>
+#include <AK/RefCounted.h>
+#include <AK/Result.h>
+#include <AK/String.h>
+#include <LibMinecraft/MappedFile.h>
+#include <LibMinecraft/NBT/Value.h>
+
+namespace Minecraft::Anvil
+{
+// A single Anvil region file (r.<x>.<z>.mca), holding 32x32 chunks. The file is memory mapped, and chunks are only
+// decompressed and parsed when they are read.
+class Region : public RefCounted<Region>
+{
+public:
+    static constexpr size_t sector_size = 4096;
+    static constexpr u8 chunks_per_side = 32;
+
+    enum class Compression : u8
+    {
+        Gzip = 1,
+        Zlib = 2,
+        Uncompressed = 3
+    };
+
+    static Result<NonnullRefPtr<Region>, String> open(const String& path);
+
+    // Chunk coordinates are relative to this region, from 0 to 31.
+    bool has_chunk(u8 x, u8 z) const { return location(x, z) != 0; }
+
+    // The last time this chunk was saved, in seconds since the epoch
+    u32 timestamp(u8 x, u8 z) const;
+
+    Result<NBT::Value, String> read_chunk(u8 x, u8 z, size_t* decoded_size = nullptr) const;
+
+private:
+    explicit Region(NonnullRefPtr<MappedFile> file) : m_file(move(file)) {}
+
+    u32 location(u8 x, u8 z) const;
+    u32 read_header_entry(size_t offset, u8 x, u8 z) const;
+
+    NonnullRefPtr<MappedFile> m_file;
+};
+}
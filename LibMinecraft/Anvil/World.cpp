@@ -0,0 +1,181 @@
+/*
+ * Copyright (c) 2021, James Puleo <james@jame.xyz>
+ *
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#include <AK/LexicalPath.h>
+#include <LibCore/File.h>
+#include <LibMinecraft/Anvil/World.h>
+
+namespace Minecraft::Anvil
+{
+static const NBT::Value* find_in_compound(const NBT::Value& value, const String& name)
+{
+    if (!value.get().has<NBT::Value::Compound*>())
+        return nullptr;
+
+    auto* compound = value.as<NBT::Value::Compound*>();
+    auto it = compound->find(name);
+    if (it == compound->end())
+        return nullptr;
+
+    return &it->value;
+}
+
+static Optional<i8> y_of_section(const NBT::Value& section)
+{
+    auto* y = find_in_compound(section, "Y");
+    if (!y || !y->get().has<i8>())
+        return {};
+
+    return y->as<i8>();
+}
+
+// The list is owned through a pointer, so finding it doesn't change the chunk, even if the caller then changes it
+static NBT::Value::List* find_sections(const NBT::Value& root)
+{
+    auto* sections = find_in_compound(root, "sections");
+    if (!sections)
+    {
+        if (auto* level = find_in_compound(root, "Level"))
+            sections = find_in_compound(*level, "Sections");
+    }
+
+    if (!sections || !sections->get().has<NBT::Value::List*>())
+        return nullptr;
+
+    return sections->as<NBT::Value::List*>();
+}
+
+NBT::Value::List* Chunk::sections() { return find_sections(m_root); }
+
+const NBT::Value* Chunk::section(i8 y) const
+{
+    auto* sections = find_sections(m_root);
+    if (!sections)
+        return nullptr;
+
+    for (auto& section : *sections)
+    {
+        auto section_y = y_of_section(section);
+        if (section_y.has_value() && *section_y == y)
+            return &section;
+    }
+
+    return nullptr;
+}
+
+Result<RefPtr<Region>, String> World::region(i32 region_x, i32 region_z)
+{
+    auto key = key_for(region_x, region_z);
+    if (auto it = m_regions.find(key); it != m_regions.end())
+        return it->value;
+
+    auto file_name = String::formatted("r.{}.{}.mca", region_x, region_z);
+    auto path = LexicalPath(m_region_directory).append(file_name).string();
+    if (!Core::File::exists(path))
+    {
+        m_regions.set(key, nullptr);
+        return RefPtr<Region>();
+    }
+
+    auto maybe_region = Region::open(path);
+    if (maybe_region.is_error())
+        return maybe_region.release_error();
+
+    RefPtr<Region> region = maybe_region.release_value();
+    m_regions.set(key, region);
+    return region;
+}
+
+Result<RefPtr<Chunk>, String> World::chunk(i32 x, i32 z)
+{
+    // Arithmetic shifts round towards negative infinity, which is exactly what we want for negative coordinates.
+    auto maybe_region = region(x >> 5, z >> 5);
+    if (maybe_region.is_error())
+        return maybe_region.release_error();
+
+    auto region = maybe_region.release_value();
+    auto local_x = static_cast<u8>(x & (Region::chunks_per_side - 1));
+    auto local_z = static_cast<u8>(z & (Region::chunks_per_side - 1));
+
+    if (!region || !region->has_chunk(local_x, local_z))
+        return RefPtr<Chunk>();
+
+    size_t decoded_size = 0;
+    auto maybe_root = region->read_chunk(local_x, local_z, &decoded_size);
+    if (maybe_root.is_error())
+        return maybe_root.release_error();
+
+    return RefPtr<Chunk>(adopt_ref(*new Chunk(x, z, maybe_root.release_value(), decoded_size)));
+}
+
+Result<RefPtr<Section>, String> World::section(i32 chunk_x, i8 section_y, i32 chunk_z)
+{
+    auto key = section_key_for(chunk_x, section_y, chunk_z);
+
+    if (auto it = m_cache.find(key); it != m_cache.end())
+    {
+        // Move it to the back, as it is now the most recently used.
+        auto section = it->value;
+        m_cache.remove(key);
+        m_cache.set(key, section);
+        return section;
+    }
+
+    auto maybe_chunk = chunk(chunk_x, chunk_z);
+    if (maybe_chunk.is_error())
+        return maybe_chunk.release_error();
+
+    RefPtr<Section> requested_section;
+    if (auto chunk = maybe_chunk.release_value(); chunk && chunk->sections())
+    {
+        // The sections are moved out of the chunk, which is thrown away along with everything else in it
+        for (auto& section_value : *chunk->sections())
+        {
+            auto y = y_of_section(section_value);
+            if (!y.has_value())
+                continue;
+
+            auto section = adopt_ref(*new Section(chunk_x, *y, chunk_z, move(section_value)));
+            if (*y == section_y)
+                requested_section = section;
+            else if (!m_cache.contains(section_key_for(chunk_x, *y, chunk_z)))
+                cache_section(section_key_for(chunk_x, *y, chunk_z), move(section));
+        }
+    }
+
+    // The requested section goes in last, so it is the most recently used
+    cache_section(key, requested_section);
+    evict_until_within_budget();
+
+    return requested_section;
+}
+
+void World::cache_section(u64 key, RefPtr<Section> section)
+{
+    m_cached_bytes += cache_entry_size + (section ? section->memory_size() : 0);
+    m_cache.set(key, move(section));
+}
+
+void World::set_cache_budget_in_bytes(size_t budget)
+{
+    m_cache_budget_in_bytes = budget;
+    evict_until_within_budget();
+}
+
+void World::evict_until_within_budget()
+{
+    // Sections that are still referenced elsewhere stay alive, they just won't be found in the cache anymore.
+    while (m_cached_bytes > m_cache_budget_in_bytes && !m_cache.is_empty())
+    {
+        auto least_recently_used = m_cache.begin();
+        m_cached_bytes -= cache_entry_size;
+        if (least_recently_used->value)
+            m_cached_bytes -= least_recently_used->value->memory_size();
+        auto key = least_recently_used->key;
+        m_cache.remove(key);
+    }
+}
+}
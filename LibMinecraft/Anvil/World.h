@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2021, James Puleo <james@jame.xyz>
+ *
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#pragma once
+
+#include <AK/HashMap.h>
+#include <AK/RefPtr.h>
+#include <AK/Result.h>
+#include <AK/String.h>
+#include <LibMinecraft/Anvil/Region.h>
+#include <LibMinecraft/NBT/Value.h>
+
+namespace Minecraft::Anvil
+{
+class Chunk : public RefCounted<Chunk>
+{
+public:
+    Chunk(i32 x, i32 z, NBT::Value root, size_t decoded_size)
+        : m_x(x), m_z(z), m_root(move(root)), m_decoded_size(decoded_size)
+    {
+    }
+
+    i32 x() const { return m_x; }
+    i32 z() const { return m_z; }
+    const NBT::Value& root() const { return m_root; }
+    NBT::Value& root() { return m_root; }
+
+    // Finds the section at the given section Y, for both the pre-1.18 ("Level" -> "Sections") and the 1.18+
+    // ("sections") chunk format.
+    const NBT::Value* section(i8 y) const;
+
+    // The list of sections, in whichever format the chunk is in
+    NBT::Value::List* sections();
+
+    // How many bytes of NBT this chunk was decoded from
+    size_t decoded_size() const { return m_decoded_size; }
+
+private:
+    i32 m_x;
+    i32 m_z;
+    NBT::Value m_root;
+    size_t m_decoded_size;
+};
+
+// One 16x16x16 section of a chunk, taken out of the chunk's NBT
+class Section : public RefCounted<Section>
+{
+public:
+    Section(i32 x, i8 y, i32 z, NBT::Value value)
+        : m_x(x), m_y(y), m_z(z), m_value(move(value)), m_memory_size(sizeof(Section) + m_value.heap_size())
+    {
+    }
+
+    i32 x() const { return m_x; }
+    i8 y() const { return m_y; }
+    i32 z() const { return m_z; }
+    const NBT::Value& value() const { return m_value; }
+
+    // What keeping this section in memory costs, which is what we budget the cache with
+    size_t memory_size() const { return m_memory_size; }
+
+private:
+    i32 m_x;
+    i8 m_y;
+    i32 m_z;
+    NBT::Value m_value;
+    size_t m_memory_size;
+};
+
+// A world on disk, made up of a directory of region files. Regions are opened when they are first needed. Decoded
+// sections are kept in a least recently used cache that is limited by a budget on the memory they take up, so the
+// sections that are actually looked at stay around without the rest of their chunk.
+class World
+{
+public:
+    World(String region_directory, size_t cache_budget_in_bytes)
+        : m_region_directory(move(region_directory)), m_cache_budget_in_bytes(cache_budget_in_bytes)
+    {
+    }
+
+    // Returns a null section if its chunk has never been generated, or the chunk has no section at that Y. Reading a
+    // section that isn't cached decodes its chunk, and caches every section in it.
+    Result<RefPtr<Section>, String> section(i32 chunk_x, i8 section_y, i32 chunk_z);
+
+    // Decodes the whole chunk, for what isn't in its sections. This isn't cached. Returns a null chunk if it has never
+    // been generated.
+    Result<RefPtr<Chunk>, String> chunk(i32 x, i32 z);
+
+    size_t cached_bytes() const { return m_cached_bytes; }
+    size_t cache_budget_in_bytes() const { return m_cache_budget_in_bytes; }
+    void set_cache_budget_in_bytes(size_t);
+
+private:
+    static u64 key_for(i32 x, i32 z) { return (static_cast<u64>(static_cast<u32>(x)) << 32) | static_cast<u32>(z); }
+
+    // Chunk coordinates fit in 28 bits, as the world border keeps them within 1875000 of the origin
+    static u64 section_key_for(i32 x, i8 y, i32 z)
+    {
+        constexpr u64 coordinate_mask = (1 << 28) - 1;
+        return ((static_cast<u64>(static_cast<u32>(x)) & coordinate_mask) << 36) |
+               ((static_cast<u64>(static_cast<u32>(z)) & coordinate_mask) << 8) | static_cast<u8>(y);
+    }
+
+    // What a cache entry costs on top of its section, including ones for sections that don't exist
+    static constexpr size_t cache_entry_size = sizeof(u64) + sizeof(RefPtr<Section>) + sizeof(void*) * 2;
+
+    Result<RefPtr<Region>, String> region(i32 region_x, i32 region_z);
+
+    void cache_section(u64 key, RefPtr<Section>);
+    void evict_until_within_budget();
+
+    String m_region_directory;
+    size_t m_cache_budget_in_bytes;
+    size_t m_cached_bytes{};
+
+    // Regions that don't exist on disk are stored as null, so we don't try to open them again.
+    HashMap<u64, RefPtr<Region>> m_regions;
+
+    // Ordered by how recently each section was used, the least recently used section coming first. Sections that don't
+    // exist are stored as null, so we don't decode their chunk again to find that out.
+    OrderedHashMap<u64, RefPtr<Section>> m_cache;
+};
+}
@@ -4,6 +4,8 @@
  * SPDX-License-Identifier: GPL-3.0-only
  */
 
+#include <AK/GenericLexer.h>
+#include <AK/StringBuilder.h>
 #include <LibMinecraft/BlockState.h>
 
 namespace Minecraft
@@ -24,12 +26,45 @@ Result<BlockState, String> BlockState::parse_block_state(StringView value)
         if (value.ends_with(']'))
             value = value.substring_view(0, value.length() - 1);
 
-        state.set_state(key, value);
+        state.set_state(key, parse_property_value(value));
     }
 
     return state;
 }
 
+BlockState::PropertyValue BlockState::parse_property_value(StringView value)
+{
+    if (value == "true")
+        return true;
+    if (value == "false")
+        return false;
+
+    if (auto maybe_integer = value.to_int(); maybe_integer.has_value())
+        return *maybe_integer;
+
+    return value.to_string();
+}
+
+String BlockState::property_value_to_string(const PropertyValue& value)
+{
+    if (value.has<bool>())
+        return value.get<bool>() ? "true" : "false";
+    if (value.has<i32>())
+        return String::number(value.get<i32>());
+
+    return value.get<String>();
+}
+
+bool BlockState::property_values_equal(const PropertyValue& a, const PropertyValue& b)
+{
+    if (a.has<bool>())
+        return b.has<bool>() && a.get<bool>() == b.get<bool>();
+    if (a.has<i32>())
+        return b.has<i32>() && a.get<i32>() == b.get<i32>();
+
+    return b.has<String>() && a.get<String>() == b.get<String>();
+}
+
 String BlockState::to_string() const
 {
     StringBuilder state_builder;
@@ -45,7 +80,7 @@ String BlockState::to_string() const
         {
             state_builder.append(kv.key);
             state_builder.append('=');
-            state_builder.append(kv.value);
+            state_builder.append(property_value_to_string(kv.value));
 
             if (i < m_states.size() - 1)
                 state_builder.append(',');
@@ -58,4 +93,4 @@ String BlockState::to_string() const
 
     return state_builder.build();
 }
-}
\ No newline at end of file
+}
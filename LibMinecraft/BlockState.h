@@ -15,21 +15,30 @@ namespace Minecraft
 class BlockState
 {
 public:
+    // Block state properties are either booleans (waterlogged=true), integers (power=15), or names of an enum value
+    // (facing=north).
+    using PropertyValue = Variant<bool, i32, String>;
+
     explicit BlockState(ResourceLocation block) : m_block(move(block)) {}
 
-    void set_state(String& key, String value) { m_states.set(key, move(value)); }
+    void set_state(const String& key, PropertyValue value) { m_states.set(key, move(value)); }
 
     const ResourceLocation& block() const { return m_block; }
-    const HashMap<String, String>& states() const { return m_states; }
+    const HashMap<String, PropertyValue>& states() const { return m_states; }
 
     static Result<BlockState, String> parse_block_state(StringView);
 
+    static PropertyValue parse_property_value(StringView);
+
+    static String property_value_to_string(const PropertyValue&);
+
+    static bool property_values_equal(const PropertyValue&, const PropertyValue&);
+
     String to_string() const;
 
 private:
     ResourceLocation m_block;
-    // TODO: The value here should be a Variant of many types, such as boolean, cardinal direction, integer, etc.
-    HashMap<String, String> m_states;
+    HashMap<String, PropertyValue> m_states;
 };
 }
 
@@ -43,4 +52,4 @@ struct Formatter<Minecraft::BlockState> : Formatter<StringView>
         Formatter<StringView>::format(builder, value.to_string());
     }
 };
-}
\ No newline at end of file
+}
@@ -0,0 +1,146 @@
+/*
+ * Copyright (c) 2021, James Puleo <james@jame.xyz>
+ *
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#include <LibMinecraft/BlockStateRegistry.h>
+
+namespace Minecraft
+{
+BlockStateRegistry& BlockStateRegistry::the()
+{
+    static BlockStateRegistry s_the;
+    return s_the;
+}
+
+Optional<u64> BlockStateRegistry::pack_properties(const Block& block, const BlockState& state)
+{
+    u64 packed = 0;
+
+    for (auto& kv : state.states())
+    {
+        bool found = false;
+
+        for (size_t property_index = 0; property_index < block.properties.size(); property_index++)
+        {
+            auto& property = block.properties[property_index];
+            if (property.name != kv.key)
+                continue;
+
+            for (size_t value_index = 0; value_index < property.values.size(); value_index++)
+            {
+                if (BlockState::property_values_equal(property.values[value_index], kv.value))
+                {
+                    packed |= static_cast<u64>(value_index + 1) << (property_index * bits_per_property);
+                    found = true;
+                    break;
+                }
+            }
+
+            break;
+        }
+
+        // A property or value that we have never seen can't be part of a state that we have interned.
+        if (!found)
+            return {};
+    }
+
+    return packed;
+}
+
+Result<u64, String> BlockStateRegistry::pack_properties_interning(Block& block, const BlockState& state)
+{
+    u64 packed = 0;
+
+    for (auto& kv : state.states())
+    {
+        Optional<size_t> maybe_property_index;
+
+        for (size_t property_index = 0; property_index < block.properties.size(); property_index++)
+        {
+            if (block.properties[property_index].name == kv.key)
+            {
+                maybe_property_index = property_index;
+                break;
+            }
+        }
+
+        if (!maybe_property_index.has_value())
+        {
+            if (block.properties.size() == max_properties_per_block)
+                return String::formatted("Block {} has too many properties", state.block());
+
+            maybe_property_index = block.properties.size();
+            block.properties.append({kv.key, {}});
+        }
+
+        auto& property = block.properties[*maybe_property_index];
+        Optional<size_t> maybe_value_index;
+
+        for (size_t value_index = 0; value_index < property.values.size(); value_index++)
+        {
+            if (BlockState::property_values_equal(property.values[value_index], kv.value))
+            {
+                maybe_value_index = value_index;
+                break;
+            }
+        }
+
+        if (!maybe_value_index.has_value())
+        {
+            if (property.values.size() == max_values_per_property)
+                return String::formatted("Property {} of block {} has too many values", kv.key, state.block());
+
+            maybe_value_index = property.values.size();
+            property.values.append(kv.value);
+        }
+
+        packed |= static_cast<u64>(*maybe_value_index + 1) << (*maybe_property_index * bits_per_property);
+    }
+
+    return packed;
+}
+
+Result<BlockStateRegistry::Id, String> BlockStateRegistry::intern(const BlockState& state)
+{
+    auto block_iterator = m_blocks.find(state.block());
+    if (block_iterator == m_blocks.end())
+    {
+        m_blocks.set(state.block(), make<Block>());
+        block_iterator = m_blocks.find(state.block());
+    }
+
+    auto& block = *block_iterator->value;
+
+    auto maybe_packed_properties = pack_properties_interning(block, state);
+    if (maybe_packed_properties.is_error())
+        return maybe_packed_properties.release_error();
+
+    auto packed_properties = maybe_packed_properties.release_value();
+
+    if (auto maybe_id = block.states.get(packed_properties); maybe_id.has_value())
+        return *maybe_id;
+
+    auto id = static_cast<Id>(m_states.size());
+    m_states.append(make<BlockState>(state));
+    block.states.set(packed_properties, id);
+
+    return id;
+}
+
+Optional<BlockStateRegistry::Id> BlockStateRegistry::find(const BlockState& state) const
+{
+    auto block_iterator = m_blocks.find(state.block());
+    if (block_iterator == m_blocks.end())
+        return {};
+
+    auto& block = *block_iterator->value;
+
+    auto maybe_packed_properties = pack_properties(block, state);
+    if (!maybe_packed_properties.has_value())
+        return {};
+
+    return block.states.get(*maybe_packed_properties);
+}
+}
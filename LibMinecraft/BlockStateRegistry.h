@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2021, James Puleo <james@jame.xyz>
+ *
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#pragma once
+
+#include <AK/HashMap.h>
+#include <AK/NonnullOwnPtr.h>
+#include <AK/NonnullOwnPtrVector.h>
+#include <AK/Result.h>
+#include <AK/Vector.h>
+#include <LibMinecraft/BlockState.h>
+
+namespace Minecraft
+{
+// Interns every distinct BlockState to a dense integer ID, so schematics and chunks can store block states as plain
+// integers, and only resolve them back to a BlockState when they really need to.
+class BlockStateRegistry
+{
+    AK_MAKE_NONCOPYABLE(BlockStateRegistry);
+    AK_MAKE_NONMOVABLE(BlockStateRegistry);
+
+public:
+    using Id = u32;
+
+    static BlockStateRegistry& the();
+
+    Result<Id, String> intern(const BlockState&);
+
+    Optional<Id> find(const BlockState&) const;
+
+    // Each state lives on the heap on its own, so the reference stays valid however many states are interned after it
+    const BlockState& state_for_id(Id id) const { return m_states.at(id); }
+
+    size_t size() const { return m_states.size(); }
+
+    // Each property value is stored as an index into the values seen for that property, packed into a fixed number of
+    // bits. Index 0 means the property isn't present in the state at all.
+    static constexpr size_t bits_per_property = 5;
+    static constexpr size_t max_properties_per_block = (sizeof(u64) * 8) / bits_per_property;
+    static constexpr size_t max_values_per_property = (1 << bits_per_property) - 1;
+
+private:
+    BlockStateRegistry() = default;
+
+    struct Property
+    {
+        String name;
+        Vector<BlockState::PropertyValue> values;
+    };
+
+    struct Block
+    {
+        Vector<Property> properties;
+        HashMap<u64, Id> states;
+    };
+
+    static Optional<u64> pack_properties(const Block&, const BlockState&);
+    static Result<u64, String> pack_properties_interning(Block&, const BlockState&);
+
+    HashMap<ResourceLocation, NonnullOwnPtr<Block>> m_blocks;
+    NonnullOwnPtrVector<BlockState> m_states;
+};
+}
@@ -67,6 +67,97 @@ JsonObject Component::to_json() const
     return object;
 }
 
+void Component::write_json(StringBuilder& builder) const
+{
+    builder.append('{');
+    write_json_members(builder);
+
+    auto append_bool = [&](StringView key, const Optional<bool>& value) {
+        if (!value.has_value())
+            return;
+        builder.append(key);
+        builder.append(*value ? "true" : "false");
+    };
+
+    append_bool(",\"bold\":", m_bold);
+    append_bool(",\"italic\":", m_italic);
+    append_bool(",\"underlined\":", m_underlined);
+    append_bool(",\"strikethrough\":", m_strikethrough);
+    append_bool(",\"obfuscated\":", m_obfuscated);
+
+    if (m_font.has_value())
+    {
+        builder.append(",\"font\":");
+        append_json_string(builder, *m_font);
+    }
+
+    if (m_color.has_value())
+    {
+        builder.append(",\"color\":");
+        m_color->visit(
+            [&](const NamedColor& named_color) {
+                builder.append('"');
+                builder.append(s_named_color_names[static_cast<i32>(named_color)]);
+                builder.append('"');
+            },
+            [&](const Gfx::Color& color) {
+                builder.appendff("\"#{:02x}{:02x}{:02x}\"", color.red(), color.green(), color.blue());
+            });
+    }
+
+    if (!m_children.is_empty())
+    {
+        builder.append(",\"extra\":[");
+
+        for (size_t i = 0; i < m_children.size(); i++)
+        {
+            if (i != 0)
+                builder.append(',');
+            m_children[i].write_json(builder);
+        }
+
+        builder.append(']');
+    }
+
+    builder.append('}');
+}
+
+void Component::hash_content(ContentHasher& hasher) const
+{
+    auto add_bool = [&](const Optional<bool>& value) { hasher.add_integer(value.has_value() ? 1 + *value : 0); };
+
+    add_bool(m_bold);
+    add_bool(m_italic);
+    add_bool(m_underlined);
+    add_bool(m_strikethrough);
+    add_bool(m_obfuscated);
+
+    hasher.add_integer(m_font.has_value());
+    if (m_font.has_value())
+        hasher.add_string(*m_font);
+
+    if (m_color.has_value())
+    {
+        m_color->visit(
+            [&](const NamedColor& named_color) {
+                hasher.add_integer(1);
+                hasher.add_integer(static_cast<u64>(named_color));
+            },
+            [&](const Gfx::Color& color) {
+                hasher.add_integer(2);
+                hasher.add_integer(color.value());
+            });
+    }
+    else
+    {
+        hasher.add_integer(0);
+    }
+
+    hasher.add_integer(m_children.size());
+    for (auto& child : m_children)
+        child.hash_content(hasher);
+}
+
 void Component::set_color(Optional<NamedColor> value)
 {
     if (value.has_value())
@@ -92,6 +183,19 @@ JsonObject TextComponent::to_json() const
     return object;
 }
 
+void TextComponent::hash_content(ContentHasher& hasher) const
+{
+    hasher.add_integer('T');
+    hasher.add_string(m_text);
+    Component::hash_content(hasher);
+}
+
+void TextComponent::write_json_members(StringBuilder& builder) const
+{
+    builder.append("\"text\":");
+    append_json_string(builder, m_text);
+}
+
 JsonObject TranslationComponent::to_json() const
 {
     auto object = Component::to_json();
@@ -111,6 +215,38 @@ JsonObject TranslationComponent::to_json() const
     return object;
 }
 
+void TranslationComponent::hash_content(ContentHasher& hasher) const
+{
+    hasher.add_integer('R');
+    hasher.add_string(m_translation_key);
+
+    hasher.add_integer(m_translation_format_replacements.size());
+    for (auto& replacement : m_translation_format_replacements)
+        replacement.hash_content(hasher);
+
+    Component::hash_content(hasher);
+}
+
+void TranslationComponent::write_json_members(StringBuilder& builder) const
+{
+    builder.append("\"translate\":");
+    append_json_string(builder, m_translation_key);
+
+    if (!m_translation_format_replacements.is_empty())
+    {
+        builder.append(",\"with\":[");
+
+        for (size_t i = 0; i < m_translation_format_replacements.size(); i++)
+        {
+            if (i != 0)
+                builder.append(',');
+            m_translation_format_replacements[i].write_json(builder);
+        }
+
+        builder.append(']');
+    }
+}
+
 Result<NonnullRefPtr<Component>, String> Component::parse_component_from_json(const JsonValue& value)
 {
     if (!value.is_object())
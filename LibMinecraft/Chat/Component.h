@@ -12,8 +12,10 @@
 #include <AK/RefCounted.h>
 #include <AK/Result.h>
 #include <AK/String.h>
+#include <AK/StringBuilder.h>
 #include <AK/Variant.h>
 #include <LibGfx/Color.h>
+#include <LibMinecraft/ContentHasher.h>
 
 namespace Minecraft::Chat
 {
@@ -71,6 +73,27 @@ public:
 
     virtual JsonObject to_json() const;
 
+    // Writes the same JSON as to_json(), straight into the builder, without building a JsonObject first.
+    void write_json(StringBuilder&) const;
+
+    // Components with the same contents have the same hash, so unchanged components can be noticed without being
+    // serialized.
+    u64 content_hash() const
+    {
+        ContentHasher hasher;
+        hash_content(hasher);
+        return hasher.value();
+    }
+
+    virtual void hash_content(ContentHasher&) const;
+
+    static void append_json_string(StringBuilder& builder, StringView value)
+    {
+        builder.append('"');
+        builder.append_escaped_for_json(value);
+        builder.append('"');
+    }
+
     static Optional<NamedColor> named_color_value_for_string(const StringView& value)
     {
         return s_named_color_names_to_value.get(value);
@@ -86,6 +109,9 @@ public:
 protected:
     Component() = default;
 
+    // Writes the members specific to this kind of component, which always come first. Each component has at least one.
+    virtual void write_json_members(StringBuilder&) const { VERIFY_NOT_REACHED(); }
+
 private:
     using NamedColorNamesArray = Array<String, static_cast<size_t>(NamedColor::__Count)>;
     static NamedColorNamesArray s_named_color_names;
@@ -113,6 +139,10 @@ public:
     void set_text(String value) { m_text = move(value); }
 
     JsonObject to_json() const override;
+    void hash_content(ContentHasher&) const override;
+
+protected:
+    void write_json_members(StringBuilder&) const override;
 
 private:
     String m_text;
@@ -139,7 +169,16 @@ public:
         m_translation_format_replacements.append(component);
     }
 
+    const NonnullRefPtrVector<Component>& translation_format_replacements() const
+    {
+        return m_translation_format_replacements;
+    }
+
     JsonObject to_json() const override;
+    void hash_content(ContentHasher&) const override;
+
+protected:
+    void write_json_members(StringBuilder&) const override;
 
 private:
     String m_translation_key;
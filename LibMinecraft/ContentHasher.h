@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) 2021, James Puleo <james@jame.xyz>
+ *
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#pragma once
+
+#include <AK/Span.h>
+#include <AK/StringView.h>
+#include <AK/Types.h>
+
+namespace Minecraft
+{
+// An incremental 64-bit FNV-1a hash, for telling whether two values have the same contents without comparing them.
+class ContentHasher
+{
+public:
+    void add_bytes(ReadonlyBytes bytes)
+    {
+        for (auto byte : bytes)
+        {
+            m_hash ^= byte;
+            m_hash *= fnv_prime;
+        }
+    }
+
+    void add_integer(u64 value) { add_bytes({&value, sizeof(value)}); }
+
+    void add_floating(double value)
+    {
+        u64 bits;
+        __builtin_memcpy(&bits, &value, sizeof(bits));
+        add_integer(bits);
+    }
+
+    // Strings are prefixed with their length, so "ab" followed by "c" doesn't hash the same as "a" followed by "bc"
+    void add_string(StringView value)
+    {
+        add_integer(value.length());
+        add_bytes(value.bytes());
+    }
+
+    u64 value() const { return m_hash; }
+
+private:
+    static constexpr u64 fnv_offset_basis = 0xcbf29ce484222325;
+    static constexpr u64 fnv_prime = 0x100000001b3;
+
+    u64 m_hash{fnv_offset_basis};
+};
+}
@@ -0,0 +1,496 @@
+/*
+ * Copyright (c) 2021, James Puleo <james@jame.xyz>
+ *
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#include <AK/JsonObject.h>
+#include <AK/MemoryStream.h>
+#include <AK/QuickSort.h>
+#include <LibCore/File.h>
+#include <LibMinecraft/GlobalPalette.h>
+
+namespace Minecraft
+{
+GlobalPalette* GlobalPalette::s_the;
+
+static constexpr u64 fnv_offset_basis = 0xcbf29ce484222325;
+static constexpr u64 fnv_prime = 0x100000001b3;
+
+static constexpr u64 hash_bytes(ReadonlyBytes bytes, u64 hash = fnv_offset_basis)
+{
+    for (auto byte : bytes)
+    {
+        hash ^= byte;
+        hash *= fnv_prime;
+    }
+
+    return hash;
+}
+
+// The finalizer of splitmix64, used to spread FNV's weak low bits over the whole value
+static constexpr u64 mix(u64 value)
+{
+    value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9;
+    value = (value ^ (value >> 27)) * 0x94d049bb133111eb;
+    return value ^ (value >> 31);
+}
+
+static size_t bucket_for(u64 hash, size_t bucket_count) { return (hash >> 32) % bucket_count; }
+
+static size_t slot_for(u64 hash, u32 displacement, size_t slot_count)
+{
+    return mix(hash + (static_cast<u64>(displacement) + 1) * 0x9e3779b97f4a7c15) % slot_count;
+}
+
+u64 GlobalPalette::hash_state(const BlockState& state)
+{
+    auto block_hash = hash_bytes(state.block().path().bytes(), mix(hash_bytes(state.block().name_space().bytes())));
+
+    // Properties are summed, so that the order we iterate them in doesn't matter.
+    u64 properties_hash = 0;
+    for (auto& kv : state.states())
+    {
+        u64 value_hash;
+        if (kv.value.has<bool>())
+            value_hash = mix(0x100000000 | kv.value.get<bool>());
+        else if (kv.value.has<i32>())
+            value_hash = mix(0x200000000 | static_cast<u32>(kv.value.get<i32>()));
+        else
+            value_hash = hash_bytes(kv.value.get<String>().bytes());
+
+        properties_hash += mix(hash_bytes(kv.key.bytes()) ^ value_hash);
+    }
+
+    return mix(block_hash + properties_hash);
+}
+
+Optional<BlockStateRegistry::Id> GlobalPalette::find(const BlockState& state) const
+{
+    if (m_state_count == 0)
+        return {};
+
+    auto hash = hash_state(state);
+    auto displacement = m_displacements[bucket_for(hash, m_displacements.size())];
+    auto slot = slot_for(hash, displacement, m_slot_ids.size());
+
+    if (m_slot_ids[slot] == empty_slot || m_slot_hashes[slot] != hash)
+        return {};
+
+    return m_slot_ids[slot];
+}
+
+Optional<BlockStateRegistry::Id> GlobalPalette::find(StringView state) const
+{
+    auto maybe_block_state = BlockState::parse_block_state(state);
+    if (maybe_block_state.is_error())
+        return {};
+
+    return find(maybe_block_state.value());
+}
+
+void GlobalPalette::install(NonnullOwnPtr<GlobalPalette> palette)
+{
+    delete s_the;
+    s_the = palette.leak_ptr();
+}
+
+Result<void, String> GlobalPalette::build_perfect_hash(const Vector<u64>& state_hashes)
+{
+    auto bucket_count = max<size_t>(1, (state_hashes.size() + 3) / 4);
+    // A bit of slack makes finding displacements for the last (smallest) buckets much quicker.
+    auto slot_count = max<size_t>(1, state_hashes.size() + state_hashes.size() / 4);
+
+    Vector<Vector<u32, 8>> buckets;
+    buckets.resize(bucket_count);
+    for (u32 i = 0; i < state_hashes.size(); i++)
+        buckets[bucket_for(state_hashes[i], bucket_count)].append(i);
+
+    Vector<u32> bucket_order;
+    bucket_order.ensure_capacity(bucket_count);
+    for (u32 i = 0; i < bucket_count; i++)
+        bucket_order.unchecked_append(i);
+
+    // Place the biggest buckets first, while the table is still mostly empty.
+    quick_sort(bucket_order, [&](auto a, auto b) { return buckets[a].size() > buckets[b].size(); });
+
+    m_owned_displacements.resize(bucket_count);
+    m_owned_slot_hashes.resize(slot_count);
+    m_owned_slot_ids.resize(slot_count);
+    m_owned_slot_ids.fill(empty_slot);
+
+    constexpr u32 max_displacement = 1 << 22;
+
+    for (auto bucket_index : bucket_order)
+    {
+        auto& bucket = buckets[bucket_index];
+        if (bucket.is_empty())
+            break;
+
+        Vector<size_t, 8> slots;
+        bool placed = false;
+
+        for (u32 displacement = 0; displacement < max_displacement && !placed; displacement++)
+        {
+            slots.clear_with_capacity();
+            placed = true;
+
+            for (auto state_index : bucket)
+            {
+                auto slot = slot_for(state_hashes[state_index], displacement, slot_count);
+                if (m_owned_slot_ids[slot] != empty_slot || slots.contains_slow(slot))
+                {
+                    placed = false;
+                    break;
+                }
+                slots.append(slot);
+            }
+
+            if (placed)
+                m_owned_displacements[bucket_index] = displacement;
+        }
+
+        if (!placed)
+            return String("Unable to build perfect hash for global palette, are there duplicate states?");
+
+        for (size_t i = 0; i < bucket.size(); i++)
+        {
+            m_owned_slot_ids[slots[i]] = bucket[i];
+            m_owned_slot_hashes[slots[i]] = state_hashes[bucket[i]];
+        }
+    }
+
+    m_displacements = m_owned_displacements.span();
+    m_slot_hashes = m_owned_slot_hashes.span();
+    m_slot_ids = m_owned_slot_ids.span();
+
+    return {};
+}
+
+Result<void, String> GlobalPalette::intern_states(const Vector<BlockState>& states)
+{
+    auto& registry = BlockStateRegistry::the();
+    if (registry.size() != 0)
+        return String("The global palette must be loaded before any other block state is registered");
+
+    for (size_t i = 0; i < states.size(); i++)
+    {
+        auto maybe_id = registry.intern(states[i]);
+        if (maybe_id.is_error())
+            return maybe_id.release_error();
+
+        if (maybe_id.value() != i)
+            return String::formatted("Global palette state {} is a duplicate of state {}", i, maybe_id.value());
+    }
+
+    return {};
+}
+
+Result<NonnullOwnPtr<GlobalPalette>, String> GlobalPalette::create_from_states(Vector<BlockState>& states)
+{
+    if (BlockStateRegistry::the().size() != 0)
+        return String("The global palette must be loaded before any other block state is registered");
+
+    Vector<u64> state_hashes;
+    state_hashes.ensure_capacity(states.size());
+    for (auto& state : states)
+        state_hashes.unchecked_append(hash_state(state));
+
+    auto palette = adopt_own(*new GlobalPalette);
+    palette->m_state_count = states.size();
+
+    // Duplicate states can't be placed, so this fails before anything is registered
+    auto built = palette->build_perfect_hash(state_hashes);
+    if (built.is_error())
+        return built.release_error();
+
+    auto interned = intern_states(states);
+    if (interned.is_error())
+        return interned.release_error();
+
+    return palette;
+}
+
+Result<NonnullOwnPtr<GlobalPalette>, String> GlobalPalette::load_from_data_report(const String& path)
+{
+    auto file = Core::File::construct(path);
+    if (!file->open(Core::OpenMode::ReadOnly))
+        return String::formatted("Unable to open {}: {}", path, file->error_string());
+
+    auto contents = file->read_all();
+    auto source_hash = hash_bytes(contents.bytes());
+    auto json = JsonValue::from_string(contents);
+    if (!json.has_value() || !json->is_object())
+        return String::formatted("{} is not a valid block data report", path);
+
+    Vector<Optional<BlockState>> states_by_id;
+    Optional<String> error;
+
+    json->as_object().for_each_member([&](auto& block_name, auto& block_value) {
+        if (error.has_value())
+            return;
+
+        auto maybe_block_location = ResourceLocation::try_parse_from_string(block_name);
+        if (!maybe_block_location.has_value() || !block_value.is_object())
+        {
+            error = String::formatted("Invalid block {} in data report", block_name);
+            return;
+        }
+
+        auto block_states = block_value.as_object().get("states");
+        if (!block_states.is_array())
+        {
+            error = String::formatted("Block {} has no states", block_name);
+            return;
+        }
+
+        block_states.as_array().for_each([&](auto& state_value) {
+            if (error.has_value())
+                return;
+
+            if (!state_value.is_object() || !state_value.as_object().get("id").is_number())
+            {
+                error = String::formatted("Block {} has a state without an ID", block_name);
+                return;
+            }
+
+            auto id = state_value.as_object().get("id").to_u32();
+            BlockState state(*maybe_block_location);
+
+            auto properties = state_value.as_object().get("properties");
+            if (properties.is_object())
+            {
+                properties.as_object().for_each_member([&](auto& key, auto& value) {
+                    if (error.has_value())
+                        return;
+
+                    if (!value.is_string())
+                    {
+                        error = String::formatted("Block {} has a state with a property {} that isn't a string",
+                                                  block_name, key);
+                        return;
+                    }
+
+                    state.set_state(key, BlockState::parse_property_value(value.as_string()));
+                });
+
+                if (error.has_value())
+                    return;
+            }
+
+            if (id >= states_by_id.size())
+                states_by_id.resize(id + 1);
+
+            if (states_by_id[id].has_value())
+            {
+                error = String::formatted("Global palette ID {} is used more than once", id);
+                return;
+            }
+
+            states_by_id[id] = move(state);
+        });
+    });
+
+    if (error.has_value())
+        return error.release_value();
+
+    Vector<BlockState> states;
+    states.ensure_capacity(states_by_id.size());
+
+    for (size_t i = 0; i < states_by_id.size(); i++)
+    {
+        if (!states_by_id[i].has_value())
+            return String::formatted("Global palette is missing ID {}", i);
+
+        states.unchecked_append(states_by_id[i].release_value());
+    }
+
+    auto palette = create_from_states(states);
+    if (palette.is_error())
+        return palette.release_error();
+
+    palette.value()->m_source_hash = source_hash;
+    return palette.release_value();
+}
+
+Result<u64, String> GlobalPalette::hash_data_report(const String& path)
+{
+    auto mapped_file = MappedFile::map(path);
+    if (mapped_file.is_error())
+        return mapped_file.release_error();
+
+    return hash_bytes(mapped_file.value()->bytes());
+}
+
+// The precompiled palette is laid out as this header, followed by:
+//   u64 slot_hashes[slot_count]
+//   u32 slot_ids[slot_count]
+//   u32 displacements[bucket_count]
+//   u32 string_offsets[state_count + 1]
+//   char strings[strings_size]
+// All integers are in host byte order, as it is a cache for this machine only.
+struct [[gnu::packed]] PrecompiledPaletteHeader
+{
+    char magic[8];
+    u32 version;
+    u32 state_count;
+    u32 bucket_count;
+    u32 slot_count;
+    u32 strings_size;
+    u32 unused;
+    u64 source_hash;
+};
+
+static_assert(sizeof(PrecompiledPaletteHeader) % sizeof(u64) == 0);
+
+static constexpr char precompiled_palette_magic[8] = {'T', 'R', 'V', 'L', 'P', 'A', 'L', '\0'};
+static constexpr u32 precompiled_palette_version = 2;
+
+Result<void, String> GlobalPalette::write_precompiled(const String& path) const
+{
+    auto& registry = BlockStateRegistry::the();
+
+    Vector<String> state_strings;
+    state_strings.ensure_capacity(m_state_count);
+    u32 strings_size = 0;
+
+    for (size_t i = 0; i < m_state_count; i++)
+    {
+        state_strings.unchecked_append(registry.state_for_id(i).to_string());
+        strings_size += state_strings.last().length();
+    }
+
+    PrecompiledPaletteHeader header{};
+    __builtin_memcpy(header.magic, precompiled_palette_magic, sizeof(header.magic));
+    header.version = precompiled_palette_version;
+    header.state_count = m_state_count;
+    header.bucket_count = m_displacements.size();
+    header.slot_count = m_slot_ids.size();
+    header.strings_size = strings_size;
+    header.source_hash = m_source_hash;
+
+    DuplexMemoryStream stream;
+    stream.write({&header, sizeof(header)});
+    stream.write({m_slot_hashes.data(), m_slot_hashes.size() * sizeof(u64)});
+    stream.write({m_slot_ids.data(), m_slot_ids.size() * sizeof(u32)});
+    stream.write({m_displacements.data(), m_displacements.size() * sizeof(u32)});
+
+    u32 string_offset = 0;
+    for (auto& state_string : state_strings)
+    {
+        stream.write({&string_offset, sizeof(string_offset)});
+        string_offset += state_string.length();
+    }
+    stream.write({&string_offset, sizeof(string_offset)});
+
+    for (auto& state_string : state_strings)
+        stream.write(state_string.bytes());
+
+    auto buffer = stream.copy_into_contiguous_buffer();
+
+    auto file = Core::File::construct(path);
+    if (!file->open(Core::OpenMode::WriteOnly | Core::OpenMode::Truncate))
+        return String::formatted("Unable to open {}: {}", path, file->error_string());
+
+    if (!file->write(buffer.data(), buffer.size()))
+        return String::formatted("Unable to write {}: {}", path, file->error_string());
+
+    return {};
+}
+
+Result<NonnullOwnPtr<GlobalPalette>, String> GlobalPalette::load_precompiled(const String& path,
+                                                                              Optional<u64> expected_source_hash)
+{
+    auto maybe_mapped_file = MappedFile::map(path);
+    if (maybe_mapped_file.is_error())
+        return maybe_mapped_file.release_error();
+
+    auto mapped_file = maybe_mapped_file.release_value();
+    auto bytes = mapped_file->bytes();
+
+    if (bytes.size() < sizeof(PrecompiledPaletteHeader))
+        return String::formatted("{} is too small to be a precompiled palette", path);
+
+    auto& header = *reinterpret_cast<const PrecompiledPaletteHeader*>(bytes.data());
+    if (__builtin_memcmp(header.magic, precompiled_palette_magic, sizeof(header.magic)) != 0)
+        return String::formatted("{} is not a precompiled palette", path);
+    if (header.version != precompiled_palette_version)
+        return String::formatted("{} is an unsupported precompiled palette version", path);
+    if (header.bucket_count == 0 || header.slot_count == 0)
+        return String::formatted("{} is corrupt", path);
+    if (expected_source_hash.has_value() && header.source_hash != *expected_source_hash)
+        return String::formatted("{} was built from a different data report", path);
+
+    size_t offset = sizeof(PrecompiledPaletteHeader);
+    auto slot_hashes_offset = offset;
+    offset += header.slot_count * sizeof(u64);
+    auto slot_ids_offset = offset;
+    offset += header.slot_count * sizeof(u32);
+    auto displacements_offset = offset;
+    offset += header.bucket_count * sizeof(u32);
+    auto string_offsets_offset = offset;
+    offset += (static_cast<size_t>(header.state_count) + 1) * sizeof(u32);
+    auto strings_offset = offset;
+    offset += header.strings_size;
+
+    if (offset > bytes.size())
+        return String::formatted("{} is truncated", path);
+
+    auto* string_offsets = reinterpret_cast<const u32*>(bytes.data() + string_offsets_offset);
+    auto* strings = reinterpret_cast<const char*>(bytes.data() + strings_offset);
+
+    if (BlockStateRegistry::the().size() != 0)
+        return String("The global palette must be loaded before any other block state is registered");
+
+    // Nothing is registered until the whole file has checked out, so that a corrupt or stale file leaves the registry
+    // empty for the data report to be loaded instead.
+    Vector<BlockState> states;
+    states.ensure_capacity(header.state_count);
+
+    for (u32 i = 0; i < header.state_count; i++)
+    {
+        auto start = string_offsets[i];
+        auto end = string_offsets[i + 1];
+        if (start > end || end > header.strings_size)
+            return String::formatted("{} is corrupt", path);
+
+        auto maybe_block_state = BlockState::parse_block_state({strings + start, end - start});
+        if (maybe_block_state.is_error())
+            return maybe_block_state.release_error();
+
+        states.unchecked_append(maybe_block_state.release_value());
+    }
+
+    auto palette = adopt_own(*new GlobalPalette);
+    palette->m_state_count = header.state_count;
+    palette->m_source_hash = header.source_hash;
+    palette->m_slot_hashes = {reinterpret_cast<const u64*>(bytes.data() + slot_hashes_offset),
+                              header.slot_count};
+    palette->m_slot_ids = {reinterpret_cast<const u32*>(bytes.data() + slot_ids_offset), header.slot_count};
+    palette->m_displacements = {reinterpret_cast<const u32*>(bytes.data() + displacements_offset),
+                                header.bucket_count};
+
+    for (auto slot_id : palette->m_slot_ids)
+    {
+        if (slot_id != empty_slot && slot_id >= header.state_count)
+            return String::formatted("{} is corrupt", path);
+    }
+
+    // Every state has to be found where the hash tables say it is, which also catches a file that was written for
+    // different states than its strings say
+    for (u32 i = 0; i < header.state_count; i++)
+    {
+        auto found_id = palette->find(states[i]);
+        if (!found_id.has_value() || *found_id != i)
+            return String::formatted("{} does not match its own states", path);
+    }
+
+    auto interned = intern_states(states);
+    if (interned.is_error())
+        return interned.release_error();
+
+    palette->m_mapped_file = move(mapped_file);
+
+    return palette;
+}
+}
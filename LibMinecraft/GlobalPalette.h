@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2021, James Puleo <james@jame.xyz>
+ *
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#pragma once
+
+#include <AK/NonnullOwnPtr.h>
+#include <AK/Optional.h>
+#include <AK/RefPtr.h>
+#include <AK/Result.h>
+#include <AK/Span.h>
+#include <AK/String.h>
+#include <AK/Vector.h>
+#include <LibMinecraft/BlockState.h>
+#include <LibMinecraft/BlockStateRegistry.h>
+#include <LibMinecraft/MappedFile.h>
+
+namespace Minecraft
+{
+// The global palette is the table of every block state the game knows about, as found in the "blocks.json" data
+// report generated by the vanilla server. Loading it registers every state in the BlockStateRegistry, so registry IDs
+// are then the same as global palette IDs.
+//
+// Lookups go through a perfect hash (hash and displace) built over every state, so finding the ID of a state costs
+// two hashes and a single comparison, without any probing.
+class GlobalPalette
+{
+    AK_MAKE_NONCOPYABLE(GlobalPalette);
+    AK_MAKE_NONMOVABLE(GlobalPalette);
+
+public:
+    static Result<NonnullOwnPtr<GlobalPalette>, String> load_from_data_report(const String& path);
+
+    // The precompiled form is memory mapped and its hash tables are used in place. It records the hash of the data
+    // report it was built from, and is refused if that isn't the expected one, so that an updated report isn't
+    // silently ignored for a stale palette.
+    static Result<NonnullOwnPtr<GlobalPalette>, String> load_precompiled(const String& path,
+                                                                        Optional<u64> expected_source_hash);
+
+    // Hashes a data report the way the precompiled palette records it, which is much quicker than parsing it
+    static Result<u64, String> hash_data_report(const String& path);
+
+    Result<void, String> write_precompiled(const String& path) const;
+
+    static const GlobalPalette* the() { return s_the; }
+    static void install(NonnullOwnPtr<GlobalPalette>);
+
+    Optional<BlockStateRegistry::Id> find(const BlockState&) const;
+    Optional<BlockStateRegistry::Id> find(StringView state) const;
+
+    size_t size() const { return m_state_count; }
+
+    static u64 hash_state(const BlockState&);
+
+private:
+    GlobalPalette() = default;
+
+    static Result<NonnullOwnPtr<GlobalPalette>, String> create_from_states(Vector<BlockState>&);
+    // Registers the states, so that their registry IDs are their index
+    static Result<void, String> intern_states(const Vector<BlockState>&);
+
+    Result<void, String> build_perfect_hash(const Vector<u64>& state_hashes);
+
+    static GlobalPalette* s_the;
+
+    static constexpr u32 empty_slot = NumericLimits<u32>::max();
+
+    size_t m_state_count{};
+    // The hash of the data report the states came from
+    u64 m_source_hash{};
+
+    // These either point into the vectors below, or into the mapped precompiled file.
+    Span<const u32> m_displacements;
+    Span<const u64> m_slot_hashes;
+    Span<const u32> m_slot_ids;
+
+    Vector<u32> m_owned_displacements;
+    Vector<u64> m_owned_slot_hashes;
+    Vector<u32> m_owned_slot_ids;
+
+    RefPtr<MappedFile> m_mapped_file;
+};
+}
@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) 2021, James Puleo <james@jame.xyz>
+ *
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#include <LibMinecraft/MappedFile.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace Minecraft
+{
+Result<NonnullRefPtr<MappedFile>, String> MappedFile::map(const String& path)
+{
+    auto fd = open(path.characters(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return String::formatted("Unable to open {}: {}", path, strerror(errno));
+
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) < 0)
+    {
+        auto error = errno;
+        close(fd);
+        return String::formatted("Unable to stat {}: {}", path, strerror(error));
+    }
+
+    auto size = static_cast<size_t>(file_stat.st_size);
+
+    // mmap refuses zero length mappings, but an empty file is still a perfectly valid (empty) file.
+    if (size == 0)
+    {
+        close(fd);
+        return adopt_ref(*new MappedFile(nullptr, 0));
+    }
+
+    auto* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    auto error = errno;
+    close(fd);
+
+    if (data == MAP_FAILED)
+        return String::formatted("Unable to map {}: {}", path, strerror(error));
+
+    return adopt_ref(*new MappedFile(static_cast<u8*>(data), size));
+}
+
+MappedFile::~MappedFile()
+{
+    if (m_data)
+        munmap(m_data, m_size);
+}
+}
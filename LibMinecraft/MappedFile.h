@@ -0,0 +1,38 @@
+/*
+ * Copyright (c) 2021, James Puleo <james@jame.xyz>
+ *
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#pragma once
+
+#include <AK/NonnullRefPtr.h>
+#include <AK/RefCounted.h>
+#include <AK/Result.h>
+#include <AK/Span.h>
+#include <AK/String.h>
+
+namespace Minecraft
+{
+// A read-only, private mapping of an entire file. Data handed out from here is only valid for as long as the
+// MappedFile is alive, so anything holding on to it should hold on to a reference too.
+class MappedFile : public RefCounted<MappedFile>
+{
+    AK_MAKE_NONCOPYABLE(MappedFile);
+    AK_MAKE_NONMOVABLE(MappedFile);
+
+public:
+    static Result<NonnullRefPtr<MappedFile>, String> map(const String& path);
+
+    ~MappedFile();
+
+    ReadonlyBytes bytes() const { return {m_data, m_size}; }
+    size_t size() const { return m_size; }
+
+private:
+    MappedFile(u8* data, size_t size) : m_data(data), m_size(size) {}
+
+    u8* m_data{};
+    size_t m_size{};
+};
+}
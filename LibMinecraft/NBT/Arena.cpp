@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2021, James Puleo <james@jame.xyz>
+ *
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#include <AK/kmalloc.h>
+#include <LibMinecraft/NBT/Arena.h>
+
+namespace Minecraft::NBT
+{
+Arena::~Arena()
+{
+    while (m_chunks)
+    {
+        auto* previous = m_chunks->previous;
+        kfree(m_chunks);
+        m_chunks = previous;
+    }
+}
+
+static u8* align_up(u8* pointer, size_t alignment)
+{
+    auto address = reinterpret_cast<FlatPtr>(pointer);
+    return reinterpret_cast<u8*>((address + alignment - 1) & ~(static_cast<FlatPtr>(alignment) - 1));
+}
+
+void* Arena::allocate(size_t size, size_t alignment)
+{
+    m_bytes_allocated += size;
+
+    if (m_cursor)
+    {
+        auto* aligned = align_up(m_cursor, alignment);
+        if (aligned + size <= m_end)
+        {
+            m_cursor = aligned + size;
+            return aligned;
+        }
+    }
+
+    return allocate_in_new_chunk(size, alignment);
+}
+
+void* Arena::allocate_in_new_chunk(size_t size, size_t alignment)
+{
+    auto header_size = (sizeof(ChunkHeader) + alignment - 1) & ~(alignment - 1);
+
+    // Big allocations get a chunk to themselves, which is put behind the current chunk, so we keep bumping through
+    // whatever space the current one still has.
+    if (size > chunk_size / 4 && m_chunks)
+    {
+        auto* header = static_cast<ChunkHeader*>(kmalloc(header_size + size));
+        VERIFY(header);
+        header->previous = m_chunks->previous;
+        m_chunks->previous = header;
+        return reinterpret_cast<u8*>(header) + header_size;
+    }
+
+    auto allocation_size = max(chunk_size, header_size + size);
+    auto* header = static_cast<ChunkHeader*>(kmalloc(allocation_size));
+    VERIFY(header);
+    header->previous = m_chunks;
+    m_chunks = header;
+
+    auto* data = reinterpret_cast<u8*>(header) + header_size;
+    m_cursor = data + size;
+    m_end = reinterpret_cast<u8*>(header) + allocation_size;
+    return data;
+}
+}
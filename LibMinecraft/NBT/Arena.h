@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) 2021, James Puleo <james@jame.xyz>
+ *
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#pragma once
+
+#include <AK/Noncopyable.h>
+#include <AK/StdLibExtras.h>
+#include <AK/Types.h>
+
+namespace Minecraft::NBT
+{
+// A bump allocator: allocations are carved out of large chunks, and are never freed individually. Everything is freed
+// at once when the Arena is destroyed, which only costs one free per chunk. Only use it for trivially destructible
+// types, as nothing allocated here will have its destructor called.
+class Arena
+{
+    AK_MAKE_NONCOPYABLE(Arena);
+    AK_MAKE_NONMOVABLE(Arena);
+
+public:
+    Arena() = default;
+    ~Arena();
+
+    void* allocate(size_t size, size_t alignment);
+
+    template<typename T>
+    T* allocate_array(size_t count)
+    {
+        static_assert(IsTriviallyDestructible<T>);
+        return static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+    }
+
+    // How much memory has been handed out, not including padding or the unused ends of chunks
+    size_t bytes_allocated() const { return m_bytes_allocated; }
+
+    static constexpr size_t chunk_size = 64 * KiB;
+
+private:
+    struct ChunkHeader
+    {
+        ChunkHeader* previous;
+    };
+
+    void* allocate_in_new_chunk(size_t size, size_t alignment);
+
+    ChunkHeader* m_chunks{};
+    u8* m_cursor{};
+    u8* m_end{};
+    size_t m_bytes_allocated{};
+};
+}
@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) 2021, James Puleo <james@jame.xyz>
+ *
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#include <LibMinecraft/NBT/ByteSwap.h>
+
+#ifdef __SSE2__
+#    include <emmintrin.h>
+#endif
+
+namespace Minecraft::NBT
+{
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+void convert_between_host_and_big_endian(Span<i16>) {}
+void convert_between_host_and_big_endian(Span<i32>) {}
+void convert_between_host_and_big_endian(Span<i64>) {}
+#else
+#    ifdef __SSE2__
+// SSE2 has no byte shuffle, so we swap the bytes of every 16-bit lane with shifts, and then reorder the lanes.
+static ALWAYS_INLINE __m128i swap_bytes_in_16_bit_lanes(__m128i value)
+{
+    return _mm_or_si128(_mm_slli_epi16(value, 8), _mm_srli_epi16(value, 8));
+}
+#    endif
+
+void convert_between_host_and_big_endian(Span<i16> values)
+{
+    size_t i = 0;
+#    ifdef __SSE2__
+    for (; i + 8 <= values.size(); i += 8)
+    {
+        auto* pointer = reinterpret_cast<__m128i*>(values.data() + i);
+        _mm_storeu_si128(pointer, swap_bytes_in_16_bit_lanes(_mm_loadu_si128(pointer)));
+    }
+#    endif
+    for (; i < values.size(); i++)
+        values[i] = static_cast<i16>(__builtin_bswap16(static_cast<u16>(values[i])));
+}
+
+void convert_between_host_and_big_endian(Span<i32> values)
+{
+    size_t i = 0;
+#    ifdef __SSE2__
+    for (; i + 4 <= values.size(); i += 4)
+    {
+        auto* pointer = reinterpret_cast<__m128i*>(values.data() + i);
+        auto value = swap_bytes_in_16_bit_lanes(_mm_loadu_si128(pointer));
+        value = _mm_shufflelo_epi16(value, _MM_SHUFFLE(2, 3, 0, 1));
+        value = _mm_shufflehi_epi16(value, _MM_SHUFFLE(2, 3, 0, 1));
+        _mm_storeu_si128(pointer, value);
+    }
+#    endif
+    for (; i < values.size(); i++)
+        values[i] = static_cast<i32>(__builtin_bswap32(static_cast<u32>(values[i])));
+}
+
+void convert_between_host_and_big_endian(Span<i64> values)
+{
+    size_t i = 0;
+#    ifdef __SSE2__
+    for (; i + 2 <= values.size(); i += 2)
+    {
+        auto* pointer = reinterpret_cast<__m128i*>(values.data() + i);
+        auto value = swap_bytes_in_16_bit_lanes(_mm_loadu_si128(pointer));
+        value = _mm_shufflelo_epi16(value, _MM_SHUFFLE(0, 1, 2, 3));
+        value = _mm_shufflehi_epi16(value, _MM_SHUFFLE(0, 1, 2, 3));
+        _mm_storeu_si128(pointer, value);
+    }
+#    endif
+    for (; i < values.size(); i++)
+        values[i] = static_cast<i64>(__builtin_bswap64(static_cast<u64>(values[i])));
+}
+#endif
+}
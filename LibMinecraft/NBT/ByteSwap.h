@@ -0,0 +1,19 @@
+/*
+ * Copyright (c) 2021, James Puleo <james@jame.xyz>
+ *
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#pragma once
+
+#include <AK/Span.h>
+#include <AK/Types.h>
+
+namespace Minecraft::NBT
+{
+// Converts a whole array of big endian values to host order (or the other way around, it's the same swap) in place,
+// many values at a time where the CPU allows it. These are no-ops on big endian hosts.
+void convert_between_host_and_big_endian(Span<i16>);
+void convert_between_host_and_big_endian(Span<i32>);
+void convert_between_host_and_big_endian(Span<i64>);
+}
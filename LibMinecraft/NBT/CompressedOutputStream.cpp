@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2021, James Puleo <james@jame.xyz>
+ *
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#include <AK/Array.h>
+#include <AK/Endian.h>
+#include <LibMinecraft/NBT/CompressedOutputStream.h>
+
+namespace Minecraft::NBT
+{
+CompressedOutputStream::CompressedOutputStream(OutputStream& destination, Format format)
+    : m_destination(destination), m_format(format), m_compressor(destination)
+{
+    if (m_format == Format::Gzip)
+    {
+        // Magic, deflate, no flags, no modification time, no extra flags, unknown OS
+        constexpr Array<u8, 10> gzip_header = {0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff};
+        m_destination.write_or_error(gzip_header);
+    }
+    else
+    {
+        // Deflate with a 32K window, default compression, which is also what Java's Deflater writes
+        constexpr Array<u8, 2> zlib_header = {0x78, 0x9c};
+        m_destination.write_or_error(zlib_header);
+    }
+}
+
+CompressedOutputStream::~CompressedOutputStream()
+{
+    if (!m_finished)
+        finish();
+}
+
+size_t CompressedOutputStream::write(ReadonlyBytes bytes)
+{
+    VERIFY(!m_finished);
+
+    if (m_format == Format::Gzip)
+        m_crc32.update(bytes);
+    else
+        m_adler32.update(bytes);
+
+    m_uncompressed_size += bytes.size();
+    return m_compressor.write(bytes);
+}
+
+bool CompressedOutputStream::write_or_error(ReadonlyBytes bytes)
+{
+    if (write(bytes) < bytes.size())
+    {
+        set_fatal_error();
+        return false;
+    }
+
+    return true;
+}
+
+void CompressedOutputStream::finish()
+{
+    VERIFY(!m_finished);
+    m_finished = true;
+
+    m_compressor.final_flush();
+
+    if (m_format == Format::Gzip)
+    {
+        // The gzip trailer is little endian, unlike most other things we deal with
+        m_destination << LittleEndian<u32>(m_crc32.digest());
+        m_destination << LittleEndian<u32>(m_uncompressed_size);
+    }
+    else
+    {
+        m_destination << BigEndian<u32>(m_adler32.digest());
+    }
+}
+}
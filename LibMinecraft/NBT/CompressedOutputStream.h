@@ -0,0 +1,46 @@
+/*
+ * Copyright (c) 2021, James Puleo <james@jame.xyz>
+ *
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#pragma once
+
+#include <AK/Stream.h>
+#include <LibCompress/Deflate.h>
+#include <LibCrypto/Checksum/Adler32.h>
+#include <LibCrypto/Checksum/CRC32.h>
+
+namespace Minecraft::NBT
+{
+// Compresses everything written to it as it goes, in either the gzip (files) or zlib (region chunks, packets)
+// container, so large documents never need to be fully buffered before being compressed.
+class CompressedOutputStream final : public OutputStream
+{
+public:
+    enum class Format
+    {
+        Gzip,
+        Zlib
+    };
+
+    CompressedOutputStream(OutputStream&, Format);
+
+    ~CompressedOutputStream() override;
+
+    size_t write(ReadonlyBytes) override;
+    bool write_or_error(ReadonlyBytes) override;
+
+    // Flushes the compressor and writes the trailer. Nothing can be written after this.
+    void finish();
+
+private:
+    OutputStream& m_destination;
+    Format m_format;
+    Compress::DeflateCompressor m_compressor;
+    Crypto::Checksum::CRC32 m_crc32;
+    Crypto::Checksum::Adler32 m_adler32;
+    u32 m_uncompressed_size{};
+    bool m_finished{};
+};
+}
@@ -0,0 +1,210 @@
+/*
+ * Copyright (c) 2021, James Puleo <james@jame.xyz>
+ *
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#include <AK/QuickSort.h>
+#include <LibMinecraft/NBT/Document.h>
+
+namespace Minecraft::NBT
+{
+const Document::Node* Document::Node::get(StringView name) const
+{
+    VERIFY(m_type == Value::Type::Compound);
+
+    // Entries are sorted by the hash of their name, so we can binary search for it.
+    auto hash = name.hash();
+    size_t low = 0;
+    size_t high = m_length;
+
+    while (low < high)
+    {
+        auto middle = low + (high - low) / 2;
+        if (m_entries[middle].name_hash < hash)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    for (auto i = low; i < m_length && m_entries[i].name_hash == hash; i++)
+    {
+        if (m_entries[i].name == name)
+            return &m_entries[i].value;
+    }
+
+    return nullptr;
+}
+
+ReadonlyBytes Document::Node::array_bytes() const
+{
+    switch (m_type)
+    {
+        case Value::Type::ByteArray:
+            return {m_bytes, m_length};
+        case Value::Type::IntArray:
+            return {m_bytes, m_length * sizeof(i32)};
+        case Value::Type::LongArray:
+            return {m_bytes, m_length * sizeof(i64)};
+        default:
+            VERIFY_NOT_REACHED();
+    }
+}
+
+StringView Document::copy_into_arena(StringView value)
+{
+    auto* characters = m_arena.allocate_array<char>(value.length());
+    __builtin_memcpy(characters, value.characters_without_null_termination(), value.length());
+    return {characters, value.length()};
+}
+
+StringView Document::intern(StringView name)
+{
+    if (auto it = m_interned_names.find(name); it != m_interned_names.end())
+        return *it;
+
+    auto interned = copy_into_arena(name);
+    m_interned_names.set(interned);
+    return interned;
+}
+
+Result<void, String> Document::parse_node(Reader& reader, const Reader::Event& event, Node& node, size_t depth)
+{
+    node.m_type = event.type;
+
+    switch (event.kind)
+    {
+        case Reader::Event::Kind::Value:
+        {
+            switch (event.type)
+            {
+                case Value::Type::Byte:
+                case Value::Type::Short:
+                case Value::Type::Int:
+                case Value::Type::Long:
+                    node.m_integer = event.integer;
+                    break;
+                case Value::Type::Float:
+                case Value::Type::Double:
+                    node.m_floating = event.floating;
+                    break;
+                case Value::Type::String:
+                {
+                    auto copied = copy_into_arena(event.string);
+                    node.m_bytes = reinterpret_cast<const u8*>(copied.characters_without_null_termination());
+                    node.m_length = copied.length();
+                    break;
+                }
+                case Value::Type::ByteArray:
+                case Value::Type::IntArray:
+                case Value::Type::LongArray:
+                {
+                    if (m_array_storage == ArrayStorage::Borrow)
+                    {
+                        node.m_bytes = event.array.data();
+                    }
+                    else
+                    {
+                        auto* payload = m_arena.allocate_array<u8>(event.array.size());
+                        __builtin_memcpy(payload, event.array.data(), event.array.size());
+                        node.m_bytes = payload;
+                    }
+                    node.m_length = event.length;
+                    break;
+                }
+                default:
+                    VERIFY_NOT_REACHED();
+            }
+
+            return {};
+        }
+        case Reader::Event::Kind::ListStart:
+        {
+            node.m_element_type = event.element_type;
+            node.m_length = event.length;
+            node.m_elements = m_arena.allocate_array<Node>(event.length);
+
+            for (i32 i = 0; i < event.length; i++)
+            {
+                auto maybe_element_event = reader.next();
+                if (maybe_element_event.is_error())
+                    return maybe_element_event.release_error();
+
+                new (&node.m_elements[i]) Node;
+                auto parsed = parse_node(reader, maybe_element_event.value(), node.m_elements[i], depth + 1);
+                if (parsed.is_error())
+                    return parsed;
+            }
+
+            auto maybe_end_event = reader.next();
+            if (maybe_end_event.is_error())
+                return maybe_end_event.release_error();
+            VERIFY(maybe_end_event.value().kind == Reader::Event::Kind::ListEnd);
+
+            return {};
+        }
+        case Reader::Event::Kind::CompoundStart:
+        {
+            // We don't know how many entries there are until we reach the end, so collect them in a scratch vector
+            // for this depth, and then copy them into the arena in one go.
+            if (m_compound_scratch.size() <= depth)
+                m_compound_scratch.resize(depth + 1);
+            m_compound_scratch[depth].clear_with_capacity();
+
+            while (true)
+            {
+                auto maybe_entry_event = reader.next();
+                if (maybe_entry_event.is_error())
+                    return maybe_entry_event.release_error();
+
+                auto& entry_event = maybe_entry_event.value();
+                if (entry_event.kind == Reader::Event::Kind::CompoundEnd)
+                    break;
+
+                Entry entry;
+                entry.name = intern(entry_event.name);
+                entry.name_hash = entry.name.hash();
+
+                auto parsed = parse_node(reader, entry_event, entry.value, depth + 1);
+                if (parsed.is_error())
+                    return parsed;
+
+                m_compound_scratch[depth].append(entry);
+            }
+
+            auto& scratch = m_compound_scratch[depth];
+            quick_sort(scratch, [](auto& a, auto& b) { return a.name_hash < b.name_hash; });
+
+            node.m_length = scratch.size();
+            node.m_entries = m_arena.allocate_array<Entry>(scratch.size());
+            __builtin_memcpy(node.m_entries, scratch.data(), scratch.size() * sizeof(Entry));
+
+            return {};
+        }
+        default:
+            return String("Unexpected NBT event");
+    }
+}
+
+Result<NonnullOwnPtr<Document>, String> Document::parse(ReadonlyBytes bytes, ArrayStorage array_storage)
+{
+    auto document = adopt_own(*new Document);
+    document->m_array_storage = array_storage;
+    Reader reader(bytes);
+
+    auto maybe_root_event = reader.next();
+    if (maybe_root_event.is_error())
+        return maybe_root_event.release_error();
+
+    document->m_root_name = document->copy_into_arena(maybe_root_event.value().name);
+
+    auto parsed = document->parse_node(reader, maybe_root_event.value(), document->m_root, 0);
+    if (parsed.is_error())
+        return parsed.release_error();
+
+    document->m_interned_names.clear();
+    document->m_compound_scratch.clear();
+
+    return document;
+}
+}
@@ -0,0 +1,176 @@
+/*
+ * Copyright (c) 2021, James Puleo <james@jame.xyz>
+ *
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#pragma once
+
+#include <AK/Endian.h>
+#include <AK/HashTable.h>
+#include <AK/NonnullOwnPtr.h>
+#include <AK/Result.h>
+#include <AK/StringView.h>
+#include <AK/Vector.h>
+#include <LibMinecraft/NBT/Arena.h>
+#include <LibMinecraft/NBT/ByteSwap.h>
+#include <LibMinecraft/NBT/Reader.h>
+#include <LibMinecraft/NBT/Value.h>
+
+namespace Minecraft::NBT
+{
+// An NBT tree where every node, compound key and array payload lives in one Arena. Parsing one is a handful of large
+// allocations instead of one per node, and destroying one only frees the arena's chunks.
+//
+// Unlike Value, a Document is read-only once parsed.
+class Document
+{
+    AK_MAKE_NONCOPYABLE(Document);
+    AK_MAKE_NONMOVABLE(Document);
+
+public:
+    struct Entry;
+
+    class Node
+    {
+    public:
+        Value::Type type() const { return m_type; }
+
+        i8 as_byte() const
+        {
+            VERIFY(m_type == Value::Type::Byte);
+            return static_cast<i8>(m_integer);
+        }
+        i16 as_short() const
+        {
+            VERIFY(m_type == Value::Type::Short);
+            return static_cast<i16>(m_integer);
+        }
+        i32 as_int() const
+        {
+            VERIFY(m_type == Value::Type::Int);
+            return static_cast<i32>(m_integer);
+        }
+        i64 as_long() const
+        {
+            VERIFY(m_type == Value::Type::Long);
+            return m_integer;
+        }
+        float as_float() const
+        {
+            VERIFY(m_type == Value::Type::Float);
+            return static_cast<float>(m_floating);
+        }
+        double as_double() const
+        {
+            VERIFY(m_type == Value::Type::Double);
+            return m_floating;
+        }
+        StringView as_string() const
+        {
+            VERIFY(m_type == Value::Type::String);
+            return {reinterpret_cast<const char*>(m_bytes), m_length};
+        }
+
+        // The number of entries in a compound, elements in a list or array, or bytes in a string
+        size_t size() const { return m_length; }
+
+        // Compounds
+        const Node* get(StringView name) const;
+        const Entry* entries() const
+        {
+            VERIFY(m_type == Value::Type::Compound);
+            return m_entries;
+        }
+
+        // Lists
+        Value::Type element_type() const { return m_element_type; }
+        const Node& at(size_t index) const
+        {
+            VERIFY(m_type == Value::Type::List);
+            VERIFY(index < m_length);
+            return m_elements[index];
+        }
+
+        // ByteArray, IntArray and LongArray. These are kept in big endian, so element() converts them as they are read.
+        ReadonlyBytes array_bytes() const;
+
+        template<typename T>
+        T element(size_t index) const
+        {
+            VERIFY(index < m_length);
+            VERIFY(array_bytes().size() == m_length * sizeof(T));
+            BigEndian<T> value;
+            __builtin_memcpy(&value, m_bytes + index * sizeof(T), sizeof(T));
+            return value;
+        }
+
+        // Copies every element of an array into host order in bulk, which is much quicker than element() in a loop.
+        template<typename T>
+        void copy_elements_into(Span<T> destination) const
+        {
+            VERIFY(destination.size() == m_length);
+            VERIFY(array_bytes().size() == m_length * sizeof(T));
+            __builtin_memcpy(destination.data(), m_bytes, m_length * sizeof(T));
+            if constexpr (sizeof(T) > 1)
+                convert_between_host_and_big_endian(destination);
+        }
+
+    private:
+        friend Document;
+
+        Value::Type m_type{Value::Type::End};
+        Value::Type m_element_type{Value::Type::End};
+        u32 m_length{};
+
+        union
+        {
+            i64 m_integer;
+            double m_floating;
+            const u8* m_bytes;
+            Node* m_elements;
+            Entry* m_entries;
+        };
+    };
+
+    struct Entry
+    {
+        StringView name;
+        u32 name_hash;
+        Node value;
+    };
+
+    enum class ArrayStorage
+    {
+        // Array payloads are copied into the arena
+        Copy,
+        // Array payloads are left where they are, as views into the parsed buffer. This saves copying large arrays,
+        // but the buffer then has to outlive the Document.
+        Borrow
+    };
+
+    static Result<NonnullOwnPtr<Document>, String> parse(ReadonlyBytes, ArrayStorage = ArrayStorage::Copy);
+
+    StringView root_name() const { return m_root_name; }
+    const Node& root() const { return m_root; }
+
+    const Arena& arena() const { return m_arena; }
+
+private:
+    Document() = default;
+
+    Result<void, String> parse_node(Reader&, const Reader::Event&, Node&, size_t depth);
+
+    StringView intern(StringView);
+    StringView copy_into_arena(StringView);
+
+    Arena m_arena;
+    ArrayStorage m_array_storage{ArrayStorage::Copy};
+    StringView m_root_name;
+    Node m_root;
+
+    // Only used while parsing
+    HashTable<StringView> m_interned_names;
+    Vector<Vector<Entry>> m_compound_scratch;
+};
+}
@@ -0,0 +1,217 @@
+/*
+ * Copyright (c) 2021, James Puleo <james@jame.xyz>
+ *
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#include <AK/GenericLexer.h>
+#include <AK/MemoryStream.h>
+#include <LibCompress/Gzip.h>
+#include <LibMinecraft/NBT/Index.h>
+#include <LibMinecraft/NBT/Reader.h>
+
+namespace Minecraft::NBT
+{
+Result<NonnullOwnPtr<Index>, String> Index::create(ReadonlyBytes bytes)
+{
+    auto index = adopt_own(*new Index(bytes));
+
+    auto built = index->build();
+    if (built.is_error())
+        return built.release_error();
+
+    return index;
+}
+
+Result<NonnullOwnPtr<Index>, String> Index::map(const String& path)
+{
+    auto maybe_mapped_file = MappedFile::map(path);
+    if (maybe_mapped_file.is_error())
+        return maybe_mapped_file.release_error();
+
+    auto mapped_file = maybe_mapped_file.release_value();
+    auto bytes = mapped_file->bytes();
+
+    if (Compress::GzipDecompressor::is_likely_compressed(bytes))
+    {
+        auto maybe_decompressed = Compress::GzipDecompressor::decompress_all(bytes);
+        if (!maybe_decompressed.has_value())
+            return String::formatted("Unable to decompress {}", path);
+
+        auto index = adopt_own(*new Index({}));
+        index->m_decompressed = maybe_decompressed.release_value();
+        index->m_bytes = index->m_decompressed;
+
+        auto built = index->build();
+        if (built.is_error())
+            return built.release_error();
+
+        return index;
+    }
+
+    auto index = adopt_own(*new Index(bytes));
+    index->m_mapped_file = move(mapped_file);
+
+    auto built = index->build();
+    if (built.is_error())
+        return built.release_error();
+
+    return index;
+}
+
+Result<void, String> Index::build()
+{
+    Reader reader(m_bytes);
+    Vector<NodeIndex, 16> open_nodes;
+
+    while (true)
+    {
+        auto maybe_event = reader.next();
+        if (maybe_event.is_error())
+            return maybe_event.release_error();
+
+        auto& event = maybe_event.value();
+
+        if (event.kind == Reader::Event::Kind::DocumentEnd)
+            break;
+
+        if (event.kind == Reader::Event::Kind::CompoundEnd || event.kind == Reader::Event::Kind::ListEnd)
+        {
+            m_nodes[open_nodes.take_last()].subtree_end = m_nodes.size();
+            continue;
+        }
+
+        if (!open_nodes.is_empty() && m_nodes[open_nodes.last()].type == Value::Type::Compound)
+            m_nodes[open_nodes.last()].length++;
+
+        Node node{};
+        node.type = event.type;
+        node.name_hash = event.name.hash();
+        node.name_length = event.name.length();
+        node.name_offset = event.name.is_empty()
+                               ? 0
+                               : reinterpret_cast<const u8*>(event.name.characters_without_null_termination()) -
+                                     m_bytes.data();
+        node.payload_offset = event.offset;
+        node.subtree_end = m_nodes.size() + 1;
+
+        if (event.kind == Reader::Event::Kind::ListStart || event.kind == Reader::Event::Kind::Value)
+            node.length = event.length;
+
+        if (event.is_start())
+            open_nodes.append(m_nodes.size());
+
+        m_nodes.append(node);
+    }
+
+    return {};
+}
+
+StringView Index::name_of(NodeIndex index) const
+{
+    auto& node = m_nodes.at(index);
+    return {reinterpret_cast<const char*>(m_bytes.data() + node.name_offset), node.name_length};
+}
+
+Optional<Index::NodeIndex> Index::find_child(NodeIndex parent, StringView name) const
+{
+    auto& parent_node = m_nodes.at(parent);
+    if (parent_node.type != Value::Type::Compound)
+        return {};
+
+    auto hash = name.hash();
+
+    for (auto child = parent + 1; child < parent_node.subtree_end; child = m_nodes[child].subtree_end)
+    {
+        if (m_nodes[child].name_hash == hash && name_of(child) == name)
+            return child;
+    }
+
+    return {};
+}
+
+Optional<Index::NodeIndex> Index::child_at(NodeIndex parent, size_t index) const
+{
+    auto& parent_node = m_nodes.at(parent);
+    if (parent_node.type != Value::Type::List || index >= parent_node.length)
+        return {};
+
+    auto child = parent + 1;
+    for (size_t i = 0; i < index; i++)
+        child = m_nodes[child].subtree_end;
+
+    return child;
+}
+
+Optional<Index::NodeIndex> Index::resolve(StringView path) const
+{
+    if (m_nodes.is_empty())
+        return {};
+
+    GenericLexer lexer(path);
+    NodeIndex current = root;
+    bool first_segment = true;
+
+    while (!lexer.is_eof())
+    {
+        Optional<NodeIndex> next;
+
+        if (lexer.consume_specific('['))
+        {
+            if (lexer.consume_specific('"'))
+            {
+                // Quoted names may hold dots and brackets, but not quotes
+                auto name = lexer.consume_while([](char c) { return c != '"'; });
+                if (!lexer.consume_specific('"'))
+                    return {};
+
+                next = find_child(current, name);
+            }
+            else
+            {
+                auto maybe_element_index = lexer.consume_while([](char c) { return c != ']'; }).to_uint();
+                if (!maybe_element_index.has_value())
+                    return {};
+
+                next = child_at(current, *maybe_element_index);
+            }
+
+            if (!lexer.consume_specific(']'))
+                return {};
+        }
+        else
+        {
+            lexer.consume_specific('.');
+            auto name = lexer.consume_while([](char c) { return c != '.' && c != '['; });
+
+            next = find_child(current, name);
+            if (!next.has_value() && first_segment && name == name_of(root))
+                next = root;
+        }
+
+        if (!next.has_value())
+            return {};
+
+        current = *next;
+        first_segment = false;
+    }
+
+    return current;
+}
+
+Result<Value, String> Index::materialize(NodeIndex index) const
+{
+    auto& node = m_nodes.at(index);
+
+    InputMemoryStream stream(m_bytes.slice(node.payload_offset));
+    auto value = Value::read_value(node.type, stream);
+
+    if (stream.has_any_error())
+    {
+        stream.handle_any_error();
+        return String("Unexpected end of NBT data");
+    }
+
+    return value;
+}
+}
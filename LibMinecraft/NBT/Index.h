@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2021, James Puleo <james@jame.xyz>
+ *
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#pragma once
+
+#include <AK/ByteBuffer.h>
+#include <AK/NonnullOwnPtr.h>
+#include <AK/RefPtr.h>
+#include <AK/Result.h>
+#include <AK/StringView.h>
+#include <AK/Vector.h>
+#include <LibMinecraft/MappedFile.h>
+#include <LibMinecraft/NBT/Value.h>
+
+namespace Minecraft::NBT
+{
+// A flat index over an NBT document, built in one linear pass, which records where every tag is instead of decoding
+// it. Paths can then be looked up repeatedly for the cost of walking the index, and NBT::Values are only built for
+// the parts of the document that are actually used.
+//
+// Nodes are stored in document order, so the children of a node follow it directly, and a node's subtree ends where
+// its next sibling starts.
+class Index
+{
+    AK_MAKE_NONCOPYABLE(Index);
+    AK_MAKE_NONMOVABLE(Index);
+
+public:
+    using NodeIndex = u32;
+
+    struct Node
+    {
+        Value::Type type;
+        u16 name_length;
+        u32 name_hash;
+        u32 name_offset;
+        u32 payload_offset;
+        // The index just past the last node in this subtree
+        NodeIndex subtree_end;
+        // The number of children of a compound or list, or elements in an array
+        u32 length;
+    };
+
+    // The bytes must outlive the Index.
+    static Result<NonnullOwnPtr<Index>, String> create(ReadonlyBytes);
+
+    // Maps the file, and indexes it in place. Gzip compressed files have to be decompressed into memory first.
+    static Result<NonnullOwnPtr<Index>, String> map(const String& path);
+
+    static constexpr NodeIndex root = 0;
+
+    const Node& node(NodeIndex index) const { return m_nodes.at(index); }
+    size_t node_count() const { return m_nodes.size(); }
+    StringView name_of(NodeIndex) const;
+
+    Optional<NodeIndex> find_child(NodeIndex parent, StringView name) const;
+    Optional<NodeIndex> child_at(NodeIndex parent, size_t index) const;
+
+    // Resolves paths such as Schematic.Palette["minecraft:stone"] or Level.Sections[2].Y from the root. The root's own
+    // name may be given as the first part of the path, but doesn't have to be.
+    Optional<NodeIndex> resolve(StringView path) const;
+
+    // Decodes the subtree at this node into an NBT::Value.
+    Result<Value, String> materialize(NodeIndex) const;
+
+private:
+    explicit Index(ReadonlyBytes bytes) : m_bytes(bytes) {}
+
+    Result<void, String> build();
+
+    ReadonlyBytes m_bytes;
+    Vector<Node> m_nodes;
+
+    // Whatever m_bytes points into, if we own it
+    RefPtr<MappedFile> m_mapped_file;
+    ByteBuffer m_decompressed;
+};
+}
@@ -0,0 +1,386 @@
+/*
+ * Copyright (c) 2021, James Puleo <james@jame.xyz>
+ *
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#include <LibMinecraft/NBT/Reader.h>
+
+namespace Minecraft::NBT
+{
+size_t Reader::fixed_size_of(Value::Type type)
+{
+    switch (type)
+    {
+        case Value::Type::Byte:
+            return sizeof(i8);
+        case Value::Type::Short:
+            return sizeof(i16);
+        case Value::Type::Int:
+        case Value::Type::Float:
+            return sizeof(i32);
+        case Value::Type::Long:
+        case Value::Type::Double:
+            return sizeof(i64);
+        default:
+            return 0;
+    }
+}
+
+size_t Reader::min_size_of(Value::Type type)
+{
+    if (auto size = fixed_size_of(type); size != 0)
+        return size;
+
+    switch (type)
+    {
+        case Value::Type::String:
+            return sizeof(u16);
+        case Value::Type::ByteArray:
+        case Value::Type::IntArray:
+        case Value::Type::LongArray:
+            return sizeof(i32);
+        case Value::Type::List:
+            return sizeof(i8) + sizeof(i32);
+        case Value::Type::Compound:
+            return sizeof(i8);
+        default:
+            return 0;
+    }
+}
+
+Result<Value::Type, String> Reader::read_type()
+{
+    if (!has(1))
+        return String("Unexpected end of NBT data reading tag type");
+
+    auto type = static_cast<Value::Type>(m_bytes[m_offset++]);
+    if (static_cast<i8>(type) < static_cast<i8>(Value::Type::End) ||
+        static_cast<i8>(type) > static_cast<i8>(Value::Type::LongArray))
+        return String::formatted("Unknown NBT tag type {}", static_cast<i8>(type));
+
+    return type;
+}
+
+Result<StringView, String> Reader::read_string()
+{
+    if (!has(sizeof(u16)))
+        return String("Unexpected end of NBT data reading string length");
+
+    auto length = read_big_endian<u16>();
+    if (!has(length))
+        return String("Unexpected end of NBT data reading string");
+
+    StringView value(reinterpret_cast<const char*>(m_bytes.data() + m_offset), length);
+    m_offset += length;
+    return value;
+}
+
+Result<Reader::Event, String> Reader::read_payload(Value::Type type, StringView name)
+{
+    Event event;
+    event.kind = Event::Kind::Value;
+    event.type = type;
+    event.name = name;
+    event.offset = m_offset;
+
+    if (auto size = fixed_size_of(type); size != 0 && !has(size))
+        return String("Unexpected end of NBT data reading value");
+
+    switch (type)
+    {
+        case Value::Type::Byte:
+            event.integer = static_cast<i8>(m_bytes[m_offset++]);
+            break;
+        case Value::Type::Short:
+            event.integer = static_cast<i16>(read_big_endian<u16>());
+            break;
+        case Value::Type::Int:
+            event.integer = static_cast<i32>(read_big_endian<u32>());
+            break;
+        case Value::Type::Long:
+            event.integer = static_cast<i64>(read_big_endian<u64>());
+            break;
+        case Value::Type::Float:
+        {
+            auto bits = read_big_endian<u32>();
+            float value;
+            __builtin_memcpy(&value, &bits, sizeof(value));
+            event.floating = value;
+            break;
+        }
+        case Value::Type::Double:
+        {
+            auto bits = read_big_endian<u64>();
+            __builtin_memcpy(&event.floating, &bits, sizeof(event.floating));
+            break;
+        }
+        case Value::Type::String:
+        {
+            auto maybe_string = read_string();
+            if (maybe_string.is_error())
+                return maybe_string.release_error();
+
+            event.string = maybe_string.release_value();
+            break;
+        }
+        case Value::Type::ByteArray:
+        case Value::Type::IntArray:
+        case Value::Type::LongArray:
+        {
+            if (!has(sizeof(i32)))
+                return String("Unexpected end of NBT data reading array length");
+
+            event.length = static_cast<i32>(read_big_endian<u32>());
+            if (event.length < 0)
+                return String("Negative NBT array length");
+
+            size_t element_size = type == Value::Type::ByteArray ? sizeof(i8)
+                                  : type == Value::Type::IntArray ? sizeof(i32)
+                                                                  : sizeof(i64);
+            auto size = static_cast<size_t>(event.length) * element_size;
+            if (!has(size))
+                return String("Unexpected end of NBT data reading array");
+
+            event.array = m_bytes.slice(m_offset, size);
+            m_offset += size;
+            break;
+        }
+        case Value::Type::List:
+        {
+            if (m_frames.size() == max_depth)
+                return String("NBT is nested too deeply");
+
+            auto maybe_element_type = read_type();
+            if (maybe_element_type.is_error())
+                return maybe_element_type.release_error();
+
+            if (!has(sizeof(i32)))
+                return String("Unexpected end of NBT data reading list length");
+
+            event.kind = Event::Kind::ListStart;
+            event.element_type = maybe_element_type.release_value();
+            event.length = static_cast<i32>(read_big_endian<u32>());
+
+            // Lists of End are only valid when empty, and Java happily writes negative lengths for those.
+            if (event.length < 0 || (event.element_type == Value::Type::End && event.length != 0))
+                event.length = 0;
+
+            // Whoever reads the list may reserve this many elements up front, so it can't claim more than are left
+            if (static_cast<size_t>(event.length) * min_size_of(event.element_type) > m_bytes.size() - m_offset)
+                return String("NBT list is longer than the data left");
+
+            m_frames.append({Value::Type::List, event.element_type, event.length});
+            break;
+        }
+        case Value::Type::Compound:
+        {
+            if (m_frames.size() == max_depth)
+                return String("NBT is nested too deeply");
+
+            event.kind = Event::Kind::CompoundStart;
+            m_frames.append({Value::Type::Compound, Value::Type::End, 0});
+            break;
+        }
+        default:
+            return String::formatted("Unexpected NBT tag type {}", static_cast<i8>(type));
+    }
+
+    return event;
+}
+
+Result<Reader::Event, String> Reader::next()
+{
+    if (!m_started)
+    {
+        m_started = true;
+
+        auto maybe_type = read_type();
+        if (maybe_type.is_error())
+            return maybe_type.release_error();
+
+        if (maybe_type.value() != Value::Type::Compound)
+            return String("NBT does not start with Compound");
+
+        auto maybe_name = read_string();
+        if (maybe_name.is_error())
+            return maybe_name.release_error();
+
+        return read_payload(Value::Type::Compound, maybe_name.value());
+    }
+
+    if (m_frames.is_empty())
+        return Event{};
+
+    auto& frame = m_frames.last();
+
+    if (frame.type == Value::Type::List)
+    {
+        if (frame.remaining == 0)
+        {
+            m_frames.take_last();
+            Event event;
+            event.kind = Event::Kind::ListEnd;
+            event.type = Value::Type::List;
+            event.offset = m_offset;
+            return event;
+        }
+
+        frame.remaining--;
+        return read_payload(frame.element_type, {});
+    }
+
+    auto maybe_type = read_type();
+    if (maybe_type.is_error())
+        return maybe_type.release_error();
+
+    if (maybe_type.value() == Value::Type::End)
+    {
+        m_frames.take_last();
+        Event event;
+        event.kind = Event::Kind::CompoundEnd;
+        event.type = Value::Type::Compound;
+        event.offset = m_offset;
+        return event;
+    }
+
+    auto maybe_name = read_string();
+    if (maybe_name.is_error())
+        return maybe_name.release_error();
+
+    return read_payload(maybe_type.value(), maybe_name.value());
+}
+
+Result<void, String> Reader::skip_payload(Value::Type type, size_t depth)
+{
+    if (depth > max_depth)
+        return String("NBT is nested too deeply");
+
+    if (auto size = fixed_size_of(type); size != 0)
+    {
+        if (!has(size))
+            return String("Unexpected end of NBT data skipping value");
+        m_offset += size;
+        return {};
+    }
+
+    switch (type)
+    {
+        case Value::Type::String:
+        {
+            auto maybe_string = read_string();
+            if (maybe_string.is_error())
+                return maybe_string.release_error();
+            return {};
+        }
+        case Value::Type::ByteArray:
+        case Value::Type::IntArray:
+        case Value::Type::LongArray:
+        {
+            if (!has(sizeof(i32)))
+                return String("Unexpected end of NBT data skipping array");
+
+            auto length = static_cast<i32>(read_big_endian<u32>());
+            if (length < 0)
+                return String("Negative NBT array length");
+
+            size_t element_size = type == Value::Type::ByteArray ? sizeof(i8)
+                                  : type == Value::Type::IntArray ? sizeof(i32)
+                                                                  : sizeof(i64);
+            auto size = static_cast<size_t>(length) * element_size;
+            if (!has(size))
+                return String("Unexpected end of NBT data skipping array");
+
+            m_offset += size;
+            return {};
+        }
+        case Value::Type::List:
+        {
+            auto maybe_element_type = read_type();
+            if (maybe_element_type.is_error())
+                return maybe_element_type.release_error();
+
+            if (!has(sizeof(i32)))
+                return String("Unexpected end of NBT data skipping list");
+
+            auto length = static_cast<i32>(read_big_endian<u32>());
+            if (length <= 0 || maybe_element_type.value() == Value::Type::End)
+                return {};
+
+            // Lists of fixed size elements can be skipped in one go.
+            if (auto size = fixed_size_of(maybe_element_type.value()); size != 0)
+            {
+                auto total_size = static_cast<size_t>(length) * size;
+                if (!has(total_size))
+                    return String("Unexpected end of NBT data skipping list");
+
+                m_offset += total_size;
+                return {};
+            }
+
+            for (i32 i = 0; i < length; i++)
+            {
+                auto skipped = skip_payload(maybe_element_type.value(), depth + 1);
+                if (skipped.is_error())
+                    return skipped;
+            }
+
+            return {};
+        }
+        case Value::Type::Compound:
+        {
+            while (true)
+            {
+                auto maybe_type = read_type();
+                if (maybe_type.is_error())
+                    return maybe_type.release_error();
+
+                if (maybe_type.value() == Value::Type::End)
+                    return {};
+
+                auto maybe_name = read_string();
+                if (maybe_name.is_error())
+                    return maybe_name.release_error();
+
+                auto skipped = skip_payload(maybe_type.value(), depth + 1);
+                if (skipped.is_error())
+                    return skipped;
+            }
+        }
+        default:
+            return String::formatted("Unexpected NBT tag type {}", static_cast<i8>(type));
+    }
+}
+
+Result<void, String> Reader::skip()
+{
+    VERIFY(!m_frames.is_empty());
+
+    auto frame = m_frames.take_last();
+
+    if (frame.type == Value::Type::Compound)
+        return skip_payload(Value::Type::Compound, m_frames.size());
+
+    if (frame.remaining == 0 || frame.element_type == Value::Type::End)
+        return {};
+
+    if (auto size = fixed_size_of(frame.element_type); size != 0)
+    {
+        auto total_size = static_cast<size_t>(frame.remaining) * size;
+        if (!has(total_size))
+            return String("Unexpected end of NBT data skipping list");
+
+        m_offset += total_size;
+        return {};
+    }
+
+    for (i32 i = 0; i < frame.remaining; i++)
+    {
+        auto skipped = skip_payload(frame.element_type, m_frames.size());
+        if (skipped.is_error())
+            return skipped;
+    }
+
+    return {};
+}
+}
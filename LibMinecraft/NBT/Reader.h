@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) 2021, James Puleo <james@jame.xyz>
+ *
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#pragma once
+
+#include <AK/Result.h>
+#include <AK/Span.h>
+#include <AK/StringView.h>
+#include <AK/Vector.h>
+#include <LibMinecraft/NBT/Value.h>
+
+namespace Minecraft::NBT
+{
+// A streaming NBT parser, which walks a buffer one tag at a time instead of building a tree of Values. Names, strings
+// and array payloads are handed out as views into the buffer, so nothing is allocated, and whole compounds or lists
+// can be skipped over without looking at them.
+//
+// Everything handed out by the Reader is only valid for as long as the buffer it reads from.
+class Reader
+{
+public:
+    struct Event
+    {
+        enum class Kind
+        {
+            CompoundStart,
+            CompoundEnd,
+            ListStart,
+            ListEnd,
+            Value,
+            DocumentEnd
+        };
+
+        Kind kind{Kind::DocumentEnd};
+        Value::Type type{Value::Type::End};
+
+        // Empty for list elements, and for end events
+        StringView name;
+
+        // Where the payload of this tag starts in the buffer
+        size_t offset{};
+
+        // Byte, Short, Int and Long
+        i64 integer{};
+        // Float and Double
+        double floating{};
+        // String
+        StringView string;
+        // ByteArray, IntArray and LongArray, still in big endian
+        ReadonlyBytes array;
+        // The number of elements in an array or a list
+        i32 length{};
+        // The type of the elements in a list
+        Value::Type element_type{Value::Type::End};
+
+        bool is_start() const { return kind == Kind::CompoundStart || kind == Kind::ListStart; }
+    };
+
+    explicit Reader(ReadonlyBytes bytes) : m_bytes(bytes) {}
+
+    Result<Event, String> next();
+
+    // Skips over the rest of the compound or list that was most recently started, including its end event.
+    Result<void, String> skip();
+
+    size_t depth() const { return m_frames.size(); }
+    size_t offset() const { return m_offset; }
+    ReadonlyBytes bytes() const { return m_bytes; }
+
+    // How many bytes each element of a fixed size type takes up, or 0 for types without a fixed size.
+    static size_t fixed_size_of(Value::Type);
+
+    // The fewest bytes a value of the type can take up, which bounds how many elements a list can claim to have
+    static size_t min_size_of(Value::Type);
+
+    // The same limit as vanilla, which stops malicious documents from overflowing our stack.
+    static constexpr size_t max_depth = 512;
+
+private:
+    struct Frame
+    {
+        Value::Type type;
+        Value::Type element_type;
+        i32 remaining;
+    };
+
+    Result<Event, String> read_payload(Value::Type, StringView name);
+    Result<void, String> skip_payload(Value::Type, size_t depth);
+
+    bool has(size_t count) const { return m_offset + count <= m_bytes.size(); }
+
+    template<typename T>
+    T read_big_endian()
+    {
+        BigEndian<T> value;
+        __builtin_memcpy(&value, m_bytes.data() + m_offset, sizeof(T));
+        m_offset += sizeof(T);
+        return value;
+    }
+
+    Result<StringView, String> read_string();
+    Result<Value::Type, String> read_type();
+
+    ReadonlyBytes m_bytes;
+    size_t m_offset{};
+    bool m_started{};
+    Vector<Frame, 16> m_frames;
+};
+}
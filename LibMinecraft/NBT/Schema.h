@@ -0,0 +1,393 @@
+/*
+ * Copyright (c) 2021, James Puleo <james@jame.xyz>
+ *
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#pragma once
+
+#include <AK/Optional.h>
+#include <AK/Result.h>
+#include <AK/String.h>
+#include <AK/StringView.h>
+#include <AK/Vector.h>
+#include <LibMinecraft/NBT/Reader.h>
+
+// Binds NBT compounds straight to C++ structs. A struct describes its fields once, by giving a static nbt_schema()
+// function:
+//
+//     struct Point
+//     {
+//         i32 x{};
+//         i32 y{};
+//         Optional<String> label;
+//
+//         static constexpr auto nbt_schema()
+//         {
+//             return NBT::schema(NBT::required("X", &Point::x), NBT::required("Y", &Point::y),
+//                                NBT::optional("Label", &Point::label));
+//         }
+//     };
+//
+// and NBT::decode() fills it in from a Reader, checking types and required fields as it goes. Tags the schema doesn't
+// mention are skipped without being looked at, and no NBT::Values are built along the way.
+//
+// StringView and ReadonlyBytes fields point into the buffer being read, like everything else handed out by the Reader.
+namespace Minecraft::NBT
+{
+// A tag with its name, for compounds whose keys aren't known up front (like a schematic's palette)
+template<typename T>
+struct Named
+{
+    StringView name;
+    T value;
+};
+
+template<typename T>
+struct FieldTraits;
+
+template<typename T>
+concept HasSchema = requires
+{
+    T::nbt_schema();
+};
+
+template<typename T>
+Result<void, String> decode(Reader&, T&) requires HasSchema<T>;
+
+namespace Detail
+{
+template<typename T, Value::Type tag_type>
+struct IntegerFieldTraits
+{
+    static constexpr Value::Type type = tag_type;
+
+    static Result<void, String> decode(Reader&, const Reader::Event& event, T& out)
+    {
+        out = static_cast<T>(event.integer);
+        return {};
+    }
+};
+
+template<typename T, Value::Type tag_type>
+struct FloatingFieldTraits
+{
+    static constexpr Value::Type type = tag_type;
+
+    static Result<void, String> decode(Reader&, const Reader::Event& event, T& out)
+    {
+        out = static_cast<T>(event.floating);
+        return {};
+    }
+};
+
+// Decodes the value of one tag, after checking it is the type we expect.
+template<typename T>
+Result<void, String> decode_tag(Reader& reader, const Reader::Event& event, StringView name, T& out)
+{
+    if (event.type != FieldTraits<T>::type)
+        return String::formatted("Field \"{}\" has the wrong type", name);
+
+    return FieldTraits<T>::decode(reader, event, out);
+}
+
+// Skips a tag we aren't interested in, which for compounds and lists means everything up to their end.
+inline Result<void, String> skip_tag(Reader& reader, const Reader::Event& event)
+{
+    if (!event.is_start())
+        return {};
+
+    return reader.skip();
+}
+}
+
+template<>
+struct FieldTraits<i8> : Detail::IntegerFieldTraits<i8, Value::Type::Byte>
+{
+};
+template<>
+struct FieldTraits<i16> : Detail::IntegerFieldTraits<i16, Value::Type::Short>
+{
+};
+template<>
+struct FieldTraits<i32> : Detail::IntegerFieldTraits<i32, Value::Type::Int>
+{
+};
+template<>
+struct FieldTraits<i64> : Detail::IntegerFieldTraits<i64, Value::Type::Long>
+{
+};
+template<>
+struct FieldTraits<float> : Detail::FloatingFieldTraits<float, Value::Type::Float>
+{
+};
+template<>
+struct FieldTraits<double> : Detail::FloatingFieldTraits<double, Value::Type::Double>
+{
+};
+
+template<>
+struct FieldTraits<StringView>
+{
+    static constexpr Value::Type type = Value::Type::String;
+
+    static Result<void, String> decode(Reader&, const Reader::Event& event, StringView& out)
+    {
+        out = event.string;
+        return {};
+    }
+};
+
+template<>
+struct FieldTraits<String>
+{
+    static constexpr Value::Type type = Value::Type::String;
+
+    static Result<void, String> decode(Reader&, const Reader::Event& event, String& out)
+    {
+        out = event.string.to_string();
+        return {};
+    }
+};
+
+// Byte arrays are handed out as a view of the buffer, as they need no byte swapping.
+template<>
+struct FieldTraits<ReadonlyBytes>
+{
+    static constexpr Value::Type type = Value::Type::ByteArray;
+
+    static Result<void, String> decode(Reader&, const Reader::Event& event, ReadonlyBytes& out)
+    {
+        out = event.array;
+        return {};
+    }
+};
+
+template<typename T>
+struct FieldTraits<Optional<T>>
+{
+    static constexpr Value::Type type = FieldTraits<T>::type;
+
+    static Result<void, String> decode(Reader& reader, const Reader::Event& event, Optional<T>& out)
+    {
+        T value{};
+        auto decoded = FieldTraits<T>::decode(reader, event, value);
+        if (decoded.is_error())
+            return decoded.release_error();
+
+        out = move(value);
+        return {};
+    }
+};
+
+template<typename T>
+requires HasSchema<T>
+struct FieldTraits<T>
+{
+    static constexpr Value::Type type = Value::Type::Compound;
+
+    static Result<void, String> decode(Reader& reader, const Reader::Event&, T& out)
+    {
+        return NBT::decode(reader, out);
+    }
+};
+
+template<typename T>
+struct FieldTraits<Vector<T>>
+{
+    static constexpr Value::Type type = Value::Type::List;
+
+    static Result<void, String> decode(Reader& reader, const Reader::Event& list_event, Vector<T>& out)
+    {
+        // An empty list may not say what it would have held
+        if (list_event.length != 0 && list_event.element_type != FieldTraits<T>::type)
+            return String::formatted("List \"{}\" has elements of the wrong type", list_event.name);
+
+        // Not reserved up front, as the length comes from the document. Even bounded by the bytes left, it could claim
+        // far more memory for our elements than the document takes up.
+
+        while (true)
+        {
+            auto maybe_event = reader.next();
+            if (maybe_event.is_error())
+                return maybe_event.release_error();
+
+            auto& event = maybe_event.value();
+            if (event.kind == Reader::Event::Kind::ListEnd)
+                return {};
+
+            T element{};
+            auto decoded = FieldTraits<T>::decode(reader, event, element);
+            if (decoded.is_error())
+                return decoded.release_error();
+
+            out.append(move(element));
+        }
+    }
+};
+
+template<typename T>
+struct FieldTraits<Vector<Named<T>>>
+{
+    static constexpr Value::Type type = Value::Type::Compound;
+
+    static Result<void, String> decode(Reader& reader, const Reader::Event&, Vector<Named<T>>& out)
+    {
+        while (true)
+        {
+            auto maybe_event = reader.next();
+            if (maybe_event.is_error())
+                return maybe_event.release_error();
+
+            auto& event = maybe_event.value();
+            if (event.kind == Reader::Event::Kind::CompoundEnd)
+                return {};
+
+            Named<T> entry{event.name, {}};
+            auto decoded = Detail::decode_tag(reader, event, event.name, entry.value);
+            if (decoded.is_error())
+                return decoded.release_error();
+
+            out.append(move(entry));
+        }
+    }
+};
+
+template<typename Struct, typename Member>
+struct Field
+{
+    StringView name;
+    Member Struct::*member;
+    bool is_required;
+};
+
+template<typename Struct, typename Member>
+constexpr Field<Struct, Member> required(StringView name, Member Struct::*member)
+{
+    return {name, member, true};
+}
+
+template<typename Struct, typename Member>
+constexpr Field<Struct, Member> optional(StringView name, Member Struct::*member)
+{
+    return {name, member, false};
+}
+
+template<typename Struct, typename... Members>
+class Schema;
+
+template<typename Struct>
+class Schema<Struct>
+{
+public:
+    static constexpr size_t field_count = 0;
+
+    constexpr Schema() = default;
+
+    Result<bool, String> decode_field(Reader&, const Reader::Event&, Struct&, u64&, size_t) const { return false; }
+    Optional<StringView> first_missing_field(u64, size_t) const { return {}; }
+};
+
+template<typename Struct, typename First, typename... Rest>
+class Schema<Struct, First, Rest...>
+{
+public:
+    static constexpr size_t field_count = 1 + sizeof...(Rest);
+
+    constexpr Schema(Field<Struct, First> first, Field<Struct, Rest>... rest) : m_first(first), m_rest(rest...) {}
+
+    // Decodes the event into the field with the same name, if there is one, and returns whether there was.
+    Result<bool, String> decode_field(Reader& reader, const Reader::Event& event, Struct& out, u64& seen_fields,
+                                      size_t field_index) const
+    {
+        if (event.name != m_first.name)
+            return m_rest.decode_field(reader, event, out, seen_fields, field_index + 1);
+
+        auto decoded = Detail::decode_tag(reader, event, m_first.name, out.*m_first.member);
+        if (decoded.is_error())
+            return decoded.release_error();
+
+        seen_fields |= static_cast<u64>(1) << field_index;
+        return true;
+    }
+
+    Optional<StringView> first_missing_field(u64 seen_fields, size_t field_index) const
+    {
+        if (m_first.is_required && !(seen_fields & (static_cast<u64>(1) << field_index)))
+            return m_first.name;
+
+        return m_rest.first_missing_field(seen_fields, field_index + 1);
+    }
+
+private:
+    Field<Struct, First> m_first;
+    Schema<Struct, Rest...> m_rest;
+};
+
+template<typename Struct, typename... Members>
+constexpr Schema<Struct, Members...> schema(Field<Struct, Members>... fields)
+{
+    static_assert(sizeof...(Members) <= 64, "Schemas are limited to 64 fields");
+    return {fields...};
+}
+
+// Decodes the rest of the compound the Reader has just started into a struct, including its end.
+template<typename T>
+Result<void, String> decode(Reader& reader, T& out) requires HasSchema<T>
+{
+    constexpr auto fields = T::nbt_schema();
+    u64 seen_fields = 0;
+
+    while (true)
+    {
+        auto maybe_event = reader.next();
+        if (maybe_event.is_error())
+            return maybe_event.release_error();
+
+        auto& event = maybe_event.value();
+
+        if (event.kind == Reader::Event::Kind::CompoundEnd)
+            break;
+
+        if (event.kind == Reader::Event::Kind::DocumentEnd)
+            return String("Unexpected end of NBT data");
+
+        auto maybe_decoded = fields.decode_field(reader, event, out, seen_fields, 0);
+        if (maybe_decoded.is_error())
+            return maybe_decoded.release_error();
+
+        if (maybe_decoded.value())
+            continue;
+
+        auto skipped = Detail::skip_tag(reader, event);
+        if (skipped.is_error())
+            return skipped.release_error();
+    }
+
+    if (auto missing = fields.first_missing_field(seen_fields, 0); missing.has_value())
+        return String::formatted("Missing required \"{}\" field", *missing);
+
+    return {};
+}
+
+// Decodes a whole uncompressed document, whose root compound is described by T.
+template<typename T>
+Result<T, String> decode_document(ReadonlyBytes bytes) requires HasSchema<T>
+{
+    Reader reader(bytes);
+
+    auto maybe_root = reader.next();
+    if (maybe_root.is_error())
+        return maybe_root.release_error();
+
+    if (maybe_root.value().kind != Reader::Event::Kind::CompoundStart)
+        return String("Root tag is not a compound");
+
+    T value{};
+    auto decoded = decode(reader, value);
+    if (decoded.is_error())
+        return decoded.release_error();
+
+    return value;
+}
+}
@@ -4,6 +4,7 @@
  * SPDX-License-Identifier: GPL-3.0-only
  */
 
+#include <LibMinecraft/NBT/ByteSwap.h>
 #include <LibMinecraft/NBT/Value.h>
 
 namespace Minecraft::NBT
@@ -64,14 +65,8 @@ Value Value::read_value(Type tag, InputStream& stream)
             stream >> length;
 
             Vector<i8> values;
-            values.ensure_capacity(length);
-            i8 individual_value;
-
-            for (auto i = 0; i < length; i++)
-            {
-                stream >> individual_value;
-                values.unchecked_append(individual_value);
-            }
+            values.resize(max<i32>(length, 0));
+            stream.read_or_error({values.data(), values.size()});
 
             return values;
         }
@@ -99,15 +94,11 @@ Value Value::read_value(Type tag, InputStream& stream)
             BigEndian<i32> length;
             stream >> length;
 
+            // Read the whole array in one go, and then swap it to host order all at once.
             Vector<i32> values;
-            values.ensure_capacity(length);
-            BigEndian<i32> individual_value;
-
-            for (auto i = 0; i < length; i++)
-            {
-                stream >> individual_value;
-                values.unchecked_append(individual_value);
-            }
+            values.resize(max<i32>(length, 0));
+            stream.read_or_error({values.data(), values.size() * sizeof(i32)});
+            convert_between_host_and_big_endian(values.span());
 
             return values;
         }
@@ -116,15 +107,11 @@ Value Value::read_value(Type tag, InputStream& stream)
             BigEndian<i32> length;
             stream >> length;
 
+            // Read the whole array in one go, and then swap it to host order all at once.
             Vector<i64> values;
-            values.ensure_capacity(length);
-            BigEndian<i64> individual_value;
-
-            for (auto i = 0; i < length; i++)
-            {
-                stream >> individual_value;
-                values.unchecked_append(individual_value);
-            }
+            values.resize(max<i32>(length, 0));
+            stream.read_or_error({values.data(), values.size() * sizeof(i64)});
+            convert_between_host_and_big_endian(values.span());
 
             return values;
         }
@@ -147,6 +134,39 @@ Value Value::read_value(Type tag, InputStream& stream)
     }
 }
 
+static size_t string_heap_size(const String& string)
+{
+    if (string.is_null())
+        return 0;
+
+    return sizeof(StringImpl) + string.length() + 1;
+}
+
+size_t Value::heap_size() const
+{
+    return m_value.visit(
+        [](const Vector<i8>& array) { return array.capacity() * sizeof(i8); },
+        [](const Vector<i32>& array) { return array.capacity() * sizeof(i32); },
+        [](const Vector<i64>& array) { return array.capacity() * sizeof(i64); },
+        [](const String& string) { return string_heap_size(string); },
+        [](List* const& list) {
+            // Elements live in the vector's storage, so only what they point to is added on top of it
+            size_t size = sizeof(List) + list->capacity() * sizeof(Value);
+            for (auto& element : *list)
+                size += element.heap_size();
+            return size;
+        },
+        [](Compound* const& compound) {
+            // Each bucket holds an entry, and the state of the bucket, padded to the entry's alignment
+            size_t size =
+                sizeof(Compound) + compound->capacity() * (sizeof(Compound::Entry) + alignof(Compound::Entry));
+            for (auto& entry : *compound)
+                size += string_heap_size(entry.key) + entry.value.heap_size();
+            return size;
+        },
+        [](const auto&) -> size_t { return 0; });
+}
+
 Result<Value, String> Value::try_parse(InputStream& stream)
 {
     // Unclear specification: The original specification just says "byte". In Java, this is signed, so let's
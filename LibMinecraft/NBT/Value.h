@@ -115,6 +115,10 @@ public:
 
     static Result<Value, String> try_parse(InputStream&);
 
+    // Roughly how many bytes this value has allocated on the heap, for itself and everything under it. This is what it
+    // costs to keep a tree in memory, which is usually several times the size of the NBT it was parsed from.
+    size_t heap_size() const;
+
     enum class Type : i8
     {
         End = 0,
@@ -154,5 +158,6 @@ private:
     static Value read_value(Type, InputStream&);
 
     friend AK::Formatter<Minecraft::NBT::Value>;
+    friend class Index;
 };
 }
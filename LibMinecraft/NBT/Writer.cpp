@@ -0,0 +1,326 @@
+/*
+ * Copyright (c) 2021, James Puleo <james@jame.xyz>
+ *
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#include <AK/Array.h>
+#include <AK/MemoryStream.h>
+#include <AK/NumericLimits.h>
+#include <LibMinecraft/NBT/ByteSwap.h>
+#include <LibMinecraft/NBT/Writer.h>
+
+namespace Minecraft::NBT
+{
+Value::Type Writer::type_of(const Value& value)
+{
+    auto& variant = value.get();
+
+    if (variant.has<i8>())
+        return Value::Type::Byte;
+    if (variant.has<BigEndian<i16>>())
+        return Value::Type::Short;
+    if (variant.has<BigEndian<i32>>())
+        return Value::Type::Int;
+    if (variant.has<BigEndian<i64>>())
+        return Value::Type::Long;
+    if (variant.has<BigEndian<float>>())
+        return Value::Type::Float;
+    if (variant.has<BigEndian<double>>())
+        return Value::Type::Double;
+    if (variant.has<Vector<i8>>())
+        return Value::Type::ByteArray;
+    if (variant.has<String>())
+        return Value::Type::String;
+    if (variant.has<Value::List*>())
+        return Value::Type::List;
+    if (variant.has<Value::Compound*>())
+        return Value::Type::Compound;
+    if (variant.has<Vector<i32>>())
+        return Value::Type::IntArray;
+    if (variant.has<Vector<i64>>())
+        return Value::Type::LongArray;
+
+    // This Value has been moved from
+    VERIFY_NOT_REACHED();
+}
+
+void Writer::write_type(Value::Type type) { m_stream << type; }
+
+Result<void, String> Writer::write_string(StringView value)
+{
+    if (value.length() > NumericLimits<u16>::max())
+        return String::formatted("NBT string of {} bytes is too long for its length prefix", value.length());
+
+    m_stream << BigEndian<u16>(value.length());
+    m_stream.write_or_error(value.bytes());
+    return {};
+}
+
+template<typename T>
+void Writer::write_array(const Vector<T>& values)
+{
+    m_stream << BigEndian<i32>(values.size());
+
+    if constexpr (sizeof(T) == 1)
+    {
+        m_stream.write_or_error({values.data(), values.size()});
+    }
+    else
+    {
+        // Swap through a fixed scratch buffer, so large arrays are converted and written in bulk without having to
+        // allocate a copy of the whole thing.
+        Array<T, 1024> scratch;
+
+        for (size_t offset = 0; offset < values.size(); offset += scratch.size())
+        {
+            auto count = min(scratch.size(), values.size() - offset);
+            __builtin_memcpy(scratch.data(), values.data() + offset, count * sizeof(T));
+            convert_between_host_and_big_endian(Span<T>(scratch.data(), count));
+            m_stream.write_or_error({scratch.data(), count * sizeof(T)});
+        }
+    }
+}
+
+Result<void, String> Writer::write_payload(const Value& value)
+{
+    auto& variant = value.get();
+
+    switch (type_of(value))
+    {
+        case Value::Type::Byte:
+            m_stream << variant.get<i8>();
+            break;
+        case Value::Type::Short:
+            m_stream << variant.get<BigEndian<i16>>();
+            break;
+        case Value::Type::Int:
+            m_stream << variant.get<BigEndian<i32>>();
+            break;
+        case Value::Type::Long:
+            m_stream << variant.get<BigEndian<i64>>();
+            break;
+        case Value::Type::Float:
+            m_stream << variant.get<BigEndian<float>>();
+            break;
+        case Value::Type::Double:
+            m_stream << variant.get<BigEndian<double>>();
+            break;
+        case Value::Type::ByteArray:
+            write_array(variant.get<Vector<i8>>());
+            break;
+        case Value::Type::IntArray:
+            write_array(variant.get<Vector<i32>>());
+            break;
+        case Value::Type::LongArray:
+            write_array(variant.get<Vector<i64>>());
+            break;
+        case Value::Type::String:
+            return write_string(variant.get<String>());
+        case Value::Type::List:
+        {
+            auto& list = *variant.get<Value::List*>();
+            write_type(list.is_empty() ? Value::Type::End : type_of(list.first()));
+            m_stream << BigEndian<i32>(list.size());
+
+            for (auto& element : list)
+            {
+                auto written = write_payload(element);
+                if (written.is_error())
+                    return written;
+            }
+            break;
+        }
+        case Value::Type::Compound:
+        {
+            for (auto& kv : *variant.get<Value::Compound*>())
+            {
+                write_type(type_of(kv.value));
+                auto written = write_string(kv.key);
+                if (!written.is_error())
+                    written = write_payload(kv.value);
+                if (written.is_error())
+                    return written;
+            }
+            write_type(Value::Type::End);
+            break;
+        }
+        default:
+            VERIFY_NOT_REACHED();
+    }
+
+    return {};
+}
+
+Result<void, String> Writer::write_document(StringView root_name, const Value& root)
+{
+    VERIFY(type_of(root) == Value::Type::Compound);
+
+    write_type(Value::Type::Compound);
+    auto written = write_string(root_name);
+    if (written.is_error())
+        return written;
+
+    return write_payload(root);
+}
+
+size_t Writer::encoded_payload_size(const Value& value)
+{
+    auto& variant = value.get();
+
+    switch (type_of(value))
+    {
+        case Value::Type::Byte:
+            return sizeof(i8);
+        case Value::Type::Short:
+            return sizeof(i16);
+        case Value::Type::Int:
+        case Value::Type::Float:
+            return sizeof(i32);
+        case Value::Type::Long:
+        case Value::Type::Double:
+            return sizeof(i64);
+        case Value::Type::ByteArray:
+            return sizeof(i32) + variant.get<Vector<i8>>().size();
+        case Value::Type::IntArray:
+            return sizeof(i32) + variant.get<Vector<i32>>().size() * sizeof(i32);
+        case Value::Type::LongArray:
+            return sizeof(i32) + variant.get<Vector<i64>>().size() * sizeof(i64);
+        case Value::Type::String:
+            return sizeof(u16) + variant.get<String>().length();
+        case Value::Type::List:
+        {
+            size_t size = sizeof(Value::Type) + sizeof(i32);
+            for (auto& element : *variant.get<Value::List*>())
+                size += encoded_payload_size(element);
+            return size;
+        }
+        case Value::Type::Compound:
+        {
+            size_t size = sizeof(Value::Type);
+            for (auto& kv : *variant.get<Value::Compound*>())
+                size += sizeof(Value::Type) + sizeof(u16) + kv.key.length() + encoded_payload_size(kv.value);
+            return size;
+        }
+        default:
+            VERIFY_NOT_REACHED();
+    }
+}
+
+size_t Writer::encoded_size(StringView root_name, const Value& root)
+{
+    return sizeof(Value::Type) + sizeof(u16) + root_name.length() + encoded_payload_size(root);
+}
+
+Result<ByteBuffer, String> Writer::encode(StringView root_name, const Value& root)
+{
+    auto buffer = ByteBuffer::create_uninitialized(encoded_size(root_name, root));
+    OutputMemoryStream stream(buffer);
+
+    Writer writer(stream);
+    auto written = writer.write_document(root_name, root);
+    if (written.is_error())
+        return written.release_error();
+    VERIFY(stream.size() == buffer.size());
+
+    return buffer;
+}
+
+Result<void, String> Writer::write_event(const Reader::Event& event)
+{
+    using Kind = Reader::Event::Kind;
+
+    if (event.kind == Kind::DocumentEnd)
+        return {};
+
+    if (event.kind == Kind::CompoundEnd || event.kind == Kind::ListEnd)
+    {
+        auto expected_type = event.kind == Kind::CompoundEnd ? Value::Type::Compound : Value::Type::List;
+        if (m_frames.is_empty() || m_frames.last().type != expected_type)
+            return String("NBT end event doesn't match the container it ends");
+
+        if (expected_type == Value::Type::List && m_frames.last().remaining != 0)
+            return String("NBT list ended before all of its elements were written");
+
+        m_frames.take_last();
+        if (expected_type == Value::Type::Compound)
+            write_type(Value::Type::End);
+
+        return {};
+    }
+
+    if (m_frames.is_empty())
+    {
+        if (m_wrote_root || event.kind != Kind::CompoundStart)
+            return String("NBT documents must have exactly one root Compound");
+        m_wrote_root = true;
+    }
+
+    // Elements of a list don't have their own type or name.
+    if (!m_frames.is_empty() && m_frames.last().type == Value::Type::List)
+    {
+        if (m_frames.last().remaining == 0)
+            return String("NBT list has more elements than it said it would");
+        m_frames.last().remaining--;
+    }
+    else
+    {
+        write_type(event.type);
+        auto written = write_string(event.name);
+        if (written.is_error())
+            return written;
+    }
+
+    switch (event.type)
+    {
+        case Value::Type::Byte:
+            m_stream << static_cast<i8>(event.integer);
+            break;
+        case Value::Type::Short:
+            m_stream << BigEndian<i16>(event.integer);
+            break;
+        case Value::Type::Int:
+            m_stream << BigEndian<i32>(event.integer);
+            break;
+        case Value::Type::Long:
+            m_stream << BigEndian<i64>(event.integer);
+            break;
+        case Value::Type::Float:
+        {
+            float value = event.floating;
+            u32 bits;
+            __builtin_memcpy(&bits, &value, sizeof(bits));
+            m_stream << BigEndian<u32>(bits);
+            break;
+        }
+        case Value::Type::Double:
+        {
+            u64 bits;
+            __builtin_memcpy(&bits, &event.floating, sizeof(bits));
+            m_stream << BigEndian<u64>(bits);
+            break;
+        }
+        case Value::Type::String:
+            return write_string(event.string);
+        case Value::Type::ByteArray:
+        case Value::Type::IntArray:
+        case Value::Type::LongArray:
+            // Array payloads from the Reader are still in big endian, so they can be written as they are.
+            m_stream << BigEndian<i32>(event.length);
+            m_stream.write_or_error(event.array);
+            break;
+        case Value::Type::List:
+            write_type(event.element_type);
+            m_stream << BigEndian<i32>(event.length);
+            m_frames.append({Value::Type::List, event.length});
+            break;
+        case Value::Type::Compound:
+            m_frames.append({Value::Type::Compound, 0});
+            break;
+        default:
+            return String::formatted("Unexpected NBT tag type {}", static_cast<i8>(event.type));
+    }
+
+    return {};
+}
+}
@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2021, James Puleo <james@jame.xyz>
+ *
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#pragma once
+
+#include <AK/ByteBuffer.h>
+#include <AK/Result.h>
+#include <AK/Stream.h>
+#include <AK/StringView.h>
+#include <AK/Vector.h>
+#include <LibMinecraft/NBT/Reader.h>
+#include <LibMinecraft/NBT/Value.h>
+
+namespace Minecraft::NBT
+{
+// Writes NBT, either from a tree of Values, or from the same events NBT::Reader produces, so a document can be
+// streamed from one to the other without ever building a tree.
+//
+// Wrap the output in a CompressedOutputStream to write compressed NBT without buffering the whole document.
+class Writer
+{
+public:
+    explicit Writer(OutputStream& stream) : m_stream(stream) {}
+
+    // The root must be a Compound. Fails on strings that are too long for their length prefix, in which case part of
+    // the document may already have been written.
+    Result<void, String> write_document(StringView root_name, const Value& root);
+
+    // Exactly how many bytes write_document() will write
+    static size_t encoded_size(StringView root_name, const Value& root);
+
+    // Encodes a whole document into a buffer that is allocated up front, at exactly the right size.
+    static Result<ByteBuffer, String> encode(StringView root_name, const Value& root);
+
+    Result<void, String> write_event(const Reader::Event&);
+
+    static Value::Type type_of(const Value&);
+
+private:
+    void write_type(Value::Type);
+    Result<void, String> write_string(StringView);
+    Result<void, String> write_payload(const Value&);
+
+    template<typename T>
+    void write_array(const Vector<T>&);
+
+    static size_t encoded_payload_size(const Value&);
+
+    struct Frame
+    {
+        Value::Type type;
+        i32 remaining;
+    };
+
+    OutputStream& m_stream;
+    Vector<Frame, 16> m_frames;
+    bool m_wrote_root{};
+};
+}
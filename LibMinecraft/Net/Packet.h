@@ -7,6 +7,7 @@
 #pragma once
 
 #include <AK/ByteBuffer.h>
+#include <AK/Optional.h>
 #include <LibMinecraft/Net/Types.h>
 
 namespace Minecraft::Net
@@ -69,6 +70,12 @@ public:
 
     virtual const char* packet_name() const { VERIFY_NOT_REACHED(); }
 
+    virtual i32 id() const { VERIFY_NOT_REACHED(); }
+
+    // Packets that only set some state on the client, where receiving the same packet twice changes nothing, return a
+    // hash of their contents. This lets us skip sending them again when nothing has changed.
+    virtual Optional<u64> idempotent_state_hash() const { return {}; }
+
     virtual ByteBuffer to_bytes() const { VERIFY_NOT_REACHED(); }
 };
 }
\ No newline at end of file
@@ -14,38 +14,47 @@ ByteBuffer Response::to_bytes() const
 
     Types::write_leb_signed(stream, static_cast<i32>(Id::Status::Clientbound::Response));
 
-    JsonObject object;
-    JsonObject version;
-    JsonObject players;
+    thread_local StringBuilder builder;
+    builder.clear();
 
-    version.set("name", m_data.version.name);
-    version.set("protocol", m_data.version.protocol);
+    builder.append("{\"version\":{\"name\":");
+    Chat::Component::append_json_string(builder, m_data.version.name);
+    builder.appendff(",\"protocol\":{}}},\"players\":{{\"max\":{},\"online\":{}", m_data.version.protocol,
+                     m_data.players.max, m_data.players.online);
 
-    players.set("max", m_data.players.max);
-    players.set("online", m_data.players.online);
     if (!m_data.players.sample.is_empty())
     {
-        JsonArray sample;
+        builder.append(",\"sample\":[");
 
-        for (auto& player : m_data.players.sample)
+        for (size_t i = 0; i < m_data.players.sample.size(); i++)
         {
-            JsonObject sample_player;
-            sample_player.set("name", player.name);
-            sample_player.set("id", player.id);
-            sample.append(sample_player);
+            auto& player = m_data.players.sample[i];
+
+            if (i != 0)
+                builder.append(',');
+            builder.append("{\"name\":");
+            Chat::Component::append_json_string(builder, player.name);
+            builder.append(",\"id\":");
+            Chat::Component::append_json_string(builder, player.id);
+            builder.append('}');
         }
-        players.set("sample", players);
+
+        builder.append(']');
     }
 
-    object.set("version", version);
-    object.set("players", players);
-    object.set("description", m_data.description->to_json());
+    builder.append("},\"description\":");
+    m_data.description->write_json(builder);
 
     if (!m_data.favicon.is_null())
-        object.set("favicon", m_data.favicon);
+    {
+        builder.append(",\"favicon\":");
+        Chat::Component::append_json_string(builder, m_data.favicon);
+    }
 
-    Types::write_string(stream, object.to_string());
+    builder.append('}');
+
+    Types::write_string(stream, builder.string_view());
 
     return stream.copy_into_contiguous_buffer();
 }
-}
\ No newline at end of file
+}
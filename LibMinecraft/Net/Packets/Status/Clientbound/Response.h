@@ -52,6 +52,8 @@ public:
 
     const char* packet_name() const override { return "Status::Clientbound::Response"; }
 
+    i32 id() const override { return static_cast<i32>(Id::Status::Clientbound::Response); }
+
 private:
     Data m_data;
 };
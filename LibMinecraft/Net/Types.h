@@ -8,7 +8,9 @@
 
 #include <AK/Stream.h>
 #include <AK/String.h>
+#include <AK/StringBuilder.h>
 #include <AK/Types.h>
+#include <LibMinecraft/Chat/Component.h>
 
 namespace Minecraft::Net
 {
@@ -101,7 +103,7 @@ public:
         }
     }
 
-    static bool write_string(OutputStream& stream, const String& value)
+    static bool write_string(OutputStream& stream, StringView value)
     {
         if (!write_leb_signed(stream, value.length()))
             return false;
@@ -110,6 +112,22 @@ public:
         return true;
     }
 
+    static bool write_string(OutputStream& stream, const String& value)
+    {
+        return write_string(stream, value.view());
+    }
+
+    // Writes the component's JSON straight into the stream. The builder is reused between calls, so once it has grown
+    // large enough, this doesn't allocate at all.
+    static bool write_chat_component(OutputStream& stream, const Chat::Component& component)
+    {
+        thread_local StringBuilder builder;
+        builder.clear();
+
+        component.write_json(builder);
+        return write_string(stream, builder.string_view());
+    }
+
     static bool read_string(InputStream& stream, String& value)
     {
         LEBResult<i32> length;
@@ -9,6 +9,7 @@
 #include <AK/Format.h>
 #include <AK/String.h>
 #include <AK/StringView.h>
+#include <AK/Traits.h>
 
 namespace Minecraft
 {
@@ -22,6 +23,12 @@ public:
 
     String to_string() const { return String::formatted("{}:{}", m_name_space, m_path); }
 
+    bool operator==(const ResourceLocation& other) const
+    {
+        return m_name_space == other.m_name_space && m_path == other.m_path;
+    }
+    bool operator!=(const ResourceLocation& other) const { return !(*this == other); }
+
     static Optional<ResourceLocation> try_parse_from_string(const StringView&);
 
     struct StandardNamespaces
@@ -37,6 +44,15 @@ private:
 
 namespace AK
 {
+template<>
+struct Traits<Minecraft::ResourceLocation> : public GenericTraits<Minecraft::ResourceLocation>
+{
+    static unsigned hash(const Minecraft::ResourceLocation& value)
+    {
+        return pair_int_hash(value.name_space().hash(), value.path().hash());
+    }
+};
+
 template<>
 struct Formatter<Minecraft::ResourceLocation> : Formatter<StringView>
 {
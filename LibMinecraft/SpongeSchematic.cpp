@@ -5,12 +5,108 @@
  */
 
 #include <AK/MemoryStream.h>
+#include <LibMinecraft/GlobalPalette.h>
+#include <LibMinecraft/NBT/Schema.h>
 #include <LibMinecraft/SpongeSchematic.h>
 
 constexpr i32 sponge_schematic_version = 2;
 
 namespace Minecraft
 {
+// The parts of a schematic we care about. Block entities, entities, biomes and metadata are skipped over for now.
+struct SpongeSchematicFields
+{
+    i32 version{};
+    i32 data_version{};
+    i16 width{};
+    i16 height{};
+    i16 length{};
+    // Not required by the spec, without it BlockData holds global palette IDs
+    Optional<Vector<NBT::Named<i32>>> palette;
+    ReadonlyBytes block_data;
+
+    static constexpr auto nbt_schema()
+    {
+        return NBT::schema(NBT::required("Version", &SpongeSchematicFields::version),
+                           NBT::required("DataVersion", &SpongeSchematicFields::data_version),
+                           NBT::required("Width", &SpongeSchematicFields::width),
+                           NBT::required("Height", &SpongeSchematicFields::height),
+                           NBT::required("Length", &SpongeSchematicFields::length),
+                           NBT::optional("Palette", &SpongeSchematicFields::palette),
+                           NBT::required("BlockData", &SpongeSchematicFields::block_data));
+    }
+};
+
+Result<void, String> SpongeSchematic::add_palette_entry(StringView state, i32 palette_index)
+{
+    auto maybe_palette_block_state = BlockState::parse_block_state(state);
+    if (maybe_palette_block_state.is_error())
+        return maybe_palette_block_state.release_error();
+
+    // Vanilla states are found through the global palette's perfect hash, without touching the registry's maps
+    if (auto* global_palette = GlobalPalette::the())
+    {
+        if (auto maybe_state_id = global_palette->find(maybe_palette_block_state.value()); maybe_state_id.has_value())
+        {
+            m_palette.set(palette_index, *maybe_state_id);
+            return {};
+        }
+    }
+
+    auto maybe_state_id = BlockStateRegistry::the().intern(maybe_palette_block_state.value());
+    if (maybe_state_id.is_error())
+        return maybe_state_id.release_error();
+
+    m_palette.set(palette_index, maybe_state_id.release_value());
+    return {};
+}
+
+Result<void, String> SpongeSchematic::decode_block_data(ReadonlyBytes block_data_bytes, bool uses_global_palette)
+{
+    // FIXME: Is this okay to do? (i8 to u8) Not much of a choice, NBT spec and this spec clash horribly...
+    InputMemoryStream block_data_byte_stream(block_data_bytes);
+    auto* global_palette = GlobalPalette::the();
+
+    // Every block takes at least one byte of BlockData, so a volume larger than that can't be right, and mustn't be
+    // reserved
+    auto volume = static_cast<u64>(m_width) * m_height * m_length;
+    if (volume > block_data_bytes.size())
+        return String("BlockData is too short for the schematic's dimensions");
+
+    m_block_data.ensure_capacity(volume);
+
+    while (!block_data_byte_stream.eof())
+    {
+        if (m_block_data.size() == volume)
+            return String("BlockData has more blocks than the schematic's dimensions");
+
+        i32 palette_index = 0;
+        if (!block_data_byte_stream.read_LEB128_signed(palette_index))
+            return String("Unable to read LEB128 integer from BlockData");
+
+        if (uses_global_palette)
+        {
+            // Once loaded, global palette IDs are the same as registry IDs
+            if (palette_index < 0 || static_cast<size_t>(palette_index) >= global_palette->size())
+                return String("BlockData refers to a global palette ID that doesn't exist");
+
+            m_block_data.append(palette_index);
+            continue;
+        }
+
+        auto maybe_state_id = m_palette.get(palette_index);
+        if (!maybe_state_id.has_value())
+            return String("BlockData refers to a palette index that doesn't exist");
+
+        m_block_data.append(*maybe_state_id);
+    }
+
+    if (m_block_data.size() != volume)
+        return String("BlockData has fewer blocks than the schematic's dimensions");
+
+    return {};
+}
+
 Result<SpongeSchematic, String> SpongeSchematic::parse_schematic(NBT::Value& value)
 {
     auto compound = value.as<NBT::Value::Compound*>();
@@ -29,10 +125,11 @@ Result<SpongeSchematic, String> SpongeSchematic::parse_schematic(NBT::Value& val
         return {"Missing required \"Height\" field"};
     if (!compound->contains("Length"))
         return {"Missing required \"Length\" field"};
-    // FIXME: Palette is not required by the spec. If it is not present, values in BlockData are indexes into
-    //        the Global Palette (which we don't have a model of yet)
-    if (!compound->contains("Palette"))
-        return {"Missing required \"Palette\" field"};
+    // Palette is not required by the spec. If it is not present, values in BlockData are indexes into the global
+    // palette, which is only available when it has been loaded.
+    auto uses_global_palette = !compound->contains("Palette");
+    if (uses_global_palette && !GlobalPalette::the())
+        return {"Schematic has no \"Palette\" field, and the global palette is not loaded"};
     if (!compound->contains("BlockData"))
         return {"Missing required \"BlockData\" field"};
 
@@ -42,29 +139,60 @@ Result<SpongeSchematic, String> SpongeSchematic::parse_schematic(NBT::Value& val
     schematic.m_height = value["Height"].as<BigEndian<i16>>();
     schematic.m_length = value["Length"].as<BigEndian<i16>>();
 
-    for (auto& kv : *value["Palette"].as<NBT::Value::Compound*>())
+    if (!uses_global_palette)
     {
-        auto maybe_palette_block_state = BlockState::parse_block_state(kv.key);
-        if (maybe_palette_block_state.is_error())
-            maybe_palette_block_state.error();
-
-        schematic.m_palette.set(kv.value.as<BigEndian<i32>>(), maybe_palette_block_state.release_value());
+        for (auto& kv : *value["Palette"].as<NBT::Value::Compound*>())
+        {
+            auto added = schematic.add_palette_entry(kv.key, kv.value.as<BigEndian<i32>>());
+            if (added.is_error())
+                return added.release_error();
+        }
     }
 
-    // FIXME: Is this okay to do? (i8 to u8) Not much of a choice, NBT spec and this spec clash horribly...
-    auto block_data = value["BlockData"].as<Vector<i8>>();
+    auto& block_data = value["BlockData"].as<Vector<i8>>();
     auto block_data_bytes = ReadonlyBytes(block_data.data(), block_data.size());
-    InputMemoryStream block_data_byte_stream(block_data_bytes);
+    auto decoded = schematic.decode_block_data(block_data_bytes, uses_global_palette);
+    if (decoded.is_error())
+        return decoded.release_error();
 
-    while (!block_data_byte_stream.eof())
-    {
-        i32 palette_index = 0;
-        if (!block_data_byte_stream.read_LEB128_signed(palette_index))
-            return {"Unable to read LEB128 integer from BlockData"};
+    return schematic;
+}
+
+Result<SpongeSchematic, String> SpongeSchematic::parse_schematic(ReadonlyBytes bytes)
+{
+    auto maybe_fields = NBT::decode_document<SpongeSchematicFields>(bytes);
+    if (maybe_fields.is_error())
+        return maybe_fields.release_error();
+
+    auto& fields = maybe_fields.value();
+
+    if (fields.version != sponge_schematic_version)
+        return {"Unsupported schematic version"};
 
-        schematic.m_block_data.append(palette_index);
+    auto uses_global_palette = !fields.palette.has_value();
+    if (uses_global_palette && !GlobalPalette::the())
+        return {"Schematic has no \"Palette\" field, and the global palette is not loaded"};
+
+    SpongeSchematic schematic;
+    schematic.m_data_version = fields.data_version;
+    schematic.m_width = fields.width;
+    schematic.m_height = fields.height;
+    schematic.m_length = fields.length;
+
+    if (!uses_global_palette)
+    {
+        for (auto& entry : *fields.palette)
+        {
+            auto added = schematic.add_palette_entry(entry.name, entry.value);
+            if (added.is_error())
+                return added.release_error();
+        }
     }
 
+    auto decoded = schematic.decode_block_data(fields.block_data, uses_global_palette);
+    if (decoded.is_error())
+        return decoded.release_error();
+
     return schematic;
 }
-}
\ No newline at end of file
+}
@@ -10,6 +10,7 @@
 #include <AK/String.h>
 #include <AK/Vector.h>
 #include <LibMinecraft/BlockState.h>
+#include <LibMinecraft/BlockStateRegistry.h>
 #include <LibMinecraft/NBT/Value.h>
 
 namespace Minecraft
@@ -19,32 +20,44 @@ class SpongeSchematic
 public:
     static Result<SpongeSchematic, String> parse_schematic(NBT::Value&);
 
+    // Decodes a schematic straight from uncompressed NBT through an NBT::Schema, only looking at the fields we need and
+    // skipping the rest, without building a tree of NBT::Values first.
+    static Result<SpongeSchematic, String> parse_schematic(ReadonlyBytes);
+
     i32 data_version() const { return m_data_version; }
     u16 width() const { return m_width; }
     u16 height() const { return m_height; }
     u16 length() const { return m_length; }
 
-    const HashMap<i32, BlockState>& palette() const { return m_palette; }
+    // Maps the palette indices of this schematic to their ID in the BlockStateRegistry. This is empty when the schematic
+    // uses the global palette.
+    const HashMap<i32, BlockStateRegistry::Id>& palette() const { return m_palette; }
 
-    const Vector<i32>& block_data() const { return m_block_data; }
+    // The BlockStateRegistry ID of every block in this schematic, already resolved through the palette
+    const Vector<BlockStateRegistry::Id>& block_data() const { return m_block_data; }
+
+    BlockStateRegistry::Id state_id_at(u16 x, u16 y, u16 z) const
+    {
+        return m_block_data.at(x + z * m_width + y * m_width * m_length);
+    }
 
     const BlockState& at(u16 x, u16 y, u16 z) const
     {
-        auto state = m_palette.find(m_block_data.at(x + z * m_width + y * m_width * m_length));
-        VERIFY(state != m_palette.end());
-        return state->value;
+        return BlockStateRegistry::the().state_for_id(state_id_at(x, y, z));
     }
 
 private:
     SpongeSchematic() = default;
 
+    Result<void, String> add_palette_entry(StringView state, i32 palette_index);
+    Result<void, String> decode_block_data(ReadonlyBytes, bool uses_global_palette);
+
     i32 m_data_version{};
     u16 m_width{};
     u16 m_height{};
     u16 m_length{};
-    HashMap<i32, BlockState> m_palette;
-    // FIXME: Vectors can hold references, should I use that instead?
-    Vector<i32> m_block_data;
+    HashMap<i32, BlockStateRegistry::Id> m_palette;
+    Vector<BlockStateRegistry::Id> m_block_data;
     // block data
     // block entities
     // entities
@@ -22,6 +22,17 @@ public:
 
     bool is_trivial() const { return m_type != "String" && m_type != "UUID"; }
 
+    bool is_integer() const
+    {
+        for (auto type : {"i8", "u8", "i16", "u16", "i32", "u32", "i64", "u64"})
+        {
+            if (m_type == type)
+                return true;
+        }
+
+        return false;
+    }
+
     String create_getter() const
     {
         if (m_type == "Chat::Component")
@@ -115,11 +126,37 @@ public:
             TODO();
         }
         else if (m_type == "Chat::Component")
-            return String::formatted("Types::write_string(stream, m_{}->to_json().to_string());", m_name);
+            return String::formatted("Types::write_chat_component(stream, *m_{});", m_name);
 
         return String::formatted("stream << m_{};", m_name);
     }
 
+    String create_hasher() const
+    {
+        if (m_type == "Chat::Component")
+            return String::formatted("hasher.add_integer(m_{} ? m_{}->content_hash() : 0);", m_name, m_name);
+        else if (m_type == "String")
+            return String::formatted("hasher.add_string(m_{});", m_name);
+        else if (m_type == "UUID")
+            return String::formatted(
+                "hasher.add_integer(m_{}.most_significant_bits()); hasher.add_integer(m_{}.least_significant_bits());",
+                m_name, m_name);
+
+        else if (m_type == "VarInt" || m_type == "VarLong")
+            return String::formatted("hasher.add_integer(static_cast<u64>(m_{}));", m_name);
+        else if (m_type == "bool")
+            return String::formatted("hasher.add_integer(m_{} ? 1 : 0);", m_name);
+        else if (m_type == "float" || m_type == "double")
+            return String::formatted("hasher.add_floating(static_cast<double>(m_{}));", m_name);
+        else if (is_integer())
+            return String::formatted("hasher.add_integer(static_cast<u64>(static_cast<{}>(m_{})));", m_type, m_name);
+
+        // Hashing the bytes of anything else could take in padding, or pointers, so equal packets wouldn't always hash
+        // the same
+        // TODO: Support hashing other types
+        TODO();
+    }
+
 private:
     String m_name;
     String m_type;
@@ -159,6 +196,9 @@ int main(int argc, char** argv)
         return 5;
     }
 
+    // Packets which only set some state on the client, which can be skipped when the state hasn't changed
+    auto is_idempotent = json_object.get("idempotent").to_bool(false);
+
     Vector<Field> fields;
 
     json_fields.as_array().for_each([&](auto& value) {
@@ -188,6 +228,7 @@ int main(int argc, char** argv)
     outln("#include <LibMinecraft/UUID.h>");
     outln("#include <LibMinecraft/Net/Types.h>");
     outln("#include <LibMinecraft/Chat/Component.h>");
+    outln("#include <LibMinecraft/ContentHasher.h>");
     outln();
     outln("// This was auto-generated from {}", lexical_path_to_input_file);
     outln("namespace Minecraft::Net::Packets::{}", packet_id_namespace);
@@ -205,6 +246,24 @@ int main(int argc, char** argv)
     outln("return \"{}::{}\";", packet_id_namespace, class_name);
     outln("}}");
 
+    outln();
+    outln("i32 id() const override");
+    outln("{{");
+    outln("return static_cast<i32>(Packet::{}::{});", packet_id_enum, class_name);
+    outln("}}");
+
+    if (is_idempotent)
+    {
+        outln();
+        outln("Optional<u64> idempotent_state_hash() const override");
+        outln("{{");
+        outln("ContentHasher hasher;");
+        for (auto& field : fields)
+            outln("{}", field.create_hasher());
+        outln("return hasher.value();");
+        outln("}}");
+    }
+
     outln();
     outln("static Optional<{}> from_bytes(InputStream& stream)", class_name);
     outln("{{");
@@ -13,29 +13,79 @@
 #include <Server/Client.h>
 #include <Server/Server.h>
 
-Client::Client(NonnullRefPtr<Core::TCPSocket> socket, Server& server)
-    : m_socket(socket), m_output_stream(socket), m_input_stream(socket), m_server(server)
+Client::Client(NonnullRefPtr<Core::TCPSocket> socket, Server& server, u32 id)
+    : m_socket(socket), m_output_stream(socket), m_input_stream(socket), m_server(server), m_id(id)
 {
     m_socket->on_ready_to_read = [this]() { on_ready_to_read(); };
 }
 
 void Client::send(const Minecraft::Net::Packet& packet)
 {
-    auto bytes = packet.to_bytes();
+    auto state_hash = packet.idempotent_state_hash();
+    if (state_hash.has_value() && suppress_if_unchanged(packet.id(), *state_hash))
+        return;
+
+    auto frame = Frame::encode(packet);
+    if (state_hash.has_value())
+        remember_sent_state(packet.id(), *state_hash, frame->size());
+
+    send(*frame);
+}
+
+void Client::send(const Frame& frame) { send_encoded(frame.bytes()); }
+
+void Client::send_encoded(ReadonlyBytes bytes)
+{
+    // Once handed off, what we send goes in between what the destination server sends, and follows its compression
+    if (m_forwarder)
+    {
+        m_forwarder->inject_clientbound(bytes, [this](ReadonlyBytes run) { m_output_stream << run; });
+        return;
+    }
 
-    Minecraft::Net::Types::write_leb_signed(m_output_stream, bytes.size());
     m_output_stream << bytes;
 }
 
-void Client::forward_raw_bytes(Badge<DestinationServer>, ByteBuffer& bytes) { m_output_stream << bytes; }
+bool Client::suppress_if_unchanged(i32 packet_id, u64 state_hash)
+{
+    auto sent_state = m_sent_states.get(packet_id);
+    if (!sent_state.has_value() || sent_state->hash != state_hash)
+        return false;
+
+    m_suppressed_packets++;
+    m_suppressed_bytes += sent_state->size;
+    m_server.client_did_suppress_packet({}, *this, sent_state->size);
+    return true;
+}
+
+void Client::remember_sent_state(i32 packet_id, u64 state_hash, size_t size)
+{
+    m_sent_states.set(packet_id, {state_hash, size});
+}
+
+void Client::forward_raw_bytes(Badge<DestinationServer>, ByteBuffer& bytes)
+{
+    m_forwarder->forward(Filters::Direction::Clientbound, bytes, [this](ReadonlyBytes run) { m_output_stream << run; });
+}
+
+void Client::forwarding_did_fail(Badge<Forwarder>)
+{
+    warnln("Client {} sent or received a frame that can't be forwarded, disconnecting it", m_id);
+    m_server.client_did_disconnect({}, *this, DisconnectReason::StreamErrored);
+}
 
 void Client::disconnect(Minecraft::Chat::Component& reason)
+{
+    Minecraft::Net::Packets::Login::Clientbound::Disconnect disconnect_packet;
+    disconnect_packet.set_reason(reason);
+    disconnect(Frame::encode_bytes(disconnect_packet).bytes());
+}
+
+void Client::disconnect(ReadonlyBytes encoded_disconnect)
 {
     if (m_current_state == State::Login)
     {
-        Minecraft::Net::Packets::Login::Clientbound::Disconnect disconnect;
-        disconnect.set_reason(reason);
-        send(disconnect);
+        send_encoded(encoded_disconnect);
     }
     else if (m_current_state == State::Play)
     {
@@ -55,7 +105,9 @@ void Client::on_ready_to_read()
     if (m_current_destination_server)
     {
         auto bytes = m_socket->read_all();
-        m_current_destination_server->forward_raw_bytes({}, bytes);
+        m_forwarder->forward(Filters::Direction::Serverbound, bytes, [this](ReadonlyBytes run) {
+            m_current_destination_server->forward_raw_bytes({}, run);
+        });
         return;
     }
 
@@ -87,6 +139,8 @@ void Client::on_ready_to_read()
     dbgln("Received ID {} during state {} with {} data bytes", packet_id.value, static_cast<i32>(m_current_state),
           packet_bytes.size());
 
+    m_server.client_did_receive_packet({}, *this, packet_id.value, packet_bytes);
+
     switch (m_current_state)
     {
         case State::Handshake:
@@ -139,15 +193,29 @@ void Client::handle_login_packet(Minecraft::Net::Packet::Id::Login::Serverbound
 
     if (id == Minecraft::Net::Packet::Id::Login::Serverbound::LoginStart)
     {
+        // Only the first one counts, while we wait for scripts to answer it
+        if (m_has_requested_login)
+            return;
+        m_has_requested_login = true;
+
         auto login_start = Minecraft::Net::Packets::Login::Serverbound::LoginStart::from_bytes(stream);
 
+        // Scripts get to see the login first, and connect_to_destination_server() is called once they are all done
         m_server.client_did_request_login({}, *this, *login_start);
-
-        m_current_destination_server = adopt_own(*new DestinationServer(
-            DestinationServer::Info({}, 25566, DestinationServer::Info::ConnectionMethod::Unencrypted), *this));
     }
 }
 
+void Client::connect_to_destination_server(Badge<Scripting::Host>)
+{
+    VERIFY(!m_current_destination_server);
+
+    forget_sent_states();
+    m_forwarder = make<Forwarder>(*this, m_server, m_server.filters());
+    m_current_destination_server = adopt_own(*new DestinationServer(DestinationServer::Info::backend(), *this));
+
+    m_server.client_did_connect_to_destination_server({}, *this);
+}
+
 void Client::handle_status_packet(Minecraft::Net::Packet::Id::Status::Serverbound id, ByteBuffer& bytes)
 {
     InputMemoryStream stream(bytes);
@@ -6,15 +6,23 @@
 
 #pragma once
 
+#include <AK/HashMap.h>
 #include <AK/NonnullRefPtr.h>
 #include <LibCore/FileStream.h>
 #include <LibCore/TCPSocket.h>
 #include <LibMinecraft/Chat/Component.h>
 #include <LibMinecraft/Net/Packet.h>
 #include <Server/DestinationServer.h>
+#include <Server/Forwarder.h>
+#include <Server/Frame.h>
 
 class Server;
 
+namespace Scripting
+{
+class Host;
+}
+
 class Client : public Weakable<Client>
 {
 public:
@@ -32,14 +40,52 @@ public:
         Play
     };
 
-    Client(NonnullRefPtr<Core::TCPSocket> socket, Server&);
+    Client(NonnullRefPtr<Core::TCPSocket> socket, Server&, u32 id);
+
+    // How scripts refer to this client, as they run on another thread and can't hold on to it
+    u32 id() const { return m_id; }
 
     void send(const Minecraft::Net::Packet&);
 
+    // Writes a packet that has already been encoded, which may be shared with other clients.
+    void send(const Frame&);
+
+    // Writes bytes that were already encoded and length-prefixed, as one uncompressed frame. Once the client has been
+    // handed off, this goes through the Forwarder, which wraps it for compression and keeps it out of forwarded frames.
+    void send_encoded(ReadonlyBytes);
+
+    State state() const { return m_current_state; }
+
+    // For idempotent packets: if we last sent this client the same state, counts the packet as suppressed and returns
+    // true, so it doesn't have to be encoded or sent at all.
+    bool suppress_if_unchanged(i32 packet_id, u64 state_hash);
+    void remember_sent_state(i32 packet_id, u64 state_hash, size_t size);
+
+    // When the destination server changes, or sends a packet itself, the state we sent before may not be what the
+    // client has anymore.
+    void forget_sent_states() { m_sent_states.clear(); }
+    void forget_sent_state(i32 packet_id) { m_sent_states.remove(packet_id); }
+    bool has_sent_states() const { return !m_sent_states.is_empty(); }
+
+    u64 suppressed_packets() const { return m_suppressed_packets; }
+    u64 suppressed_bytes() const { return m_suppressed_bytes; }
+
+    // Whether we have handed this client off to a destination server, which is when Play packets can be sent to it.
+    bool is_connected_to_destination_server() const { return !m_current_destination_server.is_null(); }
+
+    // Hands the client off to the backend, once every plugin has had its say about the login.
+    void connect_to_destination_server(Badge<Scripting::Host>);
+
     void forward_raw_bytes(Badge<DestinationServer>, ByteBuffer&);
 
+    // The Forwarder came across a frame it can't go on after, so the client is disconnected
+    void forwarding_did_fail(Badge<Forwarder>);
+
     void disconnect(Minecraft::Chat::Component& reason);
 
+    // Same as above, with a Login::Clientbound::Disconnect that has already been encoded.
+    void disconnect(ReadonlyBytes encoded_disconnect);
+
 private:
     void on_ready_to_read();
 
@@ -53,6 +99,19 @@ private:
     Core::OutputFileStream m_output_stream;
     Core::InputFileStream m_input_stream;
     Server& m_server;
+    u32 m_id;
+    // Set once the client has asked to log in, as it is held until scripts are done with the request
+    bool m_has_requested_login{};
 
     OwnPtr<DestinationServer> m_current_destination_server;
+    OwnPtr<Forwarder> m_forwarder;
+
+    struct SentState
+    {
+        u64 hash;
+        size_t size;
+    };
+    HashMap<i32, SentState> m_sent_states;
+    u64 m_suppressed_packets{};
+    u64 m_suppressed_bytes{};
 };
\ No newline at end of file
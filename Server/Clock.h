@@ -0,0 +1,28 @@
+/*
+ * Copyright (c) 2021, James Puleo <james@jame.xyz>
+ *
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#pragma once
+
+#include <AK/Types.h>
+#include <time.h>
+
+namespace Clock
+{
+inline u64 monotonic_nanoseconds()
+{
+    timespec now{};
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return static_cast<u64>(now.tv_sec) * 1'000'000'000 + now.tv_nsec;
+}
+
+// CPU time spent by the calling thread
+inline u64 thread_cpu_nanoseconds()
+{
+    timespec now{};
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return static_cast<u64>(now.tv_sec) * 1'000'000'000 + now.tv_nsec;
+}
+}
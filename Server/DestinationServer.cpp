@@ -27,7 +27,7 @@ void DestinationServer::send(const Minecraft::Net::Packet& packet)
     m_output_stream << bytes;
 }
 
-void DestinationServer::forward_raw_bytes(Badge<Client>, ByteBuffer& bytes) { m_output_stream << bytes; }
+void DestinationServer::forward_raw_bytes(Badge<Client>, ReadonlyBytes bytes) { m_output_stream << bytes; }
 
 void DestinationServer::on_connected()
 {
@@ -31,6 +31,9 @@ public:
         {
         }
 
+        // The server every client is sent to
+        static Info backend() { return Info({}, 25566, ConnectionMethod::Unencrypted); }
+
         const IPv4Address& address() const { return m_address; }
         u16 port() const { return m_port; }
         ConnectionMethod connection_method() const { return m_connection_method; }
@@ -44,7 +47,7 @@ public:
     DestinationServer(Info, Client&);
 
     const Info& info() const { return m_info; }
-    void forward_raw_bytes(Badge<Client>, ByteBuffer&);
+    void forward_raw_bytes(Badge<Client>, ReadonlyBytes);
 
 private:
     Info m_info;
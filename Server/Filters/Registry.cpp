@@ -0,0 +1,206 @@
+/*
+ * Copyright (c) 2021, James Puleo <james@jame.xyz>
+ *
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#include <AK/LexicalPath.h>
+#include <LibCore/DirIterator.h>
+#include <LibCore/File.h>
+#include <Server/Clock.h>
+#include <Server/Filters/Registry.h>
+#include <dlfcn.h>
+
+namespace Filters
+{
+Registry::Registry()
+{
+    m_host.abi_version = TRAVEL_FILTER_ABI_VERSION;
+    m_host.host = this;
+    m_host.register_filter = register_filter_thunk;
+    m_host.rewrite = rewrite_thunk;
+}
+
+Registry::~Registry()
+{
+    m_filters_by_packet = {};
+    m_filters.clear();
+
+    for (auto* handle : m_handles)
+        dlclose(handle);
+}
+
+void Registry::load_plugins()
+{
+    constexpr StringView plugins_directory = "Plugins";
+
+    if (!Core::File::is_directory(plugins_directory))
+        return;
+
+    auto plugins_dir_iterator = Core::DirIterator(plugins_directory, Core::DirIterator::SkipDots);
+    while (plugins_dir_iterator.has_next())
+    {
+        auto entry = plugins_dir_iterator.next_full_path();
+        if (!Core::File::is_directory(entry))
+            continue;
+
+        auto entry_path = LexicalPath(entry);
+        auto filter_path = entry_path.append("filter.so").string();
+        if (!Core::File::exists(filter_path))
+            continue;
+
+        auto result = load_plugin(entry_path.basename().to_string(), filter_path);
+        if (result.is_error())
+        {
+            warnln("\u001b[31mFailed to load filter plugin from path {}\u001b[0m", filter_path);
+            warnln("\u001b[31m{}\u001b[0m", result.error());
+        }
+        else
+        {
+            outln("\u001b[36mLoaded filter plugin {}\u001b[0m", filter_path);
+        }
+    }
+}
+
+Result<void, String> Registry::load_plugin(const String& plugin_name, const String& path)
+{
+    auto* handle = dlopen(path.characters(), RTLD_NOW | RTLD_LOCAL);
+    if (!handle)
+        return String(dlerror());
+
+    auto abi_version_function =
+        reinterpret_cast<TravelFilterAbiVersionFunction>(dlsym(handle, "travel_filter_abi_version"));
+    auto init_function = reinterpret_cast<TravelFilterInitFunction>(dlsym(handle, "travel_filter_init"));
+    if (!abi_version_function || !init_function)
+    {
+        dlclose(handle);
+        return String("The plugin doesn't export travel_filter_abi_version and travel_filter_init");
+    }
+
+    auto abi_version = abi_version_function();
+    if (abi_version != TRAVEL_FILTER_ABI_VERSION)
+    {
+        dlclose(handle);
+        return String::formatted("The plugin was built for filter ABI version {}, but this is version {}", abi_version,
+                                 TRAVEL_FILTER_ABI_VERSION);
+    }
+
+    m_loading_plugin_name = plugin_name;
+    auto rc = init_function(&m_host);
+    m_loading_plugin_name = {};
+
+    if (rc != 0)
+    {
+        m_loading_filters.clear();
+        dlclose(handle);
+        return String::formatted("travel_filter_init failed with {}", rc);
+    }
+
+    for (auto& filter : m_loading_filters)
+    {
+        auto& filters_by_packet = m_filters_by_packet[static_cast<size_t>(filter->direction)];
+        auto filters = filters_by_packet.find(filter->packet_id);
+        if (filters == filters_by_packet.end())
+        {
+            filters_by_packet.set(filter->packet_id, {});
+            filters = filters_by_packet.find(filter->packet_id);
+        }
+        filters->value.append(filter.ptr());
+
+        m_filters.append(move(filter));
+    }
+    m_loading_filters.clear();
+
+    m_handles.append(handle);
+    return {};
+}
+
+int Registry::register_filter_thunk(void* host, const char* name, TravelFilterDirection direction, int32_t packet_id,
+                                    TravelFilterCallback callback, void* user_data)
+{
+    auto& registry = *reinterpret_cast<Registry*>(host);
+
+    // Filters can only be registered while their plugin is being loaded
+    if (registry.m_loading_plugin_name.is_null() || !name || !callback || packet_id < 0 ||
+        (direction != TRAVEL_FILTER_SERVERBOUND && direction != TRAVEL_FILTER_CLIENTBOUND))
+        return -1;
+
+    registry.m_loading_filters.append(adopt_own(*new Filter{
+        name, registry.m_loading_plugin_name, static_cast<Direction>(direction), packet_id, callback, user_data}));
+    return 0;
+}
+
+void Registry::rewrite_thunk(TravelFilterRewrite* rewrite, int32_t packet_id, const uint8_t* data, size_t size)
+{
+    rewrite->packet_id = packet_id;
+    rewrite->data.clear();
+    rewrite->data.append(data, size);
+    rewrite->is_set = true;
+}
+
+Registry::Outcome Registry::filter(Direction direction, u32 client_id, i32 packet_id, ReadonlyBytes data)
+{
+    auto& filters_by_packet = m_filters_by_packet[static_cast<size_t>(direction)];
+    auto filters = filters_by_packet.find(packet_id);
+    if (filters == filters_by_packet.end())
+        return {Verdict::Pass, packet_id, data};
+
+    TravelFilterPacket packet{client_id, static_cast<TravelFilterDirection>(direction), packet_id, data.data(),
+                              data.size()};
+    auto verdict = Verdict::Pass;
+    size_t next_rewrite = 0;
+
+    for (auto* filter : filters->value)
+    {
+        auto& rewrite = m_rewrites[next_rewrite];
+        rewrite.is_set = false;
+
+        auto started_at = Clock::monotonic_nanoseconds();
+        auto filter_verdict = filter->callback(filter->user_data, &packet, &rewrite);
+        auto nanoseconds = Clock::monotonic_nanoseconds() - started_at;
+
+        filter->calls++;
+        filter->total_nanoseconds += nanoseconds;
+        filter->max_nanoseconds = max(filter->max_nanoseconds, nanoseconds);
+
+        if (filter_verdict == TRAVEL_FILTER_DROP)
+        {
+            filter->dropped++;
+            return {Verdict::Drop, packet_id, {}};
+        }
+
+        // Rewriting without handing us anything to rewrite with is the same as passing
+        if (filter_verdict != TRAVEL_FILTER_REWRITE || !rewrite.is_set)
+        {
+            filter->passed++;
+            continue;
+        }
+
+        filter->rewritten++;
+        verdict = Verdict::Rewrite;
+        packet.packet_id = rewrite.packet_id;
+        packet.data = rewrite.data.data();
+        packet.size = rewrite.data.size();
+        next_rewrite ^= 1;
+    }
+
+    return {verdict, packet.packet_id, {packet.data, packet.size}};
+}
+
+void Registry::print_report() const
+{
+    if (m_filters.is_empty())
+        return;
+
+    outln("\u001b[36mNative packet filters\u001b[0m");
+    for (auto& filter : m_filters)
+    {
+        outln("{:>24} {:>11} {:#04x} {:>10} calls {:>10} passed {:>8} dropped {:>8} rewritten {:>10.3f}ms total "
+              "{:>8.3f}us max",
+              String::formatted("{}/{}", filter->plugin_name, filter->name),
+              filter->direction == Direction::Serverbound ? "serverbound" : "clientbound", filter->packet_id,
+              filter->calls, filter->passed, filter->dropped, filter->rewritten,
+              filter->total_nanoseconds / 1'000'000.0, filter->max_nanoseconds / 1'000.0);
+    }
+}
+}
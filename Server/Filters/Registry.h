@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2021, James Puleo <james@jame.xyz>
+ *
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#pragma once
+
+#include <AK/Array.h>
+#include <AK/ByteBuffer.h>
+#include <AK/HashMap.h>
+#include <AK/NonnullOwnPtr.h>
+#include <AK/Noncopyable.h>
+#include <AK/Result.h>
+#include <AK/String.h>
+#include <AK/Vector.h>
+#include <Server/Filters/TravelFilter.h>
+
+// The definition of the handle filters rewrite packets through
+struct TravelFilterRewrite
+{
+    i32 packet_id{};
+    ByteBuffer data;
+    bool is_set{};
+};
+
+namespace Filters
+{
+enum class Direction
+{
+    Serverbound = TRAVEL_FILTER_SERVERBOUND,
+    Clientbound = TRAVEL_FILTER_CLIENTBOUND
+};
+
+// The native filter plugins, and the filters they registered, by the packets they filter. Everything in here belongs to
+// the I/O thread.
+class Registry
+{
+    AK_MAKE_NONCOPYABLE(Registry);
+    AK_MAKE_NONMOVABLE(Registry);
+
+public:
+    Registry();
+
+    ~Registry();
+
+    // Loads every Plugins/*/filter.so. Plugins that fail to load are skipped.
+    void load_plugins();
+
+    bool has_filters(Direction direction) const
+    {
+        return !m_filters_by_packet[static_cast<size_t>(direction)].is_empty();
+    }
+
+    enum class Verdict
+    {
+        Pass,
+        Drop,
+        Rewrite
+    };
+
+    struct Outcome
+    {
+        Verdict verdict;
+        // The packet to forward instead, when rewritten. Only valid until the next packet is filtered.
+        i32 packet_id;
+        ReadonlyBytes data;
+    };
+
+    // Runs every filter for the packet, in the order they were registered
+    Outcome filter(Direction, u32 client_id, i32 packet_id, ReadonlyBytes data);
+
+    void print_report() const;
+
+private:
+    struct Filter
+    {
+        String name;
+        String plugin_name;
+        Direction direction;
+        i32 packet_id;
+        TravelFilterCallback callback;
+        void* user_data;
+
+        u64 calls{};
+        u64 passed{};
+        u64 dropped{};
+        u64 rewritten{};
+        u64 total_nanoseconds{};
+        u64 max_nanoseconds{};
+    };
+
+    Result<void, String> load_plugin(const String& plugin_name, const String& path);
+
+    static int register_filter_thunk(void* host, const char* name, TravelFilterDirection, int32_t packet_id,
+                                     TravelFilterCallback, void* user_data);
+    static void rewrite_thunk(TravelFilterRewrite*, int32_t packet_id, const uint8_t* data, size_t size);
+
+    TravelFilterHost m_host;
+
+    Vector<void*> m_handles;
+    // In the order they were registered, which is the order they are reported in
+    Vector<NonnullOwnPtr<Filter>> m_filters;
+    Array<HashMap<i32, Vector<Filter*>>, 2> m_filters_by_packet;
+
+    // Filters registered by the plugin being loaded, which are only kept if it loads
+    String m_loading_plugin_name;
+    Vector<NonnullOwnPtr<Filter>> m_loading_filters;
+
+    // Filters may each rewrite what the one before them rewrote, so the packet they see can't be in the buffer they
+    // write to
+    Array<TravelFilterRewrite, 2> m_rewrites;
+};
+}
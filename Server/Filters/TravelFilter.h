@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2021, James Puleo <james@jame.xyz>
+ *
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#pragma once
+
+// The C ABI for native packet filters. A filter plugin is a shared library at Plugins/<name>/filter.so, which exports:
+//
+//     uint32_t travel_filter_abi_version(void);
+//         Returns TRAVEL_FILTER_ABI_VERSION, as it was when the plugin was built. Plugins built for another version are
+//         not loaded.
+//
+//     int travel_filter_init(const TravelFilterHost* host);
+//         Registers the plugin's filters through the host, and returns 0, or anything else to fail loading.
+//
+// Filters run on the I/O thread, in the middle of forwarding Play packets, so they have to be quick, and must never
+// block. Nothing in here is thread safe. Everything the host hands a filter is only valid for the duration of the call.
+//
+// The version is bumped whenever anything in here changes in a way that breaks plugins built before.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define TRAVEL_FILTER_ABI_VERSION 1
+
+typedef enum
+{
+    // From the client to the server it is connected to
+    TRAVEL_FILTER_SERVERBOUND = 0,
+    // From the server to the client
+    TRAVEL_FILTER_CLIENTBOUND = 1
+} TravelFilterDirection;
+
+typedef enum
+{
+    // Forward the packet as it is
+    TRAVEL_FILTER_PASS = 0,
+    // Don't forward the packet, and don't run any filters after this one for it
+    TRAVEL_FILTER_DROP = 1,
+    // Forward what the filter handed to travel_filter_host.rewrite() instead. Filters after this one see the rewritten
+    // packet.
+    TRAVEL_FILTER_REWRITE = 2
+} TravelFilterVerdict;
+
+// A packet, as it was read from the connection. The data is the packet's fields, after its ID, and points straight
+// into the bytes that were read, or into the decompressed packet.
+typedef struct
+{
+    uint32_t client_id;
+    TravelFilterDirection direction;
+    int32_t packet_id;
+    const uint8_t* data;
+    size_t size;
+} TravelFilterPacket;
+
+typedef struct TravelFilterRewrite TravelFilterRewrite;
+
+typedef TravelFilterVerdict (*TravelFilterCallback)(void* user_data, const TravelFilterPacket* packet,
+                                                    TravelFilterRewrite* rewrite);
+
+typedef struct
+{
+    // The version of the host, which is the same as the plugin's
+    uint32_t abi_version;
+    // Opaque, to be passed back to the functions below
+    void* host;
+
+    // Has the callback run for every Play packet with the ID that goes in the direction. Filters for the same packet
+    // run in the order they were registered. The name is copied, and shows up in the host's timing report. Returns 0,
+    // or -1 if the arguments are invalid.
+    int (*register_filter)(void* host, const char* name, TravelFilterDirection direction, int32_t packet_id,
+                           TravelFilterCallback callback, void* user_data);
+
+    // Sets what is forwarded instead of the packet, if the filter returns TRAVEL_FILTER_REWRITE. The data is copied.
+    void (*rewrite)(TravelFilterRewrite* rewrite, int32_t packet_id, const uint8_t* data, size_t size);
+} TravelFilterHost;
+
+typedef uint32_t (*TravelFilterAbiVersionFunction)(void);
+typedef int (*TravelFilterInitFunction)(const TravelFilterHost* host);
+
+#ifdef __cplusplus
+}
+#endif
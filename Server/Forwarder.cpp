@@ -0,0 +1,429 @@
+/*
+ * Copyright (c) 2021, James Puleo <james@jame.xyz>
+ *
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#include <AK/MemoryStream.h>
+#include <LibCompress/Deflate.h>
+#include <Server/Client.h>
+#include <Server/Forwarder.h>
+#include <Server/Server.h>
+
+// The most a packet can be, which is also the most its length prefix can hold in three bytes
+static constexpr u32 max_frame_length = 2097151;
+
+// The most a compressed packet may say it inflates to, past which the client and server give up on it as well
+static constexpr u32 max_data_length = 8388608;
+
+// Login packet IDs, as sent by the server
+static constexpr i32 login_success_id = 0x02;
+static constexpr i32 set_compression_id = 0x03;
+
+enum class VarIntResult
+{
+    Complete,
+    Incomplete,
+    Invalid
+};
+
+static VarIntResult read_var_int(ReadonlyBytes bytes, size_t& offset, u32& value)
+{
+    value = 0;
+    for (size_t i = 0; i < 5; i++)
+    {
+        if (offset + i >= bytes.size())
+            return VarIntResult::Incomplete;
+
+        auto byte = bytes[offset + i];
+        value |= static_cast<u32>(byte & 0x7F) << (i * 7);
+        if ((byte & 0x80) == 0)
+        {
+            offset += i + 1;
+            return VarIntResult::Complete;
+        }
+    }
+
+    return VarIntResult::Invalid;
+}
+
+static void append_var_int(ByteBuffer& buffer, u32 value)
+{
+    while (value >= 0x80)
+    {
+        u8 byte = (value & 0x7F) | 0x80;
+        buffer.append(&byte, 1);
+        value >>= 7;
+    }
+
+    u8 byte = value;
+    buffer.append(&byte, 1);
+}
+
+static size_t var_int_size(u32 value)
+{
+    size_t size = 1;
+    while (value >= 0x80)
+    {
+        value >>= 7;
+        size++;
+    }
+    return size;
+}
+
+// The deflate data of a zlib stream, after its two byte header, if the header is one we can inflate
+static Optional<ReadonlyBytes> zlib_deflate_data(ReadonlyBytes zlib_data)
+{
+    if (zlib_data.size() < 2)
+        return {};
+
+    // Deflate, with a valid check, and without a preset dictionary
+    auto compression_method = zlib_data[0];
+    auto flags = zlib_data[1];
+    if ((compression_method & 0x0F) != 8 || ((compression_method << 8) | flags) % 31 != 0 || (flags & 0x20) != 0)
+        return {};
+
+    return zlib_data.slice(2);
+}
+
+// Inflates only as much of a zlib stream as fits in the output, without looking at the rest of it
+static bool inflate_prefix(ReadonlyBytes zlib_data, Bytes output)
+{
+    auto deflate_data = zlib_deflate_data(zlib_data);
+    if (!deflate_data.has_value())
+        return false;
+
+    InputMemoryStream stream(*deflate_data);
+    Compress::DeflateDecompressor decompressor(stream);
+    auto did_inflate = decompressor.read_or_error(output);
+    decompressor.handle_any_error();
+    stream.handle_any_error();
+    return did_inflate;
+}
+
+enum class InflateResult
+{
+    Inflated,
+    Invalid,
+    TooLong
+};
+
+// Inflates a zlib stream into output, which has to be exactly as long as the stream turns out to be. Nothing past that
+// is inflated, however much the stream would go on for.
+static InflateResult inflate_exactly(ReadonlyBytes zlib_data, Bytes output)
+{
+    auto deflate_data = zlib_deflate_data(zlib_data);
+    if (!deflate_data.has_value())
+        return InflateResult::Invalid;
+
+    InputMemoryStream stream(*deflate_data);
+    Compress::DeflateDecompressor decompressor(stream);
+    auto result = InflateResult::Invalid;
+    if (decompressor.read_or_error(output))
+    {
+        // One more byte is enough to tell that it goes on
+        u8 extra_byte;
+        result = decompressor.read({&extra_byte, 1}) == 0 ? InflateResult::Inflated : InflateResult::TooLong;
+    }
+    decompressor.handle_any_error();
+    stream.handle_any_error();
+    return result;
+}
+
+Forwarder::Forwarder(Client& client, Server& server, Filters::Registry& filters)
+    : m_client(client), m_server(server), m_filters(filters)
+{
+}
+
+void Forwarder::forward(Filters::Direction direction, ReadonlyBytes input, const Function<void(ReadonlyBytes)>& write)
+{
+    if (m_has_failed)
+        return;
+
+    auto& stream = m_streams[static_cast<size_t>(direction)];
+    if (stream.is_passthrough)
+    {
+        write(input);
+        return;
+    }
+
+    if (stream.skip_remaining > 0)
+    {
+        auto skipped = min(stream.skip_remaining, input.size());
+        write(input.slice(0, skipped));
+        stream.skip_remaining -= skipped;
+        input = input.slice(skipped);
+
+        if (stream.skip_remaining == 0 && !m_injected_frames.is_empty())
+        {
+            write(m_injected_frames.bytes());
+            m_injected_frames.clear();
+        }
+
+        if (input.is_empty())
+            return;
+    }
+
+    // We only copy when a frame was split over two reads, and only look at it again once the rest of it is here
+    auto bytes = input;
+    if (!stream.pending.is_empty())
+    {
+        stream.pending.append(input.data(), input.size());
+        if (stream.pending.size() < stream.bytes_needed)
+            return;
+
+        bytes = stream.pending.span();
+    }
+
+    size_t offset = 0;
+    size_t run_start = 0;
+    stream.bytes_needed = 0;
+    while (offset < bytes.size())
+    {
+        auto frame_start = offset;
+        u32 frame_length;
+        auto result = read_var_int(bytes, offset, frame_length);
+
+        if (result == VarIntResult::Complete && (frame_length == 0 || frame_length > max_frame_length))
+            result = VarIntResult::Invalid;
+
+        if (result == VarIntResult::Invalid)
+        {
+            warnln("Client {} sent or received a malformed frame, forwarding the rest of its stream as is",
+                   m_client.id());
+            stream.is_passthrough = true;
+            write(bytes.slice(run_start));
+            stream.pending.clear();
+            if (direction == Filters::Direction::Clientbound)
+                m_injected_frames.clear();
+            return;
+        }
+
+        if (result == VarIntResult::Incomplete)
+        {
+            offset = frame_start;
+            break;
+        }
+
+        if (offset + frame_length > bytes.size())
+        {
+            if (wants_frames(direction))
+            {
+                stream.bytes_needed = offset - frame_start + frame_length;
+                offset = frame_start;
+                break;
+            }
+
+            // Nobody is going to look at it, so it is written on without waiting for the rest
+            stream.skip_remaining = offset + frame_length - bytes.size();
+            offset = bytes.size();
+            break;
+        }
+
+        auto verdict = handle_frame(direction, bytes.slice(offset, frame_length));
+        offset += frame_length;
+
+        if (verdict == FrameVerdict::Fail)
+        {
+            m_has_failed = true;
+            for (auto& each_stream : m_streams)
+                each_stream.pending.clear();
+            m_injected_frames.clear();
+            m_client.forwarding_did_fail({});
+            return;
+        }
+
+        if (verdict == FrameVerdict::Pass)
+            continue;
+
+        if (frame_start > run_start)
+            write(bytes.slice(run_start, frame_start - run_start));
+        if (verdict == FrameVerdict::Rewrite)
+            write(m_rewritten_frame.bytes());
+        run_start = offset;
+    }
+
+    if (offset > run_start)
+        write(bytes.slice(run_start, offset - run_start));
+
+    // Keep the partial frame around until the rest of it arrives. What is left is never more than one frame, so no byte
+    // is moved more than once.
+    if (stream.pending.is_empty())
+        stream.pending.append(bytes.data() + offset, bytes.size() - offset);
+    else if (offset == bytes.size())
+        stream.pending.clear();
+    else if (offset > 0)
+        stream.pending.remove(0, offset);
+}
+
+void Forwarder::inject_clientbound(ReadonlyBytes frame, const Function<void(ReadonlyBytes)>& write)
+{
+    // Without frame boundaries to go by, anything we send could land in the middle of one
+    auto& stream = m_streams[static_cast<size_t>(Filters::Direction::Clientbound)];
+    if (m_has_failed || stream.is_passthrough)
+        return;
+
+    auto emit = [&](ReadonlyBytes bytes) {
+        if (stream.skip_remaining > 0)
+            m_injected_frames.append(bytes.data(), bytes.size());
+        else
+            write(bytes);
+    };
+
+    if (!m_compression_threshold.has_value())
+    {
+        emit(frame);
+        return;
+    }
+
+    size_t offset = 0;
+    u32 length;
+    auto result = read_var_int(frame, offset, length);
+    VERIFY(result == VarIntResult::Complete && offset + length == frame.size());
+
+    // Sent uncompressed, which the protocol allows for packets of any size, as encode_rewritten_frame does
+    ByteBuffer prefix;
+    append_var_int(prefix, length + var_int_size(0));
+    append_var_int(prefix, 0);
+    emit(prefix.bytes());
+    emit(frame.slice(offset));
+}
+
+bool Forwarder::wants_packets(Filters::Direction direction) const
+{
+    if (m_filters.has_filters(direction))
+        return true;
+
+    // Scripts waiting for packets, and the dedupe cache, which has to forget what the server changed behind its back
+    if (direction == Filters::Direction::Serverbound)
+        return m_server.is_watching_packets(m_client);
+    return m_client.has_sent_states();
+}
+
+bool Forwarder::wants_frames(Filters::Direction direction) const
+{
+    if (m_state == State::Login)
+        return direction == Filters::Direction::Clientbound;
+    return wants_packets(direction);
+}
+
+Forwarder::FrameVerdict Forwarder::handle_frame(Filters::Direction direction, ReadonlyBytes frame)
+{
+    if (!wants_frames(direction))
+        return FrameVerdict::Pass;
+
+    // Anything we can't decode is still the peer's business, so it is passed on
+    auto packet = frame;
+    ByteBuffer decompressed;
+    if (m_compression_threshold.has_value())
+    {
+        size_t offset = 0;
+        u32 data_length;
+        if (read_var_int(frame, offset, data_length) != VarIntResult::Complete)
+            return FrameVerdict::Pass;
+        if (data_length > max_data_length)
+            return FrameVerdict::Fail;
+
+        packet = frame.slice(offset);
+
+        // Without filters, Play packets from the server only matter to the dedupe cache, which just needs their ID.
+        // Inflating all of every chunk to read it would cost us for every byte forwarded.
+        if (data_length != 0 && m_state == State::Play && direction == Filters::Direction::Clientbound &&
+            !m_filters.has_filters(direction))
+        {
+            u8 id_bytes[5];
+            size_t id_offset = 0;
+            u32 packet_id;
+            ReadonlyBytes inflated_id_bytes(id_bytes, min<size_t>(sizeof(id_bytes), data_length));
+            if (inflate_prefix(packet, {id_bytes, inflated_id_bytes.size()}) &&
+                read_var_int(inflated_id_bytes, id_offset, packet_id) == VarIntResult::Complete)
+                m_client.forget_sent_state(static_cast<i32>(packet_id));
+            return FrameVerdict::Pass;
+        }
+
+        if (data_length != 0)
+        {
+            // A few bytes of deflate can inflate to gigabytes, so we never inflate more than the packet said it would
+            // be. Going past that is something the peer would drop the connection over, so we do too.
+            decompressed = ByteBuffer::create_uninitialized(data_length);
+            auto result = inflate_exactly(packet, decompressed.bytes());
+            if (result == InflateResult::TooLong)
+                return FrameVerdict::Fail;
+            if (result == InflateResult::Invalid)
+                return FrameVerdict::Pass;
+
+            packet = decompressed.bytes();
+        }
+    }
+
+    size_t offset = 0;
+    u32 packet_id;
+    if (read_var_int(packet, offset, packet_id) != VarIntResult::Complete)
+        return FrameVerdict::Pass;
+
+    auto data = packet.slice(offset);
+
+    if (m_state == State::Login)
+    {
+        handle_login_packet(direction, static_cast<i32>(packet_id), data);
+        return FrameVerdict::Pass;
+    }
+
+    if (direction == Filters::Direction::Serverbound)
+        m_server.client_did_forward_packet({}, m_client, static_cast<i32>(packet_id), data);
+    else
+        m_client.forget_sent_state(static_cast<i32>(packet_id));
+
+    auto outcome = m_filters.filter(direction, m_client.id(), static_cast<i32>(packet_id), data);
+    switch (outcome.verdict)
+    {
+        case Filters::Registry::Verdict::Pass:
+            return FrameVerdict::Pass;
+        case Filters::Registry::Verdict::Drop:
+            return FrameVerdict::Drop;
+        case Filters::Registry::Verdict::Rewrite:
+            encode_rewritten_frame(outcome.packet_id, outcome.data);
+            return FrameVerdict::Rewrite;
+    }
+
+    VERIFY_NOT_REACHED();
+}
+
+void Forwarder::handle_login_packet(Filters::Direction direction, i32 packet_id, ReadonlyBytes data)
+{
+    VERIFY(direction == Filters::Direction::Clientbound);
+
+    if (packet_id == set_compression_id)
+    {
+        size_t offset = 0;
+        u32 threshold;
+        if (read_var_int(data, offset, threshold) != VarIntResult::Complete)
+            return;
+
+        // A negative threshold turns compression off
+        if (static_cast<i32>(threshold) < 0)
+            m_compression_threshold = {};
+        else
+            m_compression_threshold = threshold;
+    }
+    else if (packet_id == login_success_id)
+    {
+        m_state = State::Play;
+    }
+}
+
+void Forwarder::encode_rewritten_frame(i32 packet_id, ReadonlyBytes data)
+{
+    // With compression on, this is sent uncompressed, which the protocol allows for packets of any size. Compressing it
+    // again would cost far more than the bytes it saves.
+    auto length = var_int_size(packet_id) + data.size();
+    if (m_compression_threshold.has_value())
+        length += var_int_size(0);
+
+    m_rewritten_frame.clear();
+    append_var_int(m_rewritten_frame, length);
+    if (m_compression_threshold.has_value())
+        append_var_int(m_rewritten_frame, 0);
+    append_var_int(m_rewritten_frame, packet_id);
+    m_rewritten_frame.append(data.data(), data.size());
+}
@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2021, James Puleo <james@jame.xyz>
+ *
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#pragma once
+
+#include <AK/Array.h>
+#include <AK/ByteBuffer.h>
+#include <AK/Function.h>
+#include <AK/Noncopyable.h>
+#include <AK/Optional.h>
+#include <AK/Vector.h>
+#include <Server/Filters/Registry.h>
+
+class Client;
+class Server;
+
+// Forwards what a client and its destination server send each other once the client has been handed off. The bytes are
+// split back into packets, so that native filters and scripts can look at Play packets. Packets are only decompressed
+// when something wants to look at them, and runs of packets that pass are written on in one go, straight out of the
+// buffer they were read into. Frames nobody wants to look at are written on as they arrive, even if only part of one
+// has.
+//
+// Login packets from the server are always looked at, to follow it turning on compression, and switching to Play.
+class Forwarder
+{
+    AK_MAKE_NONCOPYABLE(Forwarder);
+    AK_MAKE_NONMOVABLE(Forwarder);
+
+public:
+    Forwarder(Client&, Server&, Filters::Registry&);
+
+    // Takes whatever was read from one side, and calls write with what to send to the other
+    void forward(Filters::Direction, ReadonlyBytes, const Function<void(ReadonlyBytes)>& write);
+
+    // Sends a frame of our own to the client, encoded as if compression were off. It is wrapped for compression if the
+    // server turned it on, and held back while part of a forwarded frame is still to come, so that it lands between
+    // two frames.
+    void inject_clientbound(ReadonlyBytes frame, const Function<void(ReadonlyBytes)>& write);
+
+private:
+    enum class State
+    {
+        Login,
+        Play
+    };
+
+    enum class FrameVerdict
+    {
+        Pass,
+        Drop,
+        // The frame to send instead is in m_rewritten_frame
+        Rewrite,
+        // The frame is one the connection can't go on after, such as one that inflates past the size it gave
+        Fail
+    };
+
+    // One direction of the connection
+    struct Stream
+    {
+        // The start of a frame that hasn't been read completely yet. Later reads are appended to it, and it isn't
+        // looked at again until all of it is here.
+        Vector<u8> pending;
+        // How much of the stream pending has to hold before its first frame is complete, or 0 if its length prefix
+        // hasn't been read completely yet
+        size_t bytes_needed{};
+        // What is left of a frame nobody wanted to look at, which is written on as it arrives instead of being buffered
+        size_t skip_remaining{};
+        // Set once we've failed to make sense of the stream, after which everything is forwarded as is
+        bool is_passthrough{};
+    };
+
+    bool wants_packets(Filters::Direction) const;
+    // Whether frames going this way are buffered until they are complete, so that handle_frame can look at them
+    bool wants_frames(Filters::Direction) const;
+
+    // Takes the frame without its length prefix
+    FrameVerdict handle_frame(Filters::Direction, ReadonlyBytes frame);
+    void handle_login_packet(Filters::Direction, i32 packet_id, ReadonlyBytes data);
+
+    void encode_rewritten_frame(i32 packet_id, ReadonlyBytes data);
+
+    Client& m_client;
+    Server& m_server;
+    Filters::Registry& m_filters;
+
+    State m_state{State::Login};
+    // Set once the server turns compression on, which both directions use from then on
+    Optional<u32> m_compression_threshold;
+
+    Array<Stream, 2> m_streams;
+
+    // Reused for every rewrite, so that we don't allocate once it has grown large enough
+    ByteBuffer m_rewritten_frame;
+
+    // Frames of our own that came in the middle of a forwarded frame, which are sent once it is over
+    ByteBuffer m_injected_frames;
+
+    // Set once a frame failed the connection, after which nothing more is forwarded either way
+    bool m_has_failed{};
+};
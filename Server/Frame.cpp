@@ -0,0 +1,30 @@
+/*
+ * Copyright (c) 2021, James Puleo <james@jame.xyz>
+ *
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#include <AK/MemoryStream.h>
+#include <LibMinecraft/Net/Types.h>
+#include <Server/Frame.h>
+
+NonnullRefPtr<Frame> Frame::encode(const Minecraft::Net::Packet& packet)
+{
+    return adopt_ref(*new Frame(encode_bytes(packet)));
+}
+
+ByteBuffer Frame::encode_bytes(const Minecraft::Net::Packet& packet)
+{
+    auto payload = packet.to_bytes();
+
+    // A VarInt is never longer than 5 bytes
+    u8 length_prefix[5];
+    OutputMemoryStream length_prefix_stream({length_prefix, sizeof(length_prefix)});
+    Minecraft::Net::Types::write_leb_signed(length_prefix_stream, payload.size());
+
+    auto bytes = ByteBuffer::create_uninitialized(length_prefix_stream.size() + payload.size());
+    __builtin_memcpy(bytes.data(), length_prefix, length_prefix_stream.size());
+    __builtin_memcpy(bytes.data() + length_prefix_stream.size(), payload.data(), payload.size());
+
+    return bytes;
+}
@@ -0,0 +1,30 @@
+/*
+ * Copyright (c) 2021, James Puleo <james@jame.xyz>
+ *
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#pragma once
+
+#include <AK/ByteBuffer.h>
+#include <AK/NonnullRefPtr.h>
+#include <AK/RefCounted.h>
+#include <LibMinecraft/Net/Packet.h>
+
+// A packet that has already been encoded, along with its length prefix, ready to be written to any number of clients.
+class Frame : public RefCounted<Frame>
+{
+public:
+    static NonnullRefPtr<Frame> encode(const Minecraft::Net::Packet&);
+
+    // The same bytes, for when they are to be handed to another thread rather than shared.
+    static ByteBuffer encode_bytes(const Minecraft::Net::Packet&);
+
+    ReadonlyBytes bytes() const { return m_bytes; }
+    size_t size() const { return m_bytes.size(); }
+
+private:
+    explicit Frame(ByteBuffer bytes) : m_bytes(move(bytes)) {}
+
+    ByteBuffer m_bytes;
+};
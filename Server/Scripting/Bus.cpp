@@ -0,0 +1,184 @@
+/*
+ * Copyright (c) 2021, James Puleo <james@jame.xyz>
+ *
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#include <AK/MemoryStream.h>
+#include <Server/Scripting/Bus.h>
+#include <Server/Scripting/Lua.h>
+#include <Server/Scripting/Thread.h>
+
+namespace Scripting
+{
+enum class Tag : u8
+{
+    Nil,
+    False,
+    True,
+    Integer,
+    Number,
+    String,
+    Table
+};
+
+static constexpr size_t max_depth = 32;
+
+void Bus::publish(StringView channel, ReadonlyBytes message, u32 sender_index, StringView sender_name) const
+{
+    for (auto* thread : m_threads)
+    {
+        // Each thread gets its own copies, as String's reference count isn't atomic
+        Event event;
+        event.type = Event::Type::BusMessage;
+        event.channel = String(channel);
+        event.sender_index = sender_index;
+        event.sender_name = String(sender_name);
+        event.message = ByteBuffer::copy(message);
+        thread->post_event(move(event));
+    }
+}
+
+static Result<void, String> serialize_value(lua_State* state, int index, OutputStream& stream, size_t depth)
+{
+    switch (lua_type(state, index))
+    {
+        case LUA_TNIL:
+            stream << static_cast<u8>(Tag::Nil);
+            return {};
+        case LUA_TBOOLEAN:
+            stream << static_cast<u8>(lua_toboolean(state, index) ? Tag::True : Tag::False);
+            return {};
+        case LUA_TNUMBER:
+            if (lua_isinteger(state, index))
+            {
+                stream << static_cast<u8>(Tag::Integer) << static_cast<i64>(lua_tointeger(state, index));
+            }
+            else
+            {
+                stream << static_cast<u8>(Tag::Number) << static_cast<double>(lua_tonumber(state, index));
+            }
+            return {};
+        case LUA_TSTRING:
+        {
+            size_t length;
+            auto* characters = lua_tolstring(state, index, &length);
+            stream << static_cast<u8>(Tag::String) << static_cast<u32>(length);
+            stream << ReadonlyBytes{reinterpret_cast<const u8*>(characters), length};
+            return {};
+        }
+        case LUA_TTABLE:
+        {
+            if (depth == max_depth)
+                return String("tables in messages can't be nested this deeply");
+
+            // The key and value, and lua_next()'s own key, for every level we go down
+            if (!lua_checkstack(state, 3))
+                return String("not enough stack space to copy the message");
+
+            index = lua_absindex(state, index);
+
+            u32 pair_count = 0;
+            lua_pushnil(state);
+            while (lua_next(state, index) != 0)
+            {
+                pair_count++;
+                lua_pop(state, 1);
+            }
+
+            stream << static_cast<u8>(Tag::Table) << pair_count;
+
+            lua_pushnil(state);
+            while (lua_next(state, index) != 0)
+            {
+                auto result = serialize_value(state, -2, stream, depth + 1);
+                if (!result.is_error())
+                    result = serialize_value(state, -1, stream, depth + 1);
+
+                if (result.is_error())
+                {
+                    lua_pop(state, 2);
+                    return result.release_error();
+                }
+
+                lua_pop(state, 1);
+            }
+            return {};
+        }
+        default:
+            return String::formatted("{} values can't be sent in messages", luaL_typename(state, index));
+    }
+}
+
+Result<ByteBuffer, String> Bus::serialize(lua_State* state, int index)
+{
+    DuplexMemoryStream stream;
+    auto result = serialize_value(state, index, stream, 0);
+    if (result.is_error())
+        return result.release_error();
+
+    return stream.copy_into_contiguous_buffer();
+}
+
+static void push_value(lua_State* state, InputMemoryStream& stream)
+{
+    u8 tag;
+    stream >> tag;
+
+    switch (static_cast<Tag>(tag))
+    {
+        case Tag::Nil:
+            lua_pushnil(state);
+            break;
+        case Tag::False:
+            lua_pushboolean(state, false);
+            break;
+        case Tag::True:
+            lua_pushboolean(state, true);
+            break;
+        case Tag::Integer:
+        {
+            i64 value;
+            stream >> value;
+            lua_pushinteger(state, value);
+            break;
+        }
+        case Tag::Number:
+        {
+            double value;
+            stream >> value;
+            lua_pushnumber(state, value);
+            break;
+        }
+        case Tag::String:
+        {
+            u32 length;
+            stream >> length;
+            auto bytes = stream.bytes().slice(stream.offset(), length);
+            lua_pushlstring(state, reinterpret_cast<const char*>(bytes.data()), length);
+            stream.discard_or_error(length);
+            break;
+        }
+        case Tag::Table:
+        {
+            u32 pair_count;
+            stream >> pair_count;
+            luaL_checkstack(state, 3, "not enough stack space to copy the message");
+            lua_createtable(state, 0, pair_count);
+            for (u32 i = 0; i < pair_count; i++)
+            {
+                push_value(state, stream);
+                push_value(state, stream);
+                lua_rawset(state, -3);
+            }
+            break;
+        }
+    }
+}
+
+void Bus::push(lua_State* state, ReadonlyBytes message)
+{
+    InputMemoryStream stream(message);
+    push_value(state, stream);
+}
+}
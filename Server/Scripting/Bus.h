@@ -0,0 +1,46 @@
+/*
+ * Copyright (c) 2021, James Puleo <james@jame.xyz>
+ *
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#pragma once
+
+#include <AK/ByteBuffer.h>
+#include <AK/Result.h>
+#include <AK/String.h>
+#include <AK/Vector.h>
+
+typedef struct lua_State lua_State;
+
+namespace Scripting
+{
+class Thread;
+
+// How plugins talk to each other. Every plugin has its own Lua state, so messages are copied out of the sender's state
+// into bytes, and copied into the state of every plugin that subscribed to the channel.
+class Bus
+{
+public:
+    // Only to be called before any of the threads have started. Threads are added before their plugins are loaded, so
+    // that messages published while loading reach every thread once it starts.
+    void add_thread(Thread& thread) { m_threads.append(&thread); }
+    void remove_thread(Thread& thread)
+    {
+        m_threads.remove_first_matching([&](auto* other_thread) { return other_thread == &thread; });
+    }
+
+    // Safe to call from any thread
+    void publish(StringView channel, ReadonlyBytes message, u32 sender_index, StringView sender_name) const;
+
+    // Messages may hold nil, booleans, numbers, strings, and tables of them, which are copied. Anything else, or
+    // tables nested too deeply (which is how cycles are caught) is an error.
+    static Result<ByteBuffer, String> serialize(lua_State*, int index);
+
+    // Pushes a copy of what serialize() was given
+    static void push(lua_State*, ReadonlyBytes message);
+
+private:
+    Vector<Thread*> m_threads;
+};
+}
@@ -0,0 +1,257 @@
+/*
+ * Copyright (c) 2021, James Puleo <james@jame.xyz>
+ *
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#include <AK/Atomic.h>
+#include <AK/ByteBuffer.h>
+#include <LibCore/DirIterator.h>
+#include <LibCore/File.h>
+#include <Server/Scripting/BytecodeCache.h>
+#include <Server/Scripting/Lua.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace Scripting::BytecodeCache
+{
+static constexpr StringView directory = "Cache";
+
+static Atomic<u64> s_hits{0};
+static Atomic<u64> s_misses{0};
+static Atomic<u64> s_next_temporary_id{0};
+
+// Every entry starts with this, followed by the chunk's path, and then its bytecode. The name of an entry is only a
+// hash, so this is what makes sure it really was compiled from the same source.
+struct [[gnu::packed]] EntryHeader
+{
+    u32 magic;
+    u32 lua_version;
+    u64 chunk_hash;
+    u64 source_size;
+    u32 path_length;
+};
+
+static constexpr u32 entry_magic = 0x43424c54;
+
+// FNV-1a
+static u64 hash_bytes(u64 hash, ReadonlyBytes bytes)
+{
+    for (auto byte : bytes)
+    {
+        hash ^= byte;
+        hash *= 0x100000001b3;
+    }
+    return hash;
+}
+
+static constexpr u64 fnv_offset_basis = 0xcbf29ce484222325;
+
+static u64 hash_path(StringView path) { return hash_bytes(fnv_offset_basis, path.bytes()); }
+
+// The path is part of the key, as it ends up in the bytecode as the chunk's name
+static u64 hash_chunk(StringView path, ReadonlyBytes source)
+{
+    auto hash = hash_bytes(fnv_offset_basis, path.bytes());
+    hash = hash_bytes(hash, ReadonlyBytes("\0", 1));
+    return hash_bytes(hash, source);
+}
+
+// Entries for the same path share a prefix, so that the ones for its older sources can be found and removed
+static String entry_name_prefix(u64 path_hash) { return String::formatted("{:016x}-", path_hash); }
+
+static String entry_name(u64 path_hash, u64 chunk_hash)
+{
+    return String::formatted("{}{:016x}-{}.luac", entry_name_prefix(path_hash), chunk_hash, LUA_VERSION_NUM);
+}
+
+// Loading bytecode skips the checks Lua does on source, and malformed bytecode can do anything, so the cache is only
+// used while nobody but us can write to it. It is created private, and one made before that is made private.
+static bool ensure_private_directory()
+{
+    auto directory_path = String(directory);
+    if (mkdir(directory_path.characters(), 0700) < 0 && errno != EEXIST)
+        return false;
+
+    struct stat directory_stat;
+    if (lstat(directory_path.characters(), &directory_stat) < 0)
+        return false;
+
+    if (!S_ISDIR(directory_stat.st_mode) || directory_stat.st_uid != geteuid())
+        return false;
+
+    if ((directory_stat.st_mode & 077) != 0 && chmod(directory_path.characters(), 0700) < 0)
+        return false;
+
+    return true;
+}
+
+// The bytecode in the entry, if it was compiled from exactly this source
+static Optional<ReadonlyBytes> entry_bytecode(ReadonlyBytes entry, StringView path, u64 chunk_hash, size_t source_size)
+{
+    if (entry.size() < sizeof(EntryHeader))
+        return {};
+
+    EntryHeader header;
+    __builtin_memcpy(&header, entry.data(), sizeof(header));
+    if (header.magic != entry_magic || header.lua_version != LUA_VERSION_NUM || header.chunk_hash != chunk_hash ||
+        header.source_size != source_size || header.path_length != path.length())
+        return {};
+
+    auto bytecode_offset = sizeof(EntryHeader) + path.length();
+    if (entry.size() <= bytecode_offset)
+        return {};
+
+    if (StringView(entry.slice(sizeof(EntryHeader), path.length())) != path)
+        return {};
+
+    return entry.slice(bytecode_offset);
+}
+
+// Editing a script leaves the entries for what it used to be behind, which are never going to be used again
+static void remove_stale_entries(u64 path_hash, const String& current_name)
+{
+    auto prefix = entry_name_prefix(path_hash);
+    Core::DirIterator iterator(directory, Core::DirIterator::SkipDots);
+    while (iterator.has_next())
+    {
+        auto name = iterator.next_path();
+        if (!name.starts_with(prefix) || !name.ends_with(".luac") || name == current_name)
+            continue;
+
+        unlink(String::formatted("{}/{}", directory, name).characters());
+    }
+}
+
+static int write_to_buffer(lua_State*, const void* data, size_t size, void* buffer)
+{
+    reinterpret_cast<ByteBuffer*>(buffer)->append(data, size);
+    return 0;
+}
+
+// Written to a file of its own first, so that a state loading the entry never sees half of it
+static void store(lua_State* state, StringView path, u64 path_hash, u64 chunk_hash, size_t source_size)
+{
+    ByteBuffer entry;
+    EntryHeader header{entry_magic, LUA_VERSION_NUM, chunk_hash, source_size, static_cast<u32>(path.length())};
+    entry.append(&header, sizeof(header));
+    entry.append(path.characters_without_null_termination(), path.length());
+
+    auto header_size = entry.size();
+    if (lua_dump(state, write_to_buffer, &entry, false) != 0 || entry.size() == header_size)
+        return;
+
+    auto name = entry_name(path_hash, chunk_hash);
+    auto entry_path = String::formatted("{}/{}", directory, name);
+    auto temporary_path = String::formatted("{}.{}.{}", entry_path, getpid(),
+                                            s_next_temporary_id.fetch_add(1, AK::MemoryOrder::memory_order_relaxed));
+
+    // Only we may read it, and whatever was at the path before isn't followed or reused
+    auto fd = open(temporary_path.characters(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+    if (fd < 0)
+        return;
+
+    auto written = write(fd, entry.data(), entry.size()) == static_cast<ssize_t>(entry.size());
+    close(fd);
+
+    if (!written || rename(temporary_path.characters(), entry_path.characters()) != 0)
+    {
+        unlink(temporary_path.characters());
+        return;
+    }
+
+    remove_stale_entries(path_hash, name);
+}
+
+Result<void, String> load_file(lua_State* state, StringView path)
+{
+    auto file = Core::File::construct(path);
+    if (!file->open(Core::OpenMode::ReadOnly))
+        return String::formatted("cannot open {}: {}", path, file->error_string());
+
+    auto source = file->read_all();
+    auto chunk_name = String::formatted("@{}", path);
+    auto path_hash = hash_path(path);
+    auto chunk_hash = hash_chunk(path, source.bytes());
+    auto is_cache_usable = ensure_private_directory();
+
+    auto cached_file = Core::File::construct(String::formatted("{}/{}", directory, entry_name(path_hash, chunk_hash)));
+    struct stat entry_stat;
+    if (is_cache_usable && cached_file->open(Core::OpenMode::ReadOnly) && fstat(cached_file->fd(), &entry_stat) == 0 &&
+        entry_stat.st_uid == geteuid() && (entry_stat.st_mode & 077) == 0)
+    {
+        auto entry = cached_file->read_all();
+        auto bytecode = entry_bytecode(entry.bytes(), path, chunk_hash, source.size());
+
+        // A state built for a different lua_Number or lua_Integer rejects the bytecode, and we compile it again
+        if (bytecode.has_value() && luaL_loadbufferx(state, reinterpret_cast<const char*>(bytecode->data()),
+                                                     bytecode->size(), chunk_name.characters(), "b") == LUA_OK)
+        {
+            s_hits.fetch_add(1, AK::MemoryOrder::memory_order_relaxed);
+            return {};
+        }
+
+        if (bytecode.has_value())
+            lua_pop(state, 1);
+    }
+
+    s_misses.fetch_add(1, AK::MemoryOrder::memory_order_relaxed);
+
+    if (luaL_loadbufferx(state, reinterpret_cast<const char*>(source.data()), source.size(), chunk_name.characters(),
+                         "t") != LUA_OK)
+    {
+        auto error = String(lua_tostring(state, -1));
+        lua_pop(state, 1);
+        return error;
+    }
+
+    if (is_cache_usable)
+        store(state, path, path_hash, chunk_hash, source.size());
+    return {};
+}
+
+// Takes the place of Lua's own searcher for Lua files, with the same behavior
+static int search(lua_State* state)
+{
+    auto* name = luaL_checkstring(state, 1);
+
+    lua_getglobal(state, "package");
+    lua_getfield(state, -1, "searchpath");
+    lua_pushstring(state, name);
+    lua_getfield(state, -3, "path");
+    lua_call(state, 2, 2);
+
+    // package.searchpath returns nil, and where it looked
+    if (lua_isnil(state, -2))
+        return 1;
+
+    auto* path = lua_tostring(state, -2);
+    auto result = load_file(state, path);
+    if (result.is_error())
+    {
+        return luaL_error(state, "error loading module '%s' from file '%s':\n\t%s", name, path,
+                          result.error().characters());
+    }
+
+    // The loader is called with the path as its second argument
+    lua_pushstring(state, path);
+    return 2;
+}
+
+void install_searcher(lua_State* state)
+{
+    lua_getglobal(state, "package");
+    lua_getfield(state, -1, "searchers");
+    lua_pushcfunction(state, search);
+    lua_rawseti(state, -2, 2);
+    lua_pop(state, 2);
+}
+
+Statistics statistics()
+{
+    return {s_hits.load(AK::MemoryOrder::memory_order_relaxed), s_misses.load(AK::MemoryOrder::memory_order_relaxed)};
+}
+}
@@ -0,0 +1,36 @@
+/*
+ * Copyright (c) 2021, James Puleo <james@jame.xyz>
+ *
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#pragma once
+
+#include <AK/Result.h>
+#include <AK/String.h>
+
+typedef struct lua_State lua_State;
+
+// Compiled Lua chunks, kept on disk so that scripts aren't parsed again on every start. Every plugin's state loads Base
+// and its modules, so most chunks are compiled once, and then loaded from the cache many times over.
+//
+// Entries are named after a hash of the chunk's path and source, and hold the path and the size of the source, which
+// are checked before an entry is used. Writing a new entry for a path removes the ones for its older sources. The cache
+// is only used while its directory and entries are private to us, as loading bytecode isn't safe otherwise.
+namespace Scripting::BytecodeCache
+{
+// Loads the script at the path as a function onto the top of the stack, like luaL_loadfile. Returns the error instead,
+// with nothing pushed, if the script can't be loaded.
+Result<void, String> load_file(lua_State*, StringView path);
+
+// Has `require` load Lua modules through the cache
+void install_searcher(lua_State*);
+
+struct Statistics
+{
+    u64 hits;
+    u64 misses;
+};
+// For every state, since the server started. Safe to call from any thread.
+Statistics statistics();
+}
@@ -0,0 +1,382 @@
+/*
+ * Copyright (c) 2021, James Puleo <james@jame.xyz>
+ *
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#include <Server/Scripting/ComponentLibrary.h>
+#include <Server/Scripting/Lua.h>
+#include <Server/Scripting/Types.h>
+
+static constexpr const char* metatable_name = "Chat::Component";
+
+namespace Scripting::ComponentLibrary
+{
+using ComponentUserdata = RefPtr<Minecraft::Chat::Component>;
+
+static Minecraft::Chat::Component& check_component(lua_State* state, int index)
+{
+    auto* component = reinterpret_cast<ComponentUserdata*>(luaL_checkudata(state, index, metatable_name));
+    return **component;
+}
+
+static void push_optional_bool(lua_State* state, const Optional<bool>& value)
+{
+    if (value.has_value())
+        lua_pushboolean(state, *value);
+    else
+        lua_pushnil(state);
+}
+
+static Optional<bool> check_optional_bool(lua_State* state, int index)
+{
+    if (lua_isnil(state, index))
+        return {};
+
+    luaL_checktype(state, index, LUA_TBOOLEAN);
+    return lua_toboolean(state, index);
+}
+
+// Whether needle is somewhere in the tree below haystack, including haystack itself. Components are appended by
+// reference, so this is what stops a script from making one contain itself, which would never finish serializing.
+static bool tree_contains(const Minecraft::Chat::Component& haystack, const Minecraft::Chat::Component& needle)
+{
+    if (&haystack == &needle)
+        return true;
+
+    for (auto& child : haystack.children())
+    {
+        if (tree_contains(child, needle))
+            return true;
+    }
+
+    if (auto* translation_component = dynamic_cast<const Minecraft::Chat::TranslationComponent*>(&haystack))
+    {
+        for (auto& replacement : translation_component->translation_format_replacements())
+        {
+            if (tree_contains(replacement, needle))
+                return true;
+        }
+    }
+
+    return false;
+}
+
+static NonnullRefPtr<Minecraft::Chat::Component> check_child(lua_State* state, Minecraft::Chat::Component& parent,
+                                                              int index)
+{
+    auto child = Types::chat_component(state, index);
+    if (tree_contains(child, parent))
+        luaL_error(state, "a component cannot contain itself");
+    return child;
+}
+
+static void push_components(lua_State* state, const NonnullRefPtrVector<Minecraft::Chat::Component>& components)
+{
+    lua_createtable(state, components.size(), 0);
+    for (size_t i = 0; i < components.size(); i++)
+    {
+        push(state, components[i]);
+        lua_rawseti(state, -2, i + 1);
+    }
+}
+
+// Sets one property from the value at value_index, shared by assignments and style()
+static void set_property(lua_State* state, Minecraft::Chat::Component& component, StringView key, int value_index)
+{
+    if (key == "bold")
+        component.set_bold(check_optional_bool(state, value_index));
+    else if (key == "italic")
+        component.set_italic(check_optional_bool(state, value_index));
+    else if (key == "underlined")
+        component.set_underlined(check_optional_bool(state, value_index));
+    else if (key == "strikethrough")
+        component.set_strikethrough(check_optional_bool(state, value_index));
+    else if (key == "obfuscated")
+        component.set_obfuscated(check_optional_bool(state, value_index));
+    else if (key == "font")
+        component.set_font(lua_isnil(state, value_index) ? Optional<String>{}
+                                                          : String(luaL_checkstring(state, value_index)));
+    else if (key == "color")
+    {
+        if (lua_isnil(state, value_index))
+        {
+            component.set_color(Optional<Minecraft::Chat::Component::NamedColor>{});
+        }
+        else if (lua_type(state, value_index) == LUA_TSTRING)
+        {
+            auto color_name = StringView(lua_tostring(state, value_index));
+            if (color_name.starts_with('#'))
+            {
+                auto maybe_color = Gfx::Color::from_string(color_name);
+                if (!maybe_color.has_value())
+                    luaL_error(state, "\"%s\" is not a valid hexadecimal color", color_name.to_string().characters());
+                component.set_color(*maybe_color);
+            }
+            else
+            {
+                auto maybe_named_color = Minecraft::Chat::Component::named_color_value_for_string(color_name);
+                if (!maybe_named_color.has_value())
+                    luaL_error(state, "\"%s\" is not a valid named color", color_name.to_string().characters());
+                component.set_color(*maybe_named_color);
+            }
+        }
+        else
+        {
+            component.set_color(Gfx::Color::from_rgb(luaL_checkinteger(state, value_index)));
+        }
+    }
+    else if (key == "text")
+    {
+        auto* text_component = dynamic_cast<Minecraft::Chat::TextComponent*>(&component);
+        if (!text_component)
+            luaL_error(state, "\"text\" can only be set on text components");
+        text_component->set_text(luaL_checkstring(state, value_index));
+    }
+    else if (key == "translate")
+    {
+        auto* translation_component = dynamic_cast<Minecraft::Chat::TranslationComponent*>(&component);
+        if (!translation_component)
+            luaL_error(state, "\"translate\" can only be set on translation components");
+        translation_component->set_translation_key(luaL_checkstring(state, value_index));
+    }
+    else
+    {
+        luaL_error(state, "\"%s\" is not a property of components", key.to_string().characters());
+    }
+}
+
+static int component_text(lua_State* state)
+{
+    push(state, create<Minecraft::Chat::TextComponent>(luaL_checkstring(state, 1)));
+    return 1;
+}
+
+static int component_translate(lua_State* state)
+{
+    auto component = create<Minecraft::Chat::TranslationComponent>(luaL_checkstring(state, 1));
+
+    auto top = lua_gettop(state);
+    for (auto i = 2; i <= top; i++)
+        component->append_translation_format_replacement(Types::chat_component(state, i));
+
+    push(state, component);
+    return 1;
+}
+
+static int component_append(lua_State* state)
+{
+    auto& component = check_component(state, 1);
+    component.append(check_child(state, component, 2));
+    lua_settop(state, 1);
+    return 1;
+}
+
+static int component_with(lua_State* state)
+{
+    auto* translation_component = dynamic_cast<Minecraft::Chat::TranslationComponent*>(&check_component(state, 1));
+    if (!translation_component)
+        luaL_error(state, "format replacements can only be added to translation components");
+
+    translation_component->append_translation_format_replacement(check_child(state, *translation_component, 2));
+    lua_settop(state, 1);
+    return 1;
+}
+
+static int component_style(lua_State* state)
+{
+    auto& component = check_component(state, 1);
+    luaL_checktype(state, 2, LUA_TTABLE);
+
+    lua_pushnil(state);
+    while (lua_next(state, 2) != 0)
+    {
+        if (lua_type(state, -2) != LUA_TSTRING)
+            luaL_error(state, "style keys must be strings");
+
+        set_property(state, component, lua_tostring(state, -2), lua_gettop(state));
+        lua_pop(state, 1);
+    }
+
+    lua_settop(state, 1);
+    return 1;
+}
+
+static int component_index(lua_State* state)
+{
+    auto& component = check_component(state, 1);
+
+    // Methods live in the first upvalue
+    lua_pushvalue(state, 2);
+    lua_rawget(state, lua_upvalueindex(1));
+    if (!lua_isnil(state, -1))
+        return 1;
+    lua_pop(state, 1);
+
+    auto key = StringView(luaL_checkstring(state, 2));
+
+    if (key == "bold")
+    {
+        push_optional_bool(state, component.is_bold());
+    }
+    else if (key == "italic")
+    {
+        push_optional_bool(state, component.is_italic());
+    }
+    else if (key == "underlined")
+    {
+        push_optional_bool(state, component.is_underlined());
+    }
+    else if (key == "strikethrough")
+    {
+        push_optional_bool(state, component.has_strikethrough());
+    }
+    else if (key == "obfuscated")
+    {
+        push_optional_bool(state, component.is_obfuscated());
+    }
+    else if (key == "font")
+    {
+        if (component.font().has_value())
+            lua_pushstring(state, component.font()->characters());
+        else
+            lua_pushnil(state);
+    }
+    else if (key == "color")
+    {
+        if (!component.color().has_value())
+        {
+            lua_pushnil(state);
+            return 1;
+        }
+
+        component.color()->visit(
+            [&](const Minecraft::Chat::Component::NamedColor& named_color) {
+                lua_pushstring(state, Minecraft::Chat::Component::named_color_name_for_value(named_color).characters());
+            },
+            [&](const Gfx::Color& color) { lua_pushinteger(state, color.value()); });
+    }
+    else if (key == "text")
+    {
+        if (auto* text_component = dynamic_cast<Minecraft::Chat::TextComponent*>(&component))
+            lua_pushstring(state, text_component->text().characters());
+        else
+            lua_pushnil(state);
+    }
+    else if (key == "translate")
+    {
+        if (auto* translation_component = dynamic_cast<Minecraft::Chat::TranslationComponent*>(&component))
+            lua_pushstring(state, translation_component->translation_key().characters());
+        else
+            lua_pushnil(state);
+    }
+    else if (key == "extra")
+    {
+        if (component.children().is_empty())
+            lua_pushnil(state);
+        else
+            push_components(state, component.children());
+    }
+    else if (key == "replacements")
+    {
+        // Not "with", like in the JSON, as that's the method which adds one
+        auto* translation_component = dynamic_cast<Minecraft::Chat::TranslationComponent*>(&component);
+        if (translation_component && !translation_component->translation_format_replacements().is_empty())
+            push_components(state, translation_component->translation_format_replacements());
+        else
+            lua_pushnil(state);
+    }
+    else
+    {
+        lua_pushnil(state);
+    }
+
+    return 1;
+}
+
+// Components used to be handed to scripts as plain tables, so pairs() still walks the same fields, and "extra", by
+// iterating a snapshot table of them.
+static int component_pairs(lua_State* state)
+{
+    check_component(state, 1);
+
+    static constexpr const char* keys[] = {"bold", "italic",    "underlined", "strikethrough", "obfuscated",  "font",
+                                           "color", "text", "translate", "extra",      "replacements"};
+
+    lua_getglobal(state, "next");
+    lua_newtable(state);
+    for (auto* key : keys)
+    {
+        // __index, rather than component_index itself, as it needs the methods upvalue
+        luaL_getmetafield(state, 1, "__index");
+        lua_pushvalue(state, 1);
+        lua_pushstring(state, key);
+        lua_call(state, 2, 1);
+        lua_setfield(state, -2, key);
+    }
+    lua_pushnil(state);
+    return 3;
+}
+
+static int component_newindex(lua_State* state)
+{
+    set_property(state, check_component(state, 1), luaL_checkstring(state, 2), 3);
+    return 0;
+}
+
+static int component_tostring(lua_State* state)
+{
+    StringBuilder builder;
+    check_component(state, 1).write_json(builder);
+    auto json = builder.string_view();
+    lua_pushlstring(state, json.characters_without_null_termination(), json.length());
+    return 1;
+}
+
+static int component_gc(lua_State* state)
+{
+    auto* component = reinterpret_cast<ComponentUserdata*>(luaL_checkudata(state, 1, metatable_name));
+    component->~ComponentUserdata();
+    return 0;
+}
+
+void open(lua_State* state)
+{
+    static const struct luaL_Reg methods[] = {
+        {"append", component_append}, {"with", component_with}, {"style", component_style}, {}};
+
+    static const struct luaL_Reg metamethods[] = {
+        {"__newindex", component_newindex}, {"__tostring", component_tostring},
+        {"__pairs", component_pairs},       {"__gc", component_gc},             {}};
+
+    static const struct luaL_Reg constructors[] = {{"text", component_text}, {"translate", component_translate}, {}};
+
+    luaL_newmetatable(state, metatable_name);
+    luaL_setfuncs(state, metamethods, 0);
+
+    luaL_newlib(state, methods);
+    lua_pushcclosure(state, component_index, 1);
+    lua_setfield(state, -2, "__index");
+
+    lua_pop(state, 1);
+
+    luaL_newlib(state, constructors);
+    lua_setglobal(state, "Component");
+}
+
+void push(lua_State* state, NonnullRefPtr<Minecraft::Chat::Component> component)
+{
+    auto* component_ud = lua_newuserdata(state, sizeof(ComponentUserdata));
+    new (component_ud) ComponentUserdata(move(component));
+    luaL_setmetatable(state, metatable_name);
+}
+
+RefPtr<Minecraft::Chat::Component> to_component(lua_State* state, int index)
+{
+    auto* component = reinterpret_cast<ComponentUserdata*>(luaL_testudata(state, index, metatable_name));
+    if (!component)
+        return {};
+
+    return *component;
+}
+}
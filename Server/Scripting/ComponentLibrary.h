@@ -0,0 +1,34 @@
+/*
+ * Copyright (c) 2021, James Puleo <james@jame.xyz>
+ *
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#pragma once
+
+#include <AK/NonnullRefPtr.h>
+#include <AK/RefPtr.h>
+#include <LibMinecraft/Chat/Component.h>
+
+typedef struct lua_State lua_State;
+
+// Chat components as Lua userdata, which hold a reference to the native component. Scripts build and change them in
+// place, and handing one back to us is a pointer copy, instead of converting a table into a tree of components.
+//
+//     local message = Component.text("Hello, ")
+//     message:append(Component.text(name):style({ color = "gold", bold = true }))
+//     message.italic = true
+//
+// Components we hand to scripts used to be plain tables, and are now these userdata. Reading fields and pairs() work
+// like they did, and children are under "extra" (and "replacements" for translations), but type() is "userdata", and
+// next()/rawget() don't see any fields. A component can't be appended to itself, or to anything inside it.
+namespace Scripting::ComponentLibrary
+{
+// Registers the metatable, and the global Component table
+void open(lua_State*);
+
+void push(lua_State*, NonnullRefPtr<Minecraft::Chat::Component>);
+
+// The component held by the userdata at this index, or null when it isn't a component userdata
+RefPtr<Minecraft::Chat::Component> to_component(lua_State*, int index);
+}
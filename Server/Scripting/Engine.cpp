@@ -7,24 +7,40 @@
 #include "Types.h"
 #include <AK/Assertions.h>
 #include <AK/JsonObject.h>
-#include <AK/LexicalPath.h>
-#include <LibCore/DirIterator.h>
+#include <LibMinecraft/Net/Packets/Login/Clientbound/Disconnect.h>
 #include <LibMinecraft/Net/Packets/Play/Clientbound/ChatMessage.h>
 #include <LibMinecraft/Net/Packets/Play/Clientbound/PlayerListHeaderAndFooter.h>
+#include <Server/Scripting/Bus.h>
+#include <Server/Scripting/BytecodeCache.h>
+#include <Server/Scripting/ComponentLibrary.h>
 #include <Server/Scripting/Engine.h>
 #include <Server/Scripting/Format.h>
+#include <Server/Clock.h>
+#include <Server/DestinationServer.h>
+#include <Server/Frame.h>
 #include <Server/Scripting/Lua.h>
+#include <Server/Scripting/PacketWatches.h>
+#include <Server/Scripting/Profiler.h>
 #include <Server/Server.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 namespace Scripting
 {
-HashMap<lua_State*, Engine*> Engine::s_engines;
-
-Engine::Engine(Server& server) : m_server(server)
+Engine::Engine(Thread& thread, const Server& server, u32 plugin_index, String plugin_name,
+               HookSubscriberCounts& shared_hook_subscriber_counts)
+    : m_thread(thread), m_server(server), m_plugin_index(plugin_index), m_plugin_name(move(plugin_name)),
+      m_shared_hook_subscriber_counts(shared_hook_subscriber_counts)
 {
-    m_state = luaL_newstate();
-    VERIFY(m_state);
-    s_engines.set(m_state, this);
+    m_main_state = luaL_newstate();
+    VERIFY(m_main_state);
+    m_state = m_main_state;
+    *reinterpret_cast<Engine**>(lua_getextraspace(m_state)) = this;
     lua_atpanic(m_state, at_panic_thunk);
     luaL_openlibs(m_state);
 
@@ -35,14 +51,42 @@ Engine::Engine(Server& server) : m_server(server)
         {"disconnect", client_disconnect_thunk},
         {"sendMessage", client_send_message_thunk},
         {"setPlayerListHeaderAndFooter", client_set_player_list_header_and_footer_thunk},
+        {"waitForPacket", client_wait_for_packet_thunk},
         {}};
 
+    static const struct luaL_Reg hooks_lib[] = {{"add", hooks_add_thunk},
+                                                 {"remove", hooks_remove_thunk},
+                                                 {"functions", hooks_functions_thunk},
+                                                 {"call", hooks_call_thunk},
+                                                 {"subscribers", hooks_subscribers_thunk},
+                                                 {}};
+
+    static const struct luaL_Reg clients_lib[] = {
+        {"broadcast", clients_broadcast_thunk}, {"statistics", clients_statistics_thunk}, {}};
+
+    static const struct luaL_Reg scripting_lib[] = {
+        {"statistics", scripting_statistics_thunk}, {"reload", scripting_reload_thunk}, {}};
+
+    static const struct luaL_Reg profiler_lib[] = {{"report", profiler_report_thunk},
+                                                    {"dump", profiler_dump_thunk},
+                                                    {"setSampling", profiler_set_sampling_thunk},
+                                                    {"setInstructionBudget", profiler_set_instruction_budget_thunk},
+                                                    {"reset", profiler_reset_thunk},
+                                                    {}};
+
+    static const struct luaL_Reg backend_lib[] = {{"ping", backend_ping_thunk}, {}};
+
+    static const struct luaL_Reg bus_lib[] = {{"publish", bus_publish_thunk},
+                                               {"subscribe", bus_subscribe_thunk},
+                                               {"unsubscribe", bus_unsubscribe_thunk},
+                                               {}};
+
     luaL_newmetatable(m_state, "Server::Client");
     lua_pushstring(m_state, "__index");
     lua_pushvalue(m_state, -2);
     lua_settable(m_state, -3);
 
-    luaL_setfuncs(m_state, client_lib, 0);
+    set_functions(client_lib);
     lua_pop(m_state, 1);
 
     luaL_newmetatable(m_state, "Engine::Timer");
@@ -50,71 +94,212 @@ Engine::Engine(Server& server) : m_server(server)
     lua_pushvalue(m_state, -2);
     lua_settable(m_state, -3);
 
-    luaL_setfuncs(m_state, timer_lib, 0);
+    set_functions(timer_lib);
     lua_pop(m_state, 1);
 
-    luaL_newlib(m_state, timer_lib);
+    luaL_newlibtable(m_state, timer_lib);
+    set_functions(timer_lib);
     lua_setglobal(m_state, "Timer");
 
-    lua_pushcfunction(m_state, format_thunk);
+    luaL_newlibtable(m_state, clients_lib);
+    set_functions(clients_lib);
+    lua_setglobal(m_state, "Clients");
+
+    luaL_newlibtable(m_state, scripting_lib);
+    set_functions(scripting_lib);
+    lua_setglobal(m_state, "Scripting");
+
+    luaL_newlibtable(m_state, profiler_lib);
+    set_functions(profiler_lib);
+    lua_setglobal(m_state, "Profiler");
+
+    luaL_newlibtable(m_state, backend_lib);
+    set_functions(backend_lib);
+    lua_setglobal(m_state, "Backend");
+
+    lua_pushlightuserdata(m_state, this);
+    lua_pushcclosure(m_state, sleep_thunk, 1);
+    lua_setglobal(m_state, "sleep");
+
+    luaL_newlibtable(m_state, bus_lib);
+    set_functions(bus_lib);
+    lua_setglobal(m_state, "Bus");
+
+    lua_createtable(m_state, 0, 1);
+    lua_pushlstring(m_state, m_plugin_name.characters(), m_plugin_name.length());
+    lua_setfield(m_state, -2, "name");
+    lua_setglobal(m_state, "Plugin");
+
+    // Base/Hooks.lua hands this out to scripts
+    luaL_newlibtable(m_state, hooks_lib);
+    set_functions(hooks_lib);
+    lua_setglobal(m_state, "NativeHooks");
+
+    ComponentLibrary::open(m_state);
+
+    lua_pushlightuserdata(m_state, this);
+    lua_pushcclosure(m_state, format_thunk, 1);
     lua_setglobal(m_state, "format");
 
-    auto errored = luaL_dofile(m_state, "Base/Base.lua");
-    if (errored)
+    m_profiler = make<Profiler>(m_state, m_plugin_name);
+
+    BytecodeCache::install_searcher(m_state);
+
+    auto base = BytecodeCache::load_file(m_state, "Base/Base.lua");
+    if (base.is_error())
+    {
+        warnln("Engine failed startup: {}", base.error());
+        VERIFY_NOT_REACHED();
+    }
+
+    if (lua_pcall(m_state, 0, 1, 0) != LUA_OK)
     {
         warnln("Engine failed startup: {}", lua_tostring(m_state, -1));
         VERIFY_NOT_REACHED();
     }
 
     m_base_ref = luaL_ref(m_state, LUA_REGISTRYINDEX);
+}
 
-    constexpr StringView plugins_directory = "Plugins";
+Result<NonnullOwnPtr<Engine>, String> Engine::try_create(Thread& thread, const Server& server, u32 plugin_index,
+                                                         String plugin_name, StringView path,
+                                                         HookSubscriberCounts& shared_hook_subscriber_counts)
+{
+    auto engine =
+        adopt_own(*new Engine(thread, server, plugin_index, move(plugin_name), shared_hook_subscriber_counts));
 
-    if (Core::File::exists(plugins_directory) && Core::File::is_directory(plugins_directory))
-    {
-        auto plugins_dir_iterator = Core::DirIterator(plugins_directory, Core::DirIterator::SkipDots);
+    // Clients that came before this Engine was loaded, or before the one it replaces was
+    for (auto& client : thread.clients())
+        engine->m_known_clients.set(client.key, {{}, client.value});
 
-        while (plugins_dir_iterator.has_next())
-        {
-            auto entry = plugins_dir_iterator.next_full_path();
-            if (!Core::File::is_directory(entry))
-                continue;
+    auto loaded = BytecodeCache::load_file(engine->m_state, path);
+    if (loaded.is_error())
+        return loaded.release_error();
 
-            auto entry_path = LexicalPath(entry);
-            auto plugin_main_path = entry_path.append("init.lua");
-            if (Core::File::exists(plugin_main_path.string()))
-            {
-                errored = luaL_dofile(m_state, plugin_main_path.string().characters());
-                if (errored)
-                {
-                    warnln("\u001b[31mFailed to load plugin from path {}\u001b[0m", plugin_main_path);
-                    warnln("\u001b[31m{}\u001b[0m", lua_tostring(m_state, -1));
-                }
-                else
-                {
-                    outln("\u001b[36mLoaded plugin {}\u001b[0m", plugin_main_path);
-                }
-            }
-        }
-    }
-    else
-    {
-        warnln("No plugins directory found, not loading any plugins.");
-    }
+    auto result = engine->protected_call("load", 0, 0);
+    if (result.is_error())
+        return result.release_error();
+
+    // Loading is the one time a full collection is fine, which gives us a heap to measure growth against. From here
+    // on, the Thread collects, and Lua's own collector only starts a cycle if it never gets the chance.
+    lua_gc(engine->m_main_state, LUA_GCCOLLECT, 0);
+    lua_gc(engine->m_main_state, LUA_GCSETPAUSE, collector_pause_percent);
+    engine->m_live_kilobytes = engine->heap_kilobytes();
+
+    return move(engine);
 }
 
 int Engine::format()
 {
-    lua_pushstring(m_state, Scripting::format(m_state, 1).characters());
+    m_format_cache.push_formatted(m_state, 1);
     return 1;
 }
 
 Engine::~Engine()
 {
-    s_engines.remove(m_state);
+    // Whoever waits on a task that won't get to finish still gets an answer, like a status request does
+    m_state = m_main_state;
+    auto task_ids = m_tasks.keys();
+    for (auto task_id : task_ids)
+    {
+        auto& task = m_tasks.find(task_id)->value;
+        if (auto on_finish = move(task.on_finish))
+        {
+            lua_settop(task.thread, 0);
+            on_finish(task.thread, true);
+        }
+    }
+
+    for (size_t i = 0; i < m_hook_subscriber_counts.size(); i++)
+    {
+        m_shared_hook_subscriber_counts[i].fetch_sub(m_hook_subscriber_counts[i],
+                                                     AK::MemoryOrder::memory_order_relaxed);
+    }
+
+    for (auto& timer : m_timer_function_refs)
+        m_thread.remove_timer(timer.key);
+
+    // Tasks that are still waiting are simply never resumed
+    for (auto timer_id : m_wait_timer_ids)
+        m_thread.remove_timer(timer_id);
+
+    for (auto& ping : m_pending_pings)
+    {
+        m_thread.unwatch_fd(ping.key);
+        close(ping.key);
+    }
+
     luaL_unref(m_state, LUA_REGISTRYINDEX, m_base_ref);
     m_base_ref = 0;
-    lua_close(m_state);
+    lua_close(m_main_state);
+}
+
+Engine& Engine::from_upvalue(lua_State* state)
+{
+    return *reinterpret_cast<Engine*>(lua_touserdata(state, lua_upvalueindex(1)));
+}
+
+void Engine::set_functions(const luaL_Reg* functions)
+{
+    lua_pushlightuserdata(m_state, this);
+    luaL_setfuncs(m_state, functions, 1);
+}
+
+static int traceback_message_handler(lua_State* state)
+{
+    auto* message = lua_tostring(state, 1);
+    luaL_traceback(state, state, message ? message : "(error object is not a string)", 1);
+    return 1;
+}
+
+Result<void, String> Engine::protected_call(StringView what, int argument_count, int result_count)
+{
+    auto message_handler_index = lua_gettop(m_state) - argument_count;
+    lua_pushcfunction(m_state, traceback_message_handler);
+    lua_insert(m_state, message_handler_index);
+
+    // Whatever we call may resume other Lua threads of ours, which would leave m_state pointing at them
+    auto* state = m_state;
+    m_profiler->will_call(m_state, what);
+    auto errored = lua_pcall(m_state, argument_count, result_count, message_handler_index) != LUA_OK;
+    m_profiler->did_call(errored);
+    m_state = state;
+
+    if (!errored)
+    {
+        lua_remove(m_state, message_handler_index);
+        return {};
+    }
+
+    auto error = String(lua_tostring(m_state, -1));
+    lua_settop(m_state, message_handler_index - 1);
+
+    // Callers can go on as if the call returned nothing
+    for (auto i = 0; i < result_count; i++)
+        lua_pushnil(m_state);
+
+    return error;
+}
+
+bool Engine::call_and_log(StringView what, int argument_count, int result_count)
+{
+    auto result = protected_call(what, argument_count, result_count);
+    if (!result.is_error())
+        return true;
+
+    warnln("\u001b[31mPlugin {} failed in {}: {}\u001b[0m", m_plugin_name, what, result.error());
+    return false;
+}
+
+String Engine::default_folded_stacks_path() const
+{
+    mkdir("Profiles", 0755);
+    return String::formatted("Profiles/{}.folded", m_plugin_name);
+}
+
+int Engine::at_panic_thunk(lua_State* state)
+{
+    return (*reinterpret_cast<Engine**>(lua_getextraspace(state)))->at_panic();
 }
 
 int Engine::at_panic()
@@ -128,141 +313,1027 @@ int Engine::at_panic()
     return 0;
 }
 
-void Engine::client_did_request_status(Badge<Server>, Client& who)
+void Engine::handle_event(Badge<Thread>, Event& event)
+{
+    m_state = m_main_state;
+
+    switch (event.type)
+    {
+        case Event::Type::RequestStatus:
+            client_did_request_status(event.client_id, event.request_id);
+            break;
+        case Event::Type::RequestLogin:
+            client_did_request_login(event.client_id, event.username, event.request_id);
+            break;
+        case Event::Type::ClientConnectedToDestinationServer:
+            known_client(event.client_id).is_connected_to_destination_server = true;
+            break;
+        case Event::Type::ClientSentPacket:
+            client_did_send_packet(event);
+            break;
+        case Event::Type::ClientDisconnected:
+        {
+            Vector<u64> waiting_task_ids;
+            for (auto& wait : m_packet_waits)
+            {
+                if (wait.value.client_id == event.client_id)
+                    waiting_task_ids.append(wait.key);
+            }
+            for (auto task_id : waiting_task_ids)
+                resume_packet_wait(task_id, {}, "client has disconnected");
+
+            // A script may have started waiting after the I/O thread forgot about the client's watches
+            m_thread.packet_watches().remove_client(event.client_id);
+
+            auto client = m_known_clients.find(event.client_id);
+            if (client == m_known_clients.end())
+                break;
+
+            // Scripts may still hold on to the userdata, but it will no longer resolve to a client
+            if (client->value.userdata_ref.has_value())
+                luaL_unref(m_state, LUA_REGISTRYINDEX, *client->value.userdata_ref);
+            m_known_clients.remove(client);
+            break;
+        }
+        case Event::Type::BusMessage:
+            did_receive_bus_message(event);
+            break;
+        case Event::Type::DumpProfiles:
+        {
+            m_profiler->print_report();
+            auto& gc = m_garbage_collection_statistics;
+            outln("Garbage collection of plugin {}: {} KiB in use, {} cycles, {} idle and {} forced steps, {:.3}ms in "
+                  "total, longest pause {:.3}ms",
+                  m_plugin_name, heap_kilobytes(), gc.cycles, gc.idle_steps, gc.forced_steps,
+                  gc.total_nanoseconds / 1'000'000.0, gc.max_pause_nanoseconds / 1'000'000.0);
+            if (m_profiler->sampled_stack_count() == 0)
+                break;
+
+            auto path = default_folded_stacks_path();
+            auto result = m_profiler->write_folded_stacks(path);
+            if (result.is_error())
+                warnln("\u001b[31mFailed to write the profile of plugin {}: {}\u001b[0m", m_plugin_name,
+                       result.error());
+            else
+                outln("\u001b[36mWrote the profile of plugin {} to {}\u001b[0m", m_plugin_name, path);
+            break;
+        }
+        case Event::Type::ReloadPlugins:
+        case Event::Type::Shutdown:
+            VERIFY_NOT_REACHED();
+    }
+}
+
+// The heap has to grow by at least this much before it is collected, so small plugins aren't collected constantly
+static constexpr size_t min_garbage_kilobytes = 1024;
+
+size_t Engine::heap_kilobytes() const { return static_cast<size_t>(lua_gc(m_main_state, LUA_GCCOUNT, 0)); }
+
+bool Engine::has_garbage_to_collect() const
 {
-    UsingBaseTable base(*this);
+    if (m_is_collecting_garbage)
+        return true;
+
+    // Like Lua's own default pause of 200%, but earlier, as collecting while idle costs us nothing
+    return heap_kilobytes() > m_live_kilobytes + max(m_live_kilobytes / 2, min_garbage_kilobytes);
+}
+
+bool Engine::is_over_garbage_limit() const
+{
+    return heap_kilobytes() > m_live_kilobytes * 3 + min_garbage_kilobytes;
+}
+
+void Engine::collect_garbage(Badge<Thread>, u64 budget_nanoseconds, bool is_forced)
+{
+    // Each step does about this much work, in kilobytes allocated, so that we check the clock often enough
+    static constexpr int step_kilobytes = 64;
+
+    auto started_at = Clock::monotonic_nanoseconds();
+    m_is_collecting_garbage = true;
+    do
+    {
+        if (lua_gc(m_main_state, LUA_GCSTEP, step_kilobytes) == 1)
+        {
+            m_is_collecting_garbage = false;
+            m_live_kilobytes = heap_kilobytes();
+            m_garbage_collection_statistics.cycles++;
+            break;
+        }
+    } while (Clock::monotonic_nanoseconds() - started_at < budget_nanoseconds);
+
+    auto pause_nanoseconds = Clock::monotonic_nanoseconds() - started_at;
+    auto& statistics = m_garbage_collection_statistics;
+    if (is_forced)
+        statistics.forced_steps++;
+    else
+        statistics.idle_steps++;
+    statistics.total_nanoseconds += pause_nanoseconds;
+    statistics.max_pause_nanoseconds = max(statistics.max_pause_nanoseconds, pause_nanoseconds);
+}
+
+void Engine::client_did_request_status(u32 client_id, u64 request_id)
+{
+    // The I/O thread waits for every plugin on this thread to answer, even those that have nothing to say
+    Action action;
+    action.type = Action::Type::StatusResponse;
+    action.client_ids.append(client_id);
+    action.request_id = request_id;
+    action.plugin_index = m_plugin_index;
+
+    if (!has_subscribers(Hook::RequestStatus))
+    {
+        m_thread.post_action(move(action));
+        return;
+    }
+
+    // Hooks may wait, in which case the response is sent once they are done, or once the deadline passes
+    m_pending_status_responses.set(request_id, {move(action), {}});
+    push_base_table();
     lua_getfield(m_state, -1, "onRequestStatus");
-    client_userdata(who);
-    lua_call(m_state, 1, 1);
-    auto data = Types::status_request_response_data(m_state, lua_gettop(m_state));
-    Minecraft::Net::Packets::Status::Clientbound::Response response(data);
-    who.send(response);
+    lua_remove(m_state, -2);
+    client_userdata(client_id);
+    start_task("requestStatus", 1, [this, request_id](lua_State* thread, bool errored) {
+        auto pending_response = m_pending_status_responses.find(request_id);
+        // We answered without it when the deadline passed
+        if (pending_response == m_pending_status_responses.end())
+            return;
+
+        auto action = move(pending_response->value.action);
+        auto deadline_timer_id = pending_response->value.deadline_timer_id;
+        m_pending_status_responses.remove(pending_response);
+        if (deadline_timer_id.has_value() && m_wait_timer_ids.contains(*deadline_timer_id))
+            remove_wait_timer(*deadline_timer_id);
+
+        if (!errored && !lua_isnil(thread, -1))
+        {
+            auto data = Types::status_request_response_data(thread, lua_gettop(thread));
+            action.frame = Frame::encode_bytes(Minecraft::Net::Packets::Status::Clientbound::Response(data));
+        }
+        m_thread.post_action(move(action));
+    });
+
+    // Otherwise it is waiting on something
+    auto pending_response = m_pending_status_responses.find(request_id);
+    if (pending_response == m_pending_status_responses.end())
+        return;
+
+    auto deadline_timer_id = add_wait_timer(status_response_deadline_milliseconds, [this, request_id] {
+        auto late_response = m_pending_status_responses.find(request_id);
+        VERIFY(late_response != m_pending_status_responses.end());
+
+        auto action = move(late_response->value.action);
+        m_pending_status_responses.remove(late_response);
+        warnln("\u001b[31mPlugin {} took too long to answer a status request, answering without it\u001b[0m",
+               m_plugin_name);
+        m_thread.post_action(move(action));
+    });
+    pending_response->value.deadline_timer_id = deadline_timer_id;
 }
 
-void Engine::client_did_request_login(Badge<Server>, Client& who,
-                                      Minecraft::Net::Packets::Login::Serverbound::LoginStart& packet)
+void Engine::client_did_request_login(u32 client_id, const String& username, u64 request_id)
 {
-    UsingBaseTable base(*this);
+    // The client is only handed off once every plugin has answered, so hooks can disconnect it before it ever reaches
+    // the backend
+    Action action;
+    action.type = Action::Type::LoginResponse;
+    action.request_id = request_id;
+    action.plugin_index = m_plugin_index;
+
+    if (!has_subscribers(Hook::RequestLogin))
+    {
+        m_thread.post_action(move(action));
+        return;
+    }
+
+    push_base_table();
     lua_getfield(m_state, -1, "onRequestLogin");
-    client_userdata(who);
-    lua_pushstring(m_state, packet.username().characters());
-    lua_call(m_state, 2, 0);
+    lua_remove(m_state, -2);
+    client_userdata(client_id);
+    lua_pushlstring(m_state, username.characters(), username.length());
+    start_task("requestLogin", 2,
+               [this, action = move(action)](lua_State*, bool) mutable { m_thread.post_action(move(action)); });
 }
 
-void* Engine::client_userdata(Client& client)
+void Engine::did_receive_bus_message(const Event& event)
 {
-    auto client_ud = lua_newuserdata(m_state, sizeof(WeakPtr<Client>));
-    new (client_ud) WeakPtr<Client>(client);
-    luaL_getmetatable(m_state, "Server::Client");
-    lua_setmetatable(m_state, -2);
-    return client_ud;
+    // Plugins don't hear their own messages
+    if (event.sender_index == m_plugin_index)
+        return;
+
+    auto function_refs = m_bus_function_refs.find(event.channel);
+    if (function_refs == m_bus_function_refs.end())
+        return;
+
+    auto what = String::formatted("bus:{}", event.channel);
+
+    // Each subscriber gets a task, and its own copy of the message. Subscribers may unsubscribe others as they run, so
+    // go over a copy of the functions, and skip any that were removed. The copy holds the functions rather than their
+    // references, as a removed function's reference may already have been given to another one.
+    auto subscriber_count = function_refs->value.size();
+    lua_createtable(m_state, subscriber_count, 0);
+    auto subscribers_index = lua_gettop(m_state);
+    for (size_t i = 0; i < subscriber_count; i++)
+    {
+        lua_rawgeti(m_state, LUA_REGISTRYINDEX, function_refs->value[i]);
+        lua_rawseti(m_state, subscribers_index, i + 1);
+    }
+
+    for (size_t i = 0; i < subscriber_count; i++)
+    {
+        lua_rawgeti(m_state, subscribers_index, i + 1);
+
+        function_refs = m_bus_function_refs.find(event.channel);
+        if (function_refs == m_bus_function_refs.end() || !find_function(function_refs->value, -1).has_value())
+        {
+            lua_pop(m_state, 1);
+            continue;
+        }
+
+        Bus::push(m_state, event.message);
+        lua_pushlstring(m_state, event.sender_name.characters(), event.sender_name.length());
+        start_task(what, 2);
+    }
+
+    lua_pop(m_state, 1);
 }
 
-void* Engine::timer_userdata(Core::Timer& timer) const
+void Engine::start_task(StringView what, int argument_count, Function<void(lua_State*, bool)> on_finish)
 {
-    auto* timer_ud = lua_newuserdata(m_state, sizeof(WeakPtr<Core::Timer>));
-    new (timer_ud) WeakPtr<Core::Timer>(timer);
-    luaL_getmetatable(m_state, "Engine::Timer");
-    lua_setmetatable(m_state, -2);
-    return timer_ud;
+    VERIFY(m_state == m_main_state);
+
+    auto* thread = lua_newthread(m_state);
+    auto thread_ref = luaL_ref(m_state, LUA_REGISTRYINDEX);
+    lua_xmove(m_state, thread, argument_count + 1);
+
+    auto task_id = m_next_task_id++;
+    m_tasks.set(task_id, {thread, thread_ref, what.to_string(), move(on_finish)});
+    m_task_ids_by_thread.set(thread, task_id);
+
+    resume_task(task_id, argument_count);
+}
+
+void Engine::resume_task(u64 task_id, int argument_count)
+{
+    auto task = m_tasks.find(task_id);
+    VERIFY(task != m_tasks.end());
+    auto* thread = task->value.thread;
+
+    m_profiler->will_call(thread, task->value.what, task->value.hook_depth);
+    auto status = lua_resume(thread, m_main_state, argument_count);
+    auto errored = status != LUA_OK && status != LUA_YIELD;
+    auto hook_depth = m_profiler->hook_depth();
+    m_profiler->did_call(errored);
+    m_state = m_main_state;
+
+    // Running the task may have started others
+    task = m_tasks.find(task_id);
+    if (status == LUA_YIELD)
+    {
+        task->value.hook_depth = hook_depth;
+        return;
+    }
+
+    auto what = move(task->value.what);
+    auto thread_ref = task->value.thread_ref;
+    auto on_finish = move(task->value.on_finish);
+    m_tasks.remove(task);
+    m_task_ids_by_thread.remove(thread);
+
+    if (errored)
+    {
+        auto* message = lua_tostring(thread, -1);
+        luaL_traceback(m_state, thread, message ? message : "(error object is not a string)", 0);
+        warnln("\u001b[31mPlugin {} failed in {}: {}\u001b[0m", m_plugin_name, what, lua_tostring(m_state, -1));
+        lua_pop(m_state, 1);
+        lua_settop(thread, 0);
+    }
+
+    if (on_finish)
+        on_finish(thread, errored);
+
+    // The thread is collected once nothing refers to it
+    luaL_unref(m_state, LUA_REGISTRYINDEX, thread_ref);
+}
+
+u64 Engine::check_waiting_task(StringView what)
+{
+    auto task_id = m_task_ids_by_thread.find(m_state);
+    if (task_id == m_task_ids_by_thread.end() || !lua_isyieldable(m_state))
+    {
+        luaL_error(m_state, "%s can only be used by a hook, outside of coroutines it creates",
+                   what.to_string().characters());
+    }
+
+    return task_id->value;
+}
+
+u64 Engine::add_wait_timer(u64 milliseconds, Function<void()> callback)
+{
+    auto timer_id = m_thread.add_timer(milliseconds, [this, callback = move(callback)](u64 timer_id) {
+        m_state = m_main_state;
+        m_wait_timer_ids.remove(timer_id);
+        callback();
+        return true;
+    });
+    m_wait_timer_ids.set(timer_id);
+    return timer_id;
+}
+
+void Engine::remove_wait_timer(u64 timer_id)
+{
+    m_wait_timer_ids.remove(timer_id);
+    m_thread.remove_timer(timer_id);
+}
+
+int Engine::sleep()
+{
+    auto milliseconds = luaL_checkinteger(m_state, 1);
+    luaL_argcheck(m_state, milliseconds >= 0, 1, "can't sleep for a negative time");
+    auto task_id = check_waiting_task("sleep");
+
+    add_wait_timer(milliseconds, [this, task_id] { resume_task(task_id, 0); });
+    return lua_yield(m_state, 0);
+}
+
+int Engine::backend_ping()
+{
+    auto timeout = luaL_optinteger(m_state, 1, 5000);
+    luaL_argcheck(m_state, timeout >= 0, 1, "can't time out after a negative time");
+    auto task_id = check_waiting_task("Backend.ping");
+
+    auto info = DestinationServer::Info::backend();
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(info.port());
+    address.sin_addr.s_addr = info.address().to_in_addr_t();
+
+    auto fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        lua_pushnil(m_state);
+        lua_pushstring(m_state, strerror(errno));
+        return 2;
+    }
+
+    auto started_at = Clock::monotonic_nanoseconds();
+    if (connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 && errno != EINPROGRESS)
+    {
+        close(fd);
+        lua_pushnil(m_state);
+        lua_pushstring(m_state, strerror(errno));
+        return 2;
+    }
+
+    auto timeout_timer_id = add_wait_timer(timeout, [this, fd] { finish_ping(fd, true); });
+    m_pending_pings.set(fd, {task_id, started_at, timeout_timer_id});
+    m_thread.watch_fd(fd, POLLOUT, [this, fd](short) {
+        m_state = m_main_state;
+        finish_ping(fd, false);
+    });
+
+    return lua_yield(m_state, 0);
+}
+
+void Engine::finish_ping(int fd, bool timed_out)
+{
+    auto ping = m_pending_pings.find(fd);
+    VERIFY(ping != m_pending_pings.end());
+    auto task_id = ping->value.task_id;
+    auto started_at = ping->value.started_at;
+
+    if (!timed_out)
+        remove_wait_timer(ping->value.timeout_timer_id);
+    m_pending_pings.remove(ping);
+
+    int error = 0;
+    socklen_t error_length = sizeof(error);
+    if (!timed_out)
+        getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &error_length);
+
+    m_thread.unwatch_fd(fd);
+    close(fd);
+
+    auto* thread = m_tasks.find(task_id)->value.thread;
+    if (timed_out)
+    {
+        lua_pushnil(thread);
+        lua_pushstring(thread, "timed out");
+    }
+    else if (error != 0)
+    {
+        lua_pushnil(thread);
+        lua_pushstring(thread, strerror(error));
+    }
+    else
+    {
+        lua_pushnumber(thread, (Clock::monotonic_nanoseconds() - started_at) / 1'000'000.0);
+        lua_pushnil(thread);
+    }
+
+    resume_task(task_id, 2);
+}
+
+int Engine::client_wait_for_packet()
+{
+    auto client_id = check_client(1);
+    auto packet_id = static_cast<i32>(luaL_checkinteger(m_state, 2));
+    auto task_id = check_waiting_task("waitForPacket");
+
+    PacketWait wait{client_id, packet_id, {}};
+    if (!lua_isnoneornil(m_state, 3))
+    {
+        auto timeout = luaL_checkinteger(m_state, 3);
+        luaL_argcheck(m_state, timeout >= 0, 3, "can't time out after a negative time");
+        wait.timeout_timer_id = add_wait_timer(timeout, [this, task_id] {
+            resume_packet_wait(task_id, {}, "timed out");
+        });
+    }
+    m_packet_waits.set(task_id, wait);
+
+    // The I/O thread only tells us about packets somebody is waiting for. The watch is in place before we yield, so
+    // the packet can't arrive before the I/O thread knows to look for it.
+    m_thread.packet_watches().add(client_id, packet_id);
+
+    return lua_yield(m_state, 0);
+}
+
+void Engine::client_did_send_packet(const Event& event)
+{
+    Vector<u64> waiting_task_ids;
+    for (auto& wait : m_packet_waits)
+    {
+        if (wait.value.client_id == event.client_id && wait.value.packet_id == event.packet_id)
+            waiting_task_ids.append(wait.key);
+    }
+
+    for (auto task_id : waiting_task_ids)
+        resume_packet_wait(task_id, event.message.bytes(), {});
+}
+
+void Engine::resume_packet_wait(u64 task_id, Optional<ReadonlyBytes> payload, StringView error)
+{
+    auto wait = m_packet_waits.find(task_id);
+    if (wait == m_packet_waits.end())
+        return;
+
+    if (wait->value.timeout_timer_id.has_value() && m_wait_timer_ids.contains(*wait->value.timeout_timer_id))
+        remove_wait_timer(*wait->value.timeout_timer_id);
+    // Whether it got its packet, timed out, or the client left, the I/O thread has no reason to post any more for it
+    m_thread.packet_watches().remove(wait->value.client_id, wait->value.packet_id);
+    m_packet_waits.remove(wait);
+
+    auto* thread = m_tasks.find(task_id)->value.thread;
+    if (payload.has_value())
+    {
+        lua_pushlstring(thread, reinterpret_cast<const char*>(payload->data()), payload->size());
+        lua_pushnil(thread);
+    }
+    else
+    {
+        lua_pushnil(thread);
+        lua_pushlstring(thread, error.characters_without_null_termination(), error.length());
+    }
+
+    resume_task(task_id, 2);
+}
+
+Engine::KnownClient& Engine::known_client(u32 client_id)
+{
+    auto client = m_known_clients.find(client_id);
+    if (client == m_known_clients.end())
+    {
+        m_known_clients.set(client_id, {});
+        client = m_known_clients.find(client_id);
+    }
+
+    return client->value;
+}
+
+void Engine::send_packet(Vector<u32> client_ids, const Minecraft::Net::Packet& packet, bool is_broadcast)
+{
+    Action action;
+    action.type = Action::Type::Send;
+    action.client_ids = move(client_ids);
+    action.packet_id = packet.id();
+    action.state_hash = packet.idempotent_state_hash();
+    action.is_broadcast = is_broadcast;
+
+    auto encode_start = Clock::monotonic_nanoseconds();
+    action.frame = Frame::encode_bytes(packet);
+    action.encode_nanoseconds = Clock::monotonic_nanoseconds() - encode_start;
+
+    m_thread.post_action(move(action));
+}
+
+void Engine::client_userdata(u32 client_id)
+{
+    auto& client = known_client(client_id);
+    if (client.userdata_ref.has_value())
+    {
+        lua_rawgeti(m_state, LUA_REGISTRYINDEX, *client.userdata_ref);
+        return;
+    }
+
+    auto client_ud = lua_newuserdata(m_state, sizeof(u32));
+    *reinterpret_cast<u32*>(client_ud) = client_id;
+    luaL_setmetatable(m_state, "Server::Client");
+
+    lua_pushvalue(m_state, -1);
+    client.userdata_ref = luaL_ref(m_state, LUA_REGISTRYINDEX);
+}
+
+u32 Engine::check_client(int index)
+{
+    auto client_id = *reinterpret_cast<u32*>(luaL_checkudata(m_state, index, "Server::Client"));
+    if (!m_known_clients.contains(client_id))
+        luaL_error(m_state, "client has disconnected");
+
+    return client_id;
+}
+
+void Engine::timer_userdata(u64 timer_id) const
+{
+    auto* timer_ud = lua_newuserdata(m_state, sizeof(u64));
+    *reinterpret_cast<u64*>(timer_ud) = timer_id;
+    luaL_setmetatable(m_state, "Engine::Timer");
+}
+
+bool Engine::call_timer(u64 timer_id)
+{
+    auto function_ref = m_timer_function_refs.find(timer_id);
+    if (function_ref == m_timer_function_refs.end())
+        return true;
+
+    lua_rawgeti(m_state, LUA_REGISTRYINDEX, function_ref->value);
+    call_and_log("timer", 0, 1);
+    auto is_done = lua_toboolean(m_state, -1);
+    lua_pop(m_state, 1);
+
+    if (!is_done)
+        return false;
+
+    // The function may have destroyed its own timer
+    function_ref = m_timer_function_refs.find(timer_id);
+    if (function_ref != m_timer_function_refs.end())
+    {
+        luaL_unref(m_state, LUA_REGISTRYINDEX, function_ref->value);
+        m_timer_function_refs.remove(function_ref);
+    }
+    return true;
 }
 
 int Engine::client_disconnect()
 {
-    auto client = reinterpret_cast<WeakPtr<Client>*>(luaL_checkudata(m_state, 1, "Server::Client"));
-    if (client)
-        client->ptr()->disconnect(Types::chat_component(m_state, 2));
+    auto client_id = check_client(1);
+
+    Minecraft::Net::Packets::Login::Clientbound::Disconnect disconnect;
+    disconnect.set_reason(Types::chat_component(m_state, 2));
+
+    Action action;
+    action.type = Action::Type::Disconnect;
+    action.client_ids.append(client_id);
+    action.frame = Frame::encode_bytes(disconnect);
+    m_thread.post_action(move(action));
 
     return 0;
 }
 
 int Engine::client_send_message()
 {
-    auto client = reinterpret_cast<WeakPtr<Client>*>(luaL_checkudata(m_state, 1, "Server::Client"));
-    if (client)
+    auto client_id = check_client(1);
+    auto message = Types::chat_component(m_state, 2);
+    auto position = luaL_optinteger(m_state, 3, 0);
+    // TODO: Sender UUID
+    Minecraft::Net::Packets::Play::Clientbound::ChatMessage chat_message;
+    chat_message.set_message(message);
+    chat_message.set_position(position);
+    send_packet({client_id}, chat_message);
+
+    return 0;
+}
+
+int Engine::client_set_player_list_header_and_footer()
+{
+    auto client_id = check_client(1);
+    RefPtr<Minecraft::Chat::Component> header;
+    RefPtr<Minecraft::Chat::Component> footer;
+
+    if (lua_isnil(m_state, 2))
+        header = create<Minecraft::Chat::TextComponent>("");
+    else
+        header = Types::chat_component(m_state, 2);
+
+    if (lua_isnil(m_state, 3))
+        footer = create<Minecraft::Chat::TextComponent>("");
+    else
+        footer = Types::chat_component(m_state, 3);
+
+    Minecraft::Net::Packets::Play::Clientbound::PlayerListHeaderAndFooter player_list_header_and_footer;
+    player_list_header_and_footer.set_header(header);
+    player_list_header_and_footer.set_footer(footer);
+    send_packet({client_id}, player_list_header_and_footer);
+
+    return 0;
+}
+
+Optional<Hook> Engine::hook_for_name(StringView name)
+{
+    if (name == "requestStatus")
+        return Hook::RequestStatus;
+    if (name == "requestLogin")
+        return Hook::RequestLogin;
+    return {};
+}
+
+void Engine::add_function(FunctionRefs& function_refs_by_name, StringView name)
+{
+    luaL_checktype(m_state, 2, LUA_TFUNCTION);
+
+    lua_pushvalue(m_state, 2);
+    auto function_ref = luaL_ref(m_state, LUA_REGISTRYINDEX);
+    auto function_refs = function_refs_by_name.find(name);
+    if (function_refs == function_refs_by_name.end())
     {
-        auto message = Types::chat_component(m_state, 2);
-        auto position = luaL_optinteger(m_state, 3, 0);
-        // TODO: Sender UUID
-        Minecraft::Net::Packets::Play::Clientbound::ChatMessage chat_message;
-        chat_message.set_message(message);
-        chat_message.set_position(position);
-        client->ptr()->send(chat_message);
+        function_refs_by_name.set(name, {});
+        function_refs = function_refs_by_name.find(name);
+    }
+    function_refs->value.append(function_ref);
+}
+
+bool Engine::remove_function(FunctionRefs& function_refs_by_name, StringView name)
+{
+    luaL_checktype(m_state, 2, LUA_TFUNCTION);
+
+    auto maybe_function_refs = function_refs_by_name.find(name);
+    if (maybe_function_refs == function_refs_by_name.end())
+        return false;
+
+    auto& function_refs = maybe_function_refs->value;
+    auto position = find_function(function_refs, 2);
+    if (!position.has_value())
+        return false;
+
+    luaL_unref(m_state, LUA_REGISTRYINDEX, function_refs[*position]);
+    function_refs.remove(*position);
+    return true;
+}
+
+Optional<size_t> Engine::find_function(const Vector<int>& function_refs, int index)
+{
+    index = lua_absindex(m_state, index);
+    for (size_t i = 0; i < function_refs.size(); i++)
+    {
+        lua_rawgeti(m_state, LUA_REGISTRYINDEX, function_refs[i]);
+        auto is_same_function = lua_rawequal(m_state, -1, index);
+        lua_pop(m_state, 1);
+
+        if (is_same_function)
+            return i;
+    }
+
+    return {};
+}
+
+int Engine::hooks_add()
+{
+    auto name = StringView(luaL_checkstring(m_state, 1));
+    add_function(m_hook_function_refs, name);
+
+    if (auto hook = hook_for_name(name); hook.has_value())
+    {
+        m_hook_subscriber_counts[static_cast<size_t>(*hook)]++;
+        m_shared_hook_subscriber_counts[static_cast<size_t>(*hook)]++;
     }
 
     return 0;
 }
 
-int Engine::client_set_player_list_header_and_footer()
+int Engine::hooks_remove()
+{
+    auto name = StringView(luaL_checkstring(m_state, 1));
+    if (!m_hook_function_refs.contains(name))
+        return luaL_error(m_state, "invalid hook %s", name.to_string().characters());
+
+    if (!remove_function(m_hook_function_refs, name))
+        return 0;
+
+    if (auto hook = hook_for_name(name); hook.has_value())
+    {
+        m_hook_subscriber_counts[static_cast<size_t>(*hook)]--;
+        m_shared_hook_subscriber_counts[static_cast<size_t>(*hook)]--;
+    }
+
+    return 0;
+}
+
+int Engine::hooks_functions()
 {
-    auto client = reinterpret_cast<WeakPtr<Client>*>(luaL_checkudata(m_state, 1, "Server::Client"));
-    if (client)
+    auto function_refs = m_hook_function_refs.find(luaL_checkstring(m_state, 1));
+    if (function_refs == m_hook_function_refs.end())
+    {
+        lua_createtable(m_state, 0, 0);
+        return 1;
+    }
+
+    // A copy, so that hooks may add or remove hooks while they are being published
+    lua_createtable(m_state, function_refs->value.size(), 0);
+    for (size_t i = 0; i < function_refs->value.size(); i++)
     {
-        RefPtr<Minecraft::Chat::Component> header;
-        RefPtr<Minecraft::Chat::Component> footer;
+        lua_rawgeti(m_state, LUA_REGISTRYINDEX, function_refs->value[i]);
+        lua_rawseti(m_state, -2, i + 1);
+    }
+    return 1;
+}
+
+int Engine::hooks_call()
+{
+    luaL_checkstring(m_state, 1);
+    luaL_checktype(m_state, 2, LUA_TFUNCTION);
+
+    // The name, the message handler, then the hook and its arguments
+    lua_pushcfunction(m_state, traceback_message_handler);
+    lua_insert(m_state, 2);
 
-        if(lua_isnil(m_state, 2))
-            header = create<Minecraft::Chat::TextComponent>("");
-        else
-            header = Types::chat_component(m_state, 2);
+    // The hook may resume other Lua threads of ours, which would leave m_state pointing at them
+    auto* state = m_state;
+    m_profiler->will_run_hook(m_state);
+    auto status = lua_pcallk(m_state, lua_gettop(m_state) - 3, 0, 2, 0,
+                             [](lua_State* resumed_state, int resumed_status, lua_KContext) {
+                                 auto& engine = from_upvalue(resumed_state);
+                                 engine.m_state = resumed_state;
+                                 return engine.hooks_did_call(resumed_status);
+                             });
+    m_state = state;
+    return hooks_did_call(status);
+}
 
-        if(lua_isnil(m_state, 3))
-            footer = create<Minecraft::Chat::TextComponent>("");
-        else
-            footer = Types::chat_component(m_state, 3);
+int Engine::hooks_did_call(int status)
+{
+    m_profiler->did_run_hook();
 
-        Minecraft::Net::Packets::Play::Clientbound::PlayerListHeaderAndFooter player_list_header_and_footer;
-        player_list_header_and_footer.set_header(header);
-        player_list_header_and_footer.set_footer(footer);
-        client->ptr()->send(player_list_header_and_footer);
+    // Resuming a hook that waited finishes it with LUA_YIELD
+    if (status != LUA_OK && status != LUA_YIELD)
+    {
+        auto name = StringView(lua_tostring(m_state, 1));
+        auto error = StringView(luaL_tolstring(m_state, -1, nullptr));
+        warnln("\u001b[31mPlugin {} failed in {}: {}\u001b[0m", m_plugin_name, name, error);
     }
 
     return 0;
 }
 
+int Engine::hooks_subscribers()
+{
+    auto function_refs = m_hook_function_refs.find(luaL_checkstring(m_state, 1));
+    lua_pushinteger(m_state, function_refs == m_hook_function_refs.end() ? 0 : function_refs->value.size());
+    return 1;
+}
+
+int Engine::clients_broadcast()
+{
+    auto packet = Types::clientbound_play_packet(m_state, 1);
+    auto has_filter = !lua_isnoneornil(m_state, 2);
+    if (has_filter)
+        luaL_checktype(m_state, 2, LUA_TFUNCTION);
+
+    // The filter sees the clients as we know them, which may be slightly behind the I/O thread. Any that have
+    // disconnected since are skipped when the frame is sent.
+    Vector<u32> client_ids;
+    for (auto& client : m_known_clients)
+    {
+        if (!client.value.is_connected_to_destination_server)
+            continue;
+
+        if (has_filter)
+        {
+            lua_pushvalue(m_state, 2);
+            client_userdata(client.key);
+            lua_call(m_state, 1, 1);
+            auto should_send = lua_toboolean(m_state, -1);
+            lua_pop(m_state, 1);
+            if (!should_send)
+                continue;
+        }
+
+        client_ids.append(client.key);
+    }
+
+    auto recipients = client_ids.size();
+    send_packet(move(client_ids), *packet, true);
+
+    lua_pushinteger(m_state, recipients);
+    return 1;
+}
+
+int Engine::clients_statistics()
+{
+    auto& statistics = m_server.broadcast_statistics();
+
+    lua_createtable(m_state, 0, 7);
+    lua_pushinteger(m_state, statistics.broadcasts.load());
+    lua_setfield(m_state, -2, "broadcasts");
+    lua_pushinteger(m_state, statistics.frames_sent.load());
+    lua_setfield(m_state, -2, "framesSent");
+    lua_pushinteger(m_state, statistics.bytes_sent.load());
+    lua_setfield(m_state, -2, "bytesSent");
+    lua_pushinteger(m_state, statistics.bytes_not_reencoded.load());
+    lua_setfield(m_state, -2, "bytesNotReencoded");
+    lua_pushnumber(m_state, statistics.nanoseconds_saved.load() / 1'000'000.0);
+    lua_setfield(m_state, -2, "millisecondsSaved");
+    lua_pushinteger(m_state, statistics.packets_suppressed.load());
+    lua_setfield(m_state, -2, "packetsSuppressed");
+    lua_pushinteger(m_state, statistics.bytes_suppressed.load());
+    lua_setfield(m_state, -2, "bytesSuppressed");
+
+    return 1;
+}
+
+static void push_queue_statistics(lua_State* state, const QueueStatistics& statistics)
+{
+    lua_createtable(state, 0, 3);
+    lua_pushinteger(state, statistics.depth());
+    lua_setfield(state, -2, "depth");
+    lua_pushnumber(state, statistics.average_latency_milliseconds());
+    lua_setfield(state, -2, "averageLatencyMilliseconds");
+    lua_pushnumber(state, statistics.max_latency_milliseconds());
+    lua_setfield(state, -2, "maxLatencyMilliseconds");
+}
+
+int Engine::scripting_statistics()
+{
+    lua_createtable(m_state, 0, 3);
+    push_queue_statistics(m_state, m_thread.event_statistics());
+    lua_setfield(m_state, -2, "events");
+    push_queue_statistics(m_state, m_thread.action_statistics());
+    lua_setfield(m_state, -2, "actions");
+
+    auto& gc = m_garbage_collection_statistics;
+    lua_createtable(m_state, 0, 7);
+    lua_pushinteger(m_state, heap_kilobytes());
+    lua_setfield(m_state, -2, "kilobytesInUse");
+    lua_pushinteger(m_state, m_live_kilobytes);
+    lua_setfield(m_state, -2, "liveKilobytes");
+    lua_pushinteger(m_state, gc.cycles);
+    lua_setfield(m_state, -2, "cycles");
+    lua_pushinteger(m_state, gc.idle_steps);
+    lua_setfield(m_state, -2, "idleSteps");
+    lua_pushinteger(m_state, gc.forced_steps);
+    lua_setfield(m_state, -2, "forcedSteps");
+    lua_pushnumber(m_state, gc.total_nanoseconds / 1'000'000.0);
+    lua_setfield(m_state, -2, "totalMilliseconds");
+    lua_pushnumber(m_state, gc.max_pause_nanoseconds / 1'000'000.0);
+    lua_setfield(m_state, -2, "maxPauseMilliseconds");
+    lua_setfield(m_state, -2, "gc");
+
+    return 1;
+}
+
+int Engine::scripting_reload()
+{
+    // Goes through the I/O thread, as the plugin may be on another thread. Reloading this plugin from one of its own
+    // hooks is fine, as the reload only happens once the hook has returned.
+    Action action;
+    action.type = Action::Type::ReloadPlugins;
+    action.plugin_name = String(luaL_optstring(m_state, 1, ""));
+    m_thread.post_action(move(action));
+
+    return 0;
+}
+
 void Engine::push_base_table() const { lua_rawgeti(m_state, LUA_REGISTRYINDEX, m_base_ref); }
 
 int Engine::timer_create()
 {
+    luaL_checktype(m_state, 1, LUA_TFUNCTION);
+    auto interval = luaL_checkinteger(m_state, 2);
+    luaL_argcheck(m_state, interval >= 0, 2, "can't run at a negative interval");
+
     // Push first function argument to the top of the stack as required by luaL_ref
     lua_pushvalue(m_state, 1);
     auto function_ref = luaL_ref(m_state, LUA_REGISTRYINDEX);
-    auto timer = Core::Timer::construct(luaL_checkinteger(m_state, 2), nullptr, nullptr);
-
-    timer->on_timeout = [this, function_ref, timer]() mutable {
-        lua_rawgeti(m_state, LUA_REGISTRYINDEX, function_ref);
-        lua_call(m_state, 0, 1);
-        if (lua_toboolean(m_state, -1))
-        {
-            luaL_unref(m_state, LUA_REGISTRYINDEX, function_ref);
-
-            timer->stop();
-            m_timers.remove_all_matching([timer](auto& other) { return timer.ptr() == other; });
-        }
-    };
 
-    m_timers.append(timer);
+    auto timer_id = m_thread.add_timer(interval, [this](u64 timer_id) {
+        m_state = m_main_state;
+        return call_timer(timer_id);
+    });
+    m_timer_function_refs.set(timer_id, function_ref);
 
-    timer_userdata(timer);
+    timer_userdata(timer_id);
 
     return 1;
 }
 
 int Engine::timer_destroy()
 {
-    auto timer = reinterpret_cast<WeakPtr<Core::Timer>*>(luaL_checkudata(m_state, 1, "Engine::Timer"));
-    if (timer)
-        m_timers.remove_all_matching([timer](auto& other) { return timer->ptr() == other; });
+    auto timer_id = *reinterpret_cast<u64*>(luaL_checkudata(m_state, 1, "Engine::Timer"));
+
+    auto function_ref = m_timer_function_refs.find(timer_id);
+    if (function_ref == m_timer_function_refs.end())
+        return 0;
+
+    luaL_unref(m_state, LUA_REGISTRYINDEX, function_ref->value);
+    m_timer_function_refs.remove(function_ref);
+    m_thread.remove_timer(timer_id);
 
     return 0;
 }
 
 int Engine::timer_invoke()
 {
-    auto timer = reinterpret_cast<WeakPtr<Core::Timer>*>(luaL_checkudata(m_state, 1, "Engine::Timer"));
-    if (timer)
-        timer->ptr()->on_timeout();
+    auto timer_id = *reinterpret_cast<u64*>(luaL_checkudata(m_state, 1, "Engine::Timer"));
+    if (m_timer_function_refs.contains(timer_id) && call_timer(timer_id))
+        m_thread.remove_timer(timer_id);
+
+    return 0;
+}
+
+int Engine::bus_publish()
+{
+    auto channel = StringView(luaL_checkstring(m_state, 1));
+    auto message = Bus::serialize(m_state, 2);
+    if (message.is_error())
+        return luaL_error(m_state, "%s", message.error().characters());
+
+    m_thread.bus().publish(channel, message.value(), m_plugin_index, m_plugin_name);
+    return 0;
+}
 
+int Engine::bus_subscribe()
+{
+    add_function(m_bus_function_refs, luaL_checkstring(m_state, 1));
+    return 0;
+}
+
+int Engine::bus_unsubscribe()
+{
+    remove_function(m_bus_function_refs, luaL_checkstring(m_state, 1));
+    return 0;
+}
+
+static void push_timing(lua_State* state, const Profiler::Timing& timing)
+{
+    lua_createtable(state, 0, 6);
+    lua_pushinteger(state, timing.calls);
+    lua_setfield(state, -2, "calls");
+    lua_pushinteger(state, timing.errors);
+    lua_setfield(state, -2, "errors");
+    lua_pushinteger(state, timing.budget_exceeded);
+    lua_setfield(state, -2, "budgetExceeded");
+    lua_pushnumber(state, timing.wall_nanoseconds / 1'000'000.0);
+    lua_setfield(state, -2, "wallMilliseconds");
+    lua_pushnumber(state, timing.cpu_nanoseconds / 1'000'000.0);
+    lua_setfield(state, -2, "cpuMilliseconds");
+    lua_pushnumber(state, timing.max_wall_nanoseconds / 1'000'000.0);
+    lua_setfield(state, -2, "maxWallMilliseconds");
+}
+
+int Engine::profiler_report()
+{
+    lua_createtable(m_state, 0, 2);
+
+    lua_createtable(m_state, 0, m_profiler->timings().size());
+    for (auto& timing : m_profiler->timings())
+    {
+        push_timing(m_state, timing.value);
+        lua_setfield(m_state, -2, timing.key.characters());
+    }
+    lua_setfield(m_state, -2, "calls");
+
+    push_timing(m_state, m_profiler->total());
+    lua_setfield(m_state, -2, "total");
+
+    return 1;
+}
+
+int Engine::profiler_dump()
+{
+    auto path = lua_isnoneornil(m_state, 1) ? default_folded_stacks_path() : String(luaL_checkstring(m_state, 1));
+    auto result = m_profiler->write_folded_stacks(path);
+    if (result.is_error())
+        return luaL_error(m_state, "%s", result.error().characters());
+
+    lua_pushlstring(m_state, path.characters(), path.length());
+    return 1;
+}
+
+int Engine::profiler_set_sampling()
+{
+    luaL_checktype(m_state, 1, LUA_TBOOLEAN);
+    m_profiler->set_sampling(lua_toboolean(m_state, 1));
+    return 0;
+}
+
+int Engine::profiler_set_instruction_budget()
+{
+    auto instructions = luaL_checkinteger(m_state, 1);
+    luaL_argcheck(m_state, instructions >= 0, 1, "the budget can't be negative");
+    m_profiler->set_instruction_budget(instructions);
+    return 0;
+}
+
+int Engine::profiler_reset()
+{
+    m_profiler->reset();
     return 0;
 }
 
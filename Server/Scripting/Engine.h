@@ -6,49 +6,239 @@
 
 #pragma once
 
+#include <AK/Array.h>
+#include <AK/Atomic.h>
 #include <AK/Badge.h>
 #include <AK/HashMap.h>
-#include <AK/RefCounted.h>
-#include <AK/WeakPtr.h>
-#include <LibCore/Timer.h>
-#include <LibMinecraft/Net/Packets/Login/Serverbound/LoginStart.h>
-#include <Server/Client.h>
+#include <AK/HashTable.h>
+#include <AK/NonnullOwnPtr.h>
+#include <AK/Result.h>
+#include <LibMinecraft/Net/Packet.h>
+#include <Server/Scripting/Format.h>
+#include <Server/Scripting/Profiler.h>
+#include <Server/Scripting/Thread.h>
 
 typedef struct lua_State lua_State;
+struct luaL_Reg;
 
+// The Engine is the first upvalue of every function we register, so we don't have to look it up. Hooks run as
+// coroutines, so the methods work on whichever Lua thread called them.
 #define DEFINE_LUA_METHOD(name)                                                                                        \
-    static int name##_thunk(lua_State* state) { return (*s_engines.get(state))->name(); }                              \
+    static int name##_thunk(lua_State* state)                                                                          \
+    {                                                                                                                  \
+        auto& engine = from_upvalue(state);                                                                            \
+        engine.m_state = state;                                                                                        \
+        return engine.name();                                                                                          \
+    }                                                                                                                  \
     int name();
 
 class Server;
 
 namespace Scripting
 {
+// One plugin, in a Lua state of its own, with Base loaded into it. Everything in here belongs to the plugin's Thread
+// once it has started.
 class Engine
 {
 public:
-    explicit Engine(Server&);
+    // The subscriber counts are shared with any Engine that replaces this one, and each adds its own subscriptions to
+    // them. Every Engine starts out knowing the clients its Thread knows about, however late it is loaded.
+    static Result<NonnullOwnPtr<Engine>, String> try_create(Thread&, const Server&, u32 plugin_index,
+                                                            String plugin_name, StringView path,
+                                                            HookSubscriberCounts&);
 
     ~Engine();
 
-    void client_did_request_status(Badge<Server>, Client&);
+    void handle_event(Badge<Thread>, Event&);
 
-    void client_did_request_login(Badge<Server>, Client&, Minecraft::Net::Packets::Login::Serverbound::LoginStart&);
+    u32 plugin_index() const { return m_plugin_index; }
+    const String& plugin_name() const { return m_plugin_name; }
+
+    // The hook scripts call by this name
+    static Optional<Hook> hook_for_name(StringView);
+
+    bool has_subscribers(Hook hook) const { return m_hook_subscriber_counts[static_cast<size_t>(hook)] != 0; }
+
+    // The Thread runs Lua's collector in small steps whenever it has nothing else to do, so that collecting doesn't
+    // land in the middle of a hook. Only if the heap keeps growing while the thread is busy is it collected between
+    // events as well. Lua's own collector is left running with a pause past both of those, so that a hook that
+    // allocates for a long time still has its garbage collected.
+    //
+    // Whether there is garbage worth collecting while idle, or a cycle that was started hasn't finished yet
+    bool has_garbage_to_collect() const;
+    // Whether the heap has grown so far past what was live after the last cycle that it can't wait for the thread to
+    // be idle
+    bool is_over_garbage_limit() const;
+    // Steps the collector until the budget is spent, or the cycle finishes
+    void collect_garbage(Badge<Thread>, u64 budget_nanoseconds, bool is_forced);
+
+    static constexpr u64 idle_garbage_collection_budget_nanoseconds = 1'000'000;
+    static constexpr u64 forced_garbage_collection_budget_nanoseconds = 200'000;
+    // How large Lua lets the heap grow, relative to what was live after its last cycle, before starting another. This
+    // is past the garbage limit, so the Thread gets there first unless it is stuck in a hook.
+    static constexpr int collector_pause_percent = 400;
 
 private:
-    static HashMap<lua_State*, Engine*> s_engines;
+    Engine(Thread&, const Server&, u32 plugin_index, String plugin_name, HookSubscriberCounts&);
+
+    static Engine& from_upvalue(lua_State*);
+
+    // Registers the functions with the Engine as their upvalue
+    void set_functions(const luaL_Reg*);
+
+    void client_did_request_status(u32 client_id, u64 request_id);
+
+    void client_did_request_login(u32 client_id, const String& username, u64 request_id);
+
+    void did_receive_bus_message(const Event&);
+
+    lua_State* m_main_state;
+    // The Lua thread we were last called from: the coroutine of a hook, or the main state. Anything we do that wasn't
+    // called from Lua has to go back to the main state first.
     lua_State* m_state;
-    Server& m_server;
-    Vector<NonnullRefPtr<Core::Timer>> m_timers;
+    Thread& m_thread;
+    const Server& m_server;
+    u32 m_plugin_index;
+    String m_plugin_name;
     int m_base_ref{};
 
-    void* client_userdata(Client&);
+    // What we know about the clients of the I/O thread, from the events it sent us
+    struct KnownClient
+    {
+        // Each client gets one userdata, which is kept alive by a registry reference until it disconnects
+        Optional<int> userdata_ref;
+        bool is_connected_to_destination_server{};
+    };
+    HashMap<u32, KnownClient> m_known_clients;
+
+    KnownClient& known_client(u32 client_id);
+
+    // Registry references to the functions of running timers, by their ID in the Thread
+    HashMap<u64, int> m_timer_function_refs;
+
+    // Registry references to the functions subscribed to each hook, and to each bus channel, in the order they were
+    // added
+    using FunctionRefs = HashMap<String, Vector<int>>;
+    FunctionRefs m_hook_function_refs;
+    FunctionRefs m_bus_function_refs;
+    Array<u32, static_cast<size_t>(Hook::__Count)> m_hook_subscriber_counts{};
+    HookSubscriberCounts& m_shared_hook_subscriber_counts;
+
+    // Takes the name and function from the first two arguments
+    void add_function(FunctionRefs&, StringView name);
+    // Returns false if the function wasn't subscribed
+    bool remove_function(FunctionRefs&, StringView name);
+    // Where the function at the index is in the references. References are reused once they have been released, so this
+    // compares the functions themselves.
+    Optional<size_t> find_function(const Vector<int>& function_refs, int index);
+
+    // Calls the function below the arguments at the top of the stack under the profiler, returning the error with a
+    // traceback if it fails. The results are always left on the stack, as nil if it failed.
+    Result<void, String> protected_call(StringView what, int argument_count, int result_count);
+    // The same, but logs the error
+    bool call_and_log(StringView what, int argument_count, int result_count);
+
+    OwnPtr<Profiler> m_profiler;
+
+    FormatCache m_format_cache;
+
+    struct GarbageCollectionStatistics
+    {
+        u64 idle_steps{};
+        u64 forced_steps{};
+        u64 cycles{};
+        u64 total_nanoseconds{};
+        // The longest the thread spent collecting in one go
+        u64 max_pause_nanoseconds{};
+    };
+    GarbageCollectionStatistics m_garbage_collection_statistics;
+    // What was left after the last cycle finished, which is what the thresholds are relative to
+    size_t m_live_kilobytes{};
+    bool m_is_collecting_garbage{};
+
+    size_t heap_kilobytes() const;
+
+    // Hooks run as tasks, each a coroutine, which can wait for things by yielding from native functions. The task is
+    // resumed when what it waits for happens, and never blocks the thread while it waits.
+    struct Task
+    {
+        lua_State* thread;
+        int thread_ref;
+        String what;
+        // How many hooks it was in the middle of when it last waited
+        size_t hook_depth{};
+        // Called with the results on the coroutine's stack, or none if it failed
+        Function<void(lua_State*, bool errored)> on_finish;
+    };
+    HashMap<u64, Task> m_tasks;
+    HashMap<lua_State*, u64> m_task_ids_by_thread;
+    u64 m_next_task_id{1};
+
+    // Starts the function below the arguments at the top of the main state as a task, and runs it until it first waits
+    // or finishes.
+    void start_task(StringView what, int argument_count, Function<void(lua_State*, bool errored)> on_finish = {});
+    // The values to resume it with have to be pushed onto the task's thread first
+    void resume_task(u64 task_id, int argument_count);
+    // Raises a Lua error if the running thread is not a task that can wait
+    u64 check_waiting_task(StringView what);
+
+    // Timers of tasks that are sleeping, or waiting with a timeout
+    HashTable<u64> m_wait_timer_ids;
+    u64 add_wait_timer(u64 milliseconds, Function<void()>);
+    void remove_wait_timer(u64 timer_id);
+
+    struct PendingPing
+    {
+        u64 task_id;
+        u64 started_at;
+        u64 timeout_timer_id;
+    };
+    // By the fd of the socket that is connecting
+    HashMap<int, PendingPing> m_pending_pings;
+    void finish_ping(int fd, bool timed_out);
+
+    // Status tasks that are still running. The client gets no answer at all until every plugin has given one, so a
+    // task that waits too long is answered for, with nothing to say, and its own answer is dropped if it ever comes.
+    static constexpr u64 status_response_deadline_milliseconds = 1000;
+    struct PendingStatusResponse
+    {
+        Action action;
+        Optional<u64> deadline_timer_id;
+    };
+    // By request ID
+    HashMap<u64, PendingStatusResponse> m_pending_status_responses;
+
+    struct PacketWait
+    {
+        u32 client_id;
+        i32 packet_id;
+        Optional<u64> timeout_timer_id;
+    };
+    // By the ID of the waiting task
+    HashMap<u64, PacketWait> m_packet_waits;
+    void client_did_send_packet(const Event&);
+    void resume_packet_wait(u64 task_id, Optional<ReadonlyBytes> payload, StringView error);
+
+    String default_folded_stacks_path() const;
+
+    // Encodes the packet here, and has the I/O thread send it
+    void send_packet(Vector<u32> client_ids, const Minecraft::Net::Packet&, bool is_broadcast = false);
 
-    void* timer_userdata(Core::Timer&) const;
+    void client_userdata(u32 client_id);
+
+    // Raises a Lua error if the client has disconnected
+    u32 check_client(int index);
+
+    void timer_userdata(u64 timer_id) const;
+
+    // Returns true once the timer is done, which unreferences its function
+    bool call_timer(u64 timer_id);
 
     ALWAYS_INLINE void push_base_table() const;
 
-    DEFINE_LUA_METHOD(at_panic);
+    // The panic function is called without upvalues, so it finds the Engine through the state's extra space instead.
+    static int at_panic_thunk(lua_State*);
+    int at_panic();
 
     DEFINE_LUA_METHOD(format);
 
@@ -59,6 +249,25 @@ private:
 
     DEFINE_LUA_METHOD(client_set_player_list_header_and_footer);
 
+    // Hooks
+    DEFINE_LUA_METHOD(hooks_add);
+
+    DEFINE_LUA_METHOD(hooks_remove);
+
+    DEFINE_LUA_METHOD(hooks_functions);
+
+    // Calls one hook under its own budget, and logs its error if it fails. It may wait, so it finishes in
+    // hooks_did_call, whether that is right away or once the hook is resumed.
+    DEFINE_LUA_METHOD(hooks_call);
+    int hooks_did_call(int status);
+
+    DEFINE_LUA_METHOD(hooks_subscribers);
+
+    // Clients
+    DEFINE_LUA_METHOD(clients_broadcast);
+
+    DEFINE_LUA_METHOD(clients_statistics);
+
     // Timer
     DEFINE_LUA_METHOD(timer_create);
 
@@ -66,6 +275,36 @@ private:
 
     DEFINE_LUA_METHOD(timer_invoke);
 
+    // Scripting
+    DEFINE_LUA_METHOD(scripting_statistics);
+
+    DEFINE_LUA_METHOD(scripting_reload);
+
+    // Waiting
+    DEFINE_LUA_METHOD(sleep);
+
+    DEFINE_LUA_METHOD(backend_ping);
+
+    DEFINE_LUA_METHOD(client_wait_for_packet);
+
+    // Profiler
+    DEFINE_LUA_METHOD(profiler_report);
+
+    DEFINE_LUA_METHOD(profiler_dump);
+
+    DEFINE_LUA_METHOD(profiler_set_sampling);
+
+    DEFINE_LUA_METHOD(profiler_set_instruction_budget);
+
+    DEFINE_LUA_METHOD(profiler_reset);
+
+    // Bus
+    DEFINE_LUA_METHOD(bus_publish);
+
+    DEFINE_LUA_METHOD(bus_subscribe);
+
+    DEFINE_LUA_METHOD(bus_unsubscribe);
+
     class UsingBaseTable
     {
         friend Engine;
@@ -13,81 +13,380 @@ static String nil_string = "nil";
 static String true_string = "true";
 static String false_string = "false";
 
+// Wider than anything a plugin formats, and narrow enough that a typo can't have us pad out gigabytes
+static constexpr size_t max_spec_number = 1024;
+
 namespace Scripting
 {
-String format(lua_State* state, int index)
+Result<NonnullOwnPtr<FormatCache::Template>, String> FormatCache::compile(const char* format_string, size_t length)
 {
-    auto format_string = luaL_checkstring(state, index);
-    Vector<u64, 16> values;
-    Vector<AK::TypeErasedParameter, 16> type_erased_parameters;
+    auto compiled = adopt_own(*new Template);
+    size_t next_argument = 0;
+
+    auto append_literal = [&](const char* literal, size_t literal_length) {
+        if (literal_length == 0)
+            return;
+
+        // Escaped braces split literals, so join the pieces back together
+        if (!compiled->segments.is_empty())
+        {
+            auto& last = compiled->segments.last();
+            if (last.literal && last.literal + last.literal_length == literal)
+            {
+                last.literal_length += literal_length;
+                return;
+            }
+        }
 
-    auto top = lua_gettop(state);
+        Segment segment;
+        segment.literal = literal;
+        segment.literal_length = literal_length;
+        compiled->segments.append(move(segment));
+    };
 
-    for (auto i = index + 1; i <= top; i++)
+    size_t literal_start = 0;
+    size_t i = 0;
+    while (i < length)
     {
-        auto type = lua_type(state, i);
-        AK::TypeErasedParameter param;
+        auto character = format_string[i];
 
-        auto append_string = [&values, &param](const char* value) {
-            auto value_index = values.size();
-            values.append(reinterpret_cast<u64>(value));
+        if (character == '}')
+        {
+            if (i + 1 >= length || format_string[i + 1] != '}')
+                return String("unmatched '}' in format string");
 
-            param.type = AK::TypeErasedParameter::Type::Custom;
-            param.value = reinterpret_cast<void*>(&values.at(value_index));
-            param.formatter = AK::__format_value<char*>;
-        };
+            append_literal(format_string + literal_start, i + 1 - literal_start);
+            i += 2;
+            literal_start = i;
+            continue;
+        }
 
-        switch (type)
+        if (character != '{')
         {
-            case LUA_TNUMBER:
-            {
-                auto value = lua_tonumber(state, i);
-                [[maybe_unused]] double whole_part;
-                auto fractional_part = modf(value, &whole_part);
-                auto value_index = values.size();
-                param.type = AK::TypeErasedParameter::Type::Custom;
-
-                if (fractional_part == 0)
-                {
-                    values.append(value);
-                    param.value = reinterpret_cast<void*>(&values.at(value_index));
-                    param.formatter = AK::__format_value<i64>;
-                }
-                else
-                {
-                    values.append(*reinterpret_cast<u64*>(&value));
-                    param.value = reinterpret_cast<void*>(&values.at(value_index));
-                    param.formatter = AK::__format_value<LUA_NUMBER>;
-                }
+            i++;
+            continue;
+        }
+
+        if (i + 1 < length && format_string[i + 1] == '{')
+        {
+            append_literal(format_string + literal_start, i + 1 - literal_start);
+            i += 2;
+            literal_start = i;
+            continue;
+        }
+
+        append_literal(format_string + literal_start, i - literal_start);
+
+        auto placeholder_end = i + 1;
+        while (placeholder_end < length && format_string[placeholder_end] != '}')
+            placeholder_end++;
+        if (placeholder_end >= length)
+            return String("unmatched '{' in format string");
+
+        // {}, {1}, {:spec} or {1:spec}
+        size_t cursor = i + 1;
+        Optional<size_t> explicit_argument;
+        while (cursor < placeholder_end && format_string[cursor] >= '0' && format_string[cursor] <= '9')
+        {
+            explicit_argument = explicit_argument.value_or(0) * 10 + (format_string[cursor] - '0');
+            cursor++;
+        }
+
+        if (cursor != placeholder_end && format_string[cursor] != ':')
+            return String("invalid placeholder in format string");
+
+        Segment segment;
+        segment.argument = explicit_argument.has_value() ? *explicit_argument : next_argument++;
+        if (cursor != placeholder_end)
+        {
+            auto spec = StringView(format_string + cursor, placeholder_end - cursor);
+            auto parsed_spec = parse_spec(spec.substring_view(1));
+            if (parsed_spec.is_error())
+                return parsed_spec.release_error();
+
+            segment.placeholder = String::formatted("{{{}}}", spec);
+            segment.spec = parsed_spec.release_value();
+        }
+
+        compiled->argument_count = max(compiled->argument_count, segment.argument + 1);
+        compiled->segments.append(move(segment));
+
+        i = placeholder_end + 1;
+        literal_start = i;
+    }
+
+    append_literal(format_string + literal_start, length - literal_start);
+    return compiled;
+}
+
+// Follows the grammar AK parses specs with, [[fill]align][sign][#][0][width][.precision][type], without the widths and
+// precisions that are taken from arguments
+Result<FormatCache::Spec, String> FormatCache::parse_spec(StringView spec)
+{
+    auto invalid = [&](StringView reason) { return String::formatted("invalid format spec '{}': {}", spec, reason); };
+
+    // AK counts braces to find the end of the placeholder, even in the fill
+    if (spec.contains('{'))
+        return invalid("'{' can't be used in a format spec");
+
+    auto is_align = [](char character) { return character == '<' || character == '^' || character == '>'; };
+
+    Spec parsed;
+    size_t i = 0;
+    if (spec.length() >= 2 && is_align(spec[1]))
+        i = 2;
+    else if (!spec.is_empty() && is_align(spec[0]))
+        i = 1;
+
+    if (i < spec.length() && (spec[i] == '-' || spec[i] == '+' || spec[i] == ' '))
+    {
+        parsed.has_number_flags = true;
+        i++;
+    }
+
+    if (i < spec.length() && spec[i] == '#')
+    {
+        parsed.has_alternative_form = true;
+        i++;
+    }
+
+    if (i < spec.length() && spec[i] == '0')
+    {
+        parsed.has_number_flags = true;
+        i++;
+    }
+
+    auto consume_number = [&]() -> Optional<size_t> {
+        if (i >= spec.length() || spec[i] < '0' || spec[i] > '9')
+            return {};
+
+        size_t number = 0;
+        while (i < spec.length() && spec[i] >= '0' && spec[i] <= '9')
+        {
+            number = number * 10 + (spec[i] - '0');
+            if (number > max_spec_number)
+                return number;
+            i++;
+        }
+        return number;
+    };
+
+    auto width = consume_number();
+    if (width.has_value() && *width > max_spec_number)
+        return invalid("the width is too large");
+
+    if (i < spec.length() && spec[i] == '.')
+    {
+        i++;
+        auto precision = consume_number();
+        if (!precision.has_value())
+            return invalid("expected a precision after '.'");
+        if (*precision > max_spec_number)
+            return invalid("the precision is too large");
+
+        parsed.has_precision = true;
+    }
+
+    if (i < spec.length() && StringView("bcdfosxX").contains(spec[i]))
+        parsed.type = spec[i++];
+
+    if (i != spec.length())
+        return invalid("unexpected characters");
+
+    auto is_integer_type = parsed.type != 0 && StringView("bcdoxX").contains(parsed.type);
+    if (is_integer_type && parsed.has_precision)
+        return invalid("only floats and strings have a precision");
+    if ((parsed.type == 'c' || parsed.type == 's') && (parsed.has_number_flags || parsed.has_alternative_form))
+        return invalid("only numbers have a sign, '#' or zero padding");
+    if (parsed.type == 'f' && parsed.has_alternative_form)
+        return invalid("floats have no alternative form");
+
+    return parsed;
+}
+
+void FormatCache::push_formatted(lua_State* state, int index)
+{
+    size_t length;
+    auto* format_string = luaL_checklstring(state, index, &length);
+    auto key = reinterpret_cast<FlatPtr>(format_string);
+
+    auto cached = m_templates.find(key);
+    if (cached == m_templates.end())
+    {
+        auto compiled = compile(format_string, length);
+        if (compiled.is_error())
+            luaL_error(state, "%s", compiled.error().characters());
+
+        if (m_templates.size() >= max_templates)
+        {
+            for (auto& entry : m_templates)
+                luaL_unref(state, LUA_REGISTRYINDEX, entry.value->string_ref);
+            m_templates.clear();
+        }
+
+        // Pin the string, so its address stays its own
+        lua_pushvalue(state, index);
+        compiled.value()->string_ref = luaL_ref(state, LUA_REGISTRYINDEX);
+
+        m_templates.set(key, compiled.release_value());
+        cached = m_templates.find(key);
+    }
+
+    auto& compiled = *cached->value;
+    auto argument_count = static_cast<size_t>(lua_gettop(state) - index);
+    if (compiled.argument_count > argument_count)
+    {
+        luaL_error(state, "format string refers to argument %d, but only %d were given",
+                   static_cast<int>(compiled.argument_count), static_cast<int>(argument_count));
+    }
 
+    m_builder.clear();
+    for (auto& segment : compiled.segments)
+    {
+        if (segment.literal)
+        {
+            m_builder.append(segment.literal, segment.literal_length);
+            continue;
+        }
+
+        auto argument_index = index + 1 + static_cast<int>(segment.argument);
+        if (segment.placeholder.is_null())
+            append_argument(state, argument_index);
+        else
+            append_argument_with_spec(state, argument_index, segment);
+    }
+
+    auto result = m_builder.string_view();
+    lua_pushlstring(state, result.characters_without_null_termination(), result.length());
+}
+
+void FormatCache::append_argument(lua_State* state, int index)
+{
+    switch (lua_type(state, index))
+    {
+        case LUA_TNUMBER:
+        {
+            if (lua_isinteger(state, index))
+            {
+                m_builder.appendff("{}", static_cast<i64>(lua_tointeger(state, index)));
                 break;
             }
-            case LUA_TBOOLEAN:
+
+            // Whole numbers are formatted without a fraction, as they are written in Lua
+            auto value = lua_tonumber(state, index);
+            [[maybe_unused]] double whole_part;
+            if (modf(value, &whole_part) == 0)
+                m_builder.appendff("{}", static_cast<i64>(value));
+            else
+                m_builder.appendff("{}", value);
+            break;
+        }
+        case LUA_TBOOLEAN:
+            m_builder.append(lua_toboolean(state, index) ? true_string : false_string);
+            break;
+        case LUA_TNIL:
+            m_builder.append(nil_string);
+            break;
+        case LUA_TSTRING:
+        {
+            size_t length;
+            auto* value = lua_tolstring(state, index, &length);
+            m_builder.append(value, length);
+            break;
+        }
+        default:
+        {
+            // Tables and the like, as tostring() has them, which leaves the string on the stack
+            size_t length;
+            auto* value = luaL_tolstring(state, index, &length);
+            m_builder.append(value, length);
+            lua_pop(state, 1);
+            break;
+        }
+    }
+}
+
+// Format specs are rare enough that AK parses them every time. The spec was checked when it was compiled, and what is
+// left to check is whether it suits the argument, as AK crashes on specs that don't.
+void FormatCache::append_argument_with_spec(lua_State* state, int index, const Segment& segment)
+{
+    auto& spec = segment.spec;
+
+    u64 value;
+    AK::TypeErasedParameter parameter;
+    parameter.type = AK::TypeErasedParameter::Type::Custom;
+    parameter.value = &value;
+
+    const char* string_value = nullptr;
+    auto type = lua_type(state, index);
+    if (type != LUA_TNUMBER &&
+        ((spec.type != 0 && spec.type != 's') || spec.has_number_flags || spec.has_alternative_form))
+    {
+        luaL_error(state, "format spec %s is for numbers, but argument %d is a %s", segment.placeholder.characters(),
+                   static_cast<int>(segment.argument + 1), lua_typename(state, type));
+    }
+
+    switch (type)
+    {
+        case LUA_TNUMBER:
+        {
+            if (spec.type == 's')
+            {
+                luaL_error(state, "format spec %s is for strings, but argument %d is a number",
+                           segment.placeholder.characters(), static_cast<int>(segment.argument + 1));
+            }
+
+            auto number = lua_tonumber(state, index);
+            [[maybe_unused]] double whole_part;
+            auto is_whole = lua_isinteger(state, index) || modf(number, &whole_part) == 0;
+            auto is_float_spec = spec.type == 'f' || spec.has_precision;
+            auto is_integer_spec = (spec.type != 0 && spec.type != 'f') || spec.has_alternative_form;
+            if (is_integer_spec && !is_whole)
             {
-                auto value = lua_toboolean(state, i);
-                append_string((value ? true_string : false_string).characters());
-                break;
+                luaL_error(state, "format spec %s is for integers, but argument %d is %f",
+                           segment.placeholder.characters(), static_cast<int>(segment.argument + 1), number);
             }
-            case LUA_TNIL:
+
+            if (lua_isinteger(state, index) && !is_float_spec)
             {
-                append_string(nil_string.characters());
-                break;
+                value = static_cast<u64>(lua_tointeger(state, index));
+                parameter.formatter = AK::__format_value<i64>;
             }
-            default:
-                dbgln("Unimplemented string formatter for Lua type {} (aka {})", type, lua_typename(state, type));
-            case LUA_TSTRING:
+            else if (is_whole && !is_float_spec)
             {
-                auto value = lua_tostring(state, i);
-                append_string(value);
-                break;
+                value = static_cast<u64>(static_cast<i64>(number));
+                parameter.formatter = AK::__format_value<i64>;
+            }
+            else
+            {
+                __builtin_memcpy(&value, &number, sizeof(number));
+                parameter.formatter = AK::__format_value<LUA_NUMBER>;
             }
+            break;
         }
-        type_erased_parameters.append(move(param));
+        case LUA_TBOOLEAN:
+            string_value = (lua_toboolean(state, index) ? true_string : false_string).characters();
+            break;
+        case LUA_TNIL:
+            string_value = nil_string.characters();
+            break;
+        default:
+            // Converted in place, or left on the stack, where it stays until we return
+            string_value = luaL_tolstring(state, index, nullptr);
+            break;
     }
 
-    AK::TypeErasedFormatParams params;
-    params.set_parameters(type_erased_parameters);
+    if (string_value)
+    {
+        value = reinterpret_cast<u64>(string_value);
+        parameter.formatter = AK::__format_value<char*>;
+    }
+
+    AK::TypeErasedFormatParams parameters;
+    parameters.set_parameters({&parameter, 1});
+    AK::vformat(m_builder, segment.placeholder, parameters);
 
-    return String::vformatted(format_string, params);
+    if (type != LUA_TNUMBER && type != LUA_TBOOLEAN && type != LUA_TNIL)
+        lua_pop(state, 1);
+}
 }
-}
\ No newline at end of file
@@ -6,14 +6,77 @@
 
 #pragma once
 
+#include <AK/HashMap.h>
+#include <AK/NonnullOwnPtr.h>
+#include <AK/Result.h>
 #include <AK/String.h>
-#include <AK/StringView.h>
+#include <AK/StringBuilder.h>
+#include <AK/Vector.h>
 
 typedef struct lua_State lua_State;
 
 namespace Scripting
 {
-String format(lua_State*, int index);
+// Formats Lua values with AK's format strings, for the global format(). Each format string is parsed once, into a
+// template that is cached by the address of the Lua string. A registry reference keeps the string alive, so the address
+// can't be reused by another string while it is in the cache. Templates are rendered into one reused builder, so
+// formatting doesn't allocate on the native side once that has grown large enough.
+//
+// One of these belongs to each Lua state.
+class FormatCache
+{
+public:
+    // Formats the arguments after the format string at the index, and pushes the result. Raises a Lua error if the
+    // format string is invalid, refers to arguments that weren't given, or has a spec that doesn't suit its argument.
+    void push_formatted(lua_State*, int index);
+
+    size_t size() const { return m_templates.size(); }
+
+private:
+    // What we need to know about a format spec to tell whether AK can format an argument with it, as AK crashes on a
+    // spec that doesn't suit the argument
+    struct Spec
+    {
+        // b, c, d, f, o, s, x or X, or 0 if it has none
+        char type{};
+        // A sign or zero padding, which only numbers have
+        bool has_number_flags{};
+        bool has_alternative_form{};
+        bool has_precision{};
+    };
+
+    struct Segment
+    {
+        // Literal text, which points into the format string
+        const char* literal{};
+        size_t literal_length{};
+
+        // Otherwise, an argument, counting from the one after the format string
+        size_t argument{};
+        // For arguments with a format spec, the placeholder on its own, which AK formats for us
+        String placeholder;
+        Spec spec;
+    };
+
+    struct Template
+    {
+        int string_ref;
+        Vector<Segment> segments;
+        // How many arguments it refers to
+        size_t argument_count{};
+    };
+
+    // Enough for every format string a plugin uses, so we only ever get here if a plugin builds them at runtime
+    static constexpr size_t max_templates = 1024;
+
+    static Result<NonnullOwnPtr<Template>, String> compile(const char* format_string, size_t length);
+    // Takes the spec without its colon
+    static Result<Spec, String> parse_spec(StringView);
+
+    void append_argument(lua_State*, int index);
+    void append_argument_with_spec(lua_State*, int index, const Segment&);
 
-String format(lua_State*, int index, const StringView&);
-}
\ No newline at end of file
+    HashMap<FlatPtr, NonnullOwnPtr<Template>> m_templates;
+    StringBuilder m_builder;
+};
+}
@@ -0,0 +1,436 @@
+/*
+ * Copyright (c) 2021, James Puleo <james@jame.xyz>
+ *
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#include <AK/JsonArray.h>
+#include <AK/JsonObject.h>
+#include <AK/LexicalPath.h>
+#include <AK/QuickSort.h>
+#include <LibCore/DirIterator.h>
+#include <LibCore/EventLoop.h>
+#include <LibCore/File.h>
+#include <LibMinecraft/Net/Packets/Status/Clientbound/Response.h>
+#include <Server/Clock.h>
+#include <Server/Scripting/BytecodeCache.h>
+#include <Server/Scripting/Engine.h>
+#include <Server/Scripting/Host.h>
+#include <Server/Scripting/Types.h>
+#include <Server/Server.h>
+#include <signal.h>
+#include <unistd.h>
+
+namespace Scripting
+{
+Host::Host(Server& server) : m_server(server)
+{
+    load_plugins();
+
+    for (auto& thread : m_threads)
+    {
+        auto notifier = Core::Notifier::construct(thread->action_notify_fd(), Core::Notifier::Event::Read);
+        notifier->on_ready_to_read = [this, &thread = *thread] { perform_actions(thread); };
+        m_action_notifiers.append(move(notifier));
+
+        thread->start();
+    }
+
+    // kill -USR1 has every plugin log its profile, and write out its sampled stacks
+    m_dump_profiles_signal_id = Core::EventLoop::register_signal(
+        SIGUSR1, [this](int) {
+            m_server.filters().print_report();
+            post_to_all_threads(Event::Type::DumpProfiles, 0);
+        });
+
+    // kill -HUP reloads every plugin, without touching any connection
+    m_reload_signal_id = Core::EventLoop::register_signal(SIGHUP, [this](int) { reload_plugins({}); });
+}
+
+Host::~Host()
+{
+    Core::EventLoop::unregister_signal(m_dump_profiles_signal_id);
+    Core::EventLoop::unregister_signal(m_reload_signal_id);
+
+    for (auto& thread : m_threads)
+        thread->stop();
+}
+
+void Host::load_plugins()
+{
+    constexpr StringView plugins_directory = "Plugins";
+
+    if (!Core::File::exists(plugins_directory) || !Core::File::is_directory(plugins_directory))
+    {
+        warnln("No plugins directory found, not loading any plugins.");
+        return;
+    }
+
+    struct PluginToLoad
+    {
+        String name;
+        String main_path;
+        String manifest_path;
+    };
+    Vector<PluginToLoad> plugins;
+
+    auto plugins_dir_iterator = Core::DirIterator(plugins_directory, Core::DirIterator::SkipDots);
+    while (plugins_dir_iterator.has_next())
+    {
+        auto entry = plugins_dir_iterator.next_full_path();
+        if (!Core::File::is_directory(entry))
+            continue;
+
+        auto entry_path = LexicalPath(entry);
+        auto plugin_main_path = entry_path.append("init.lua");
+        if (Core::File::exists(plugin_main_path.string()))
+        {
+            auto manifest_path = entry_path.append("plugin.json").string();
+            plugins.append({entry_path.basename().to_string(), plugin_main_path.string(), manifest_path});
+        }
+    }
+
+    if (plugins.is_empty())
+        return;
+
+    // Plugins are numbered in the order they are loaded, which decides whose status response wins, so make it the
+    // same every time
+    quick_sort(plugins, [](auto& a, auto& b) { return a.name < b.name; });
+
+    // Leave a core for the I/O thread, and don't start threads that would have nothing to do
+    auto processor_count = sysconf(_SC_NPROCESSORS_ONLN);
+    auto thread_count = clamp<size_t>(processor_count > 1 ? processor_count - 1 : 1, 1, plugins.size());
+
+    for (size_t i = 0; i < thread_count; i++)
+    {
+        m_threads.append(make<Thread>(m_server, m_bus, m_packet_watches));
+        m_bus.add_thread(*m_threads.last());
+    }
+
+    auto started_at = Clock::monotonic_nanoseconds();
+    size_t deferred_count = 0;
+
+    for (u32 plugin_index = 0; plugin_index < plugins.size(); plugin_index++)
+    {
+        auto& plugin = plugins[plugin_index];
+        auto& thread = *m_threads[plugin_index % thread_count];
+
+        auto deferred_hooks = read_deferred_hooks(plugin.manifest_path);
+        if (deferred_hooks.is_error())
+        {
+            warnln("\u001b[31mFailed to load plugin from path {}\u001b[0m", plugin.main_path);
+            warnln("\u001b[31m{}\u001b[0m", deferred_hooks.error());
+            continue;
+        }
+
+        if (deferred_hooks.value().has_value())
+        {
+            auto hooks = deferred_hooks.release_value().release_value();
+            thread.defer_plugin(plugin_index, plugin.name, plugin.main_path, move(hooks));
+            outln("\u001b[36mDeferred plugin {} until one of its hooks is published\u001b[0m", plugin.main_path);
+            deferred_count++;
+            continue;
+        }
+
+        auto plugin_started_at = Clock::monotonic_nanoseconds();
+        auto result = thread.load_plugin(plugin_index, plugin.name, plugin.main_path);
+        if (result.is_error())
+        {
+            warnln("\u001b[31mFailed to load plugin from path {}\u001b[0m", plugin.main_path);
+            warnln("\u001b[31m{}\u001b[0m", result.error());
+        }
+        else
+        {
+            outln("\u001b[36mLoaded plugin {} in {:.3f}ms\u001b[0m", plugin.main_path,
+                  (Clock::monotonic_nanoseconds() - plugin_started_at) / 1'000'000.0);
+        }
+    }
+
+    auto cache_statistics = BytecodeCache::statistics();
+    outln("\u001b[36mLoaded {} plugins in {:.3f}ms, deferred {}, with {} of {} chunks from the bytecode cache\u001b[0m",
+          plugins.size() - deferred_count, (Clock::monotonic_nanoseconds() - started_at) / 1'000'000.0, deferred_count,
+          cache_statistics.hits, cache_statistics.hits + cache_statistics.misses);
+
+    m_threads.remove_all_matching([this](auto& thread) {
+        if (thread->plugin_count() != 0)
+            return false;
+
+        m_bus.remove_thread(*thread);
+        return true;
+    });
+}
+
+// A plugin with a manifest that lists hooks is only loaded once one of them is published:
+//
+//     { "hooks": ["requestStatus"] }
+//
+// Without a manifest, or hooks in it, the plugin is loaded on start.
+Result<Optional<Vector<Hook>>, String> Host::read_deferred_hooks(const String& manifest_path)
+{
+    if (!Core::File::exists(manifest_path))
+        return Optional<Vector<Hook>> {};
+
+    auto file = Core::File::construct(manifest_path);
+    if (!file->open(Core::OpenMode::ReadOnly))
+        return String::formatted("Unable to open {}: {}", manifest_path, file->error_string());
+
+    auto json = JsonValue::from_string(file->read_all());
+    if (!json.has_value() || !json->is_object())
+        return String::formatted("{} is not a valid plugin manifest", manifest_path);
+
+    auto hook_names = json->as_object().get("hooks");
+    if (hook_names.is_null())
+        return Optional<Vector<Hook>> {};
+    if (!hook_names.is_array())
+        return String::formatted("The hooks in {} are not an array", manifest_path);
+
+    Vector<Hook> hooks;
+    Optional<String> error;
+    hook_names.as_array().for_each([&](auto& hook_name) {
+        auto hook = hook_name.is_string() ? Engine::hook_for_name(hook_name.as_string()) : Optional<Hook> {};
+        if (!hook.has_value())
+        {
+            // Only the hooks the server publishes itself can wake a plugin up
+            error = String::formatted("{} lists {}, which is not a hook a plugin can be loaded for", manifest_path,
+                                      hook_name.to_string());
+            return;
+        }
+        hooks.append(*hook);
+    });
+
+    if (error.has_value())
+        return error.release_value();
+
+    return Optional<Vector<Hook>>(move(hooks));
+}
+
+void Host::post_to_all_threads(Event::Type type, u32 client_id)
+{
+    for (auto& thread : m_threads)
+        thread->post_event({type, client_id});
+}
+
+void Host::reload_plugins(StringView plugin_name)
+{
+    // Each thread reloads its own plugins, so this thread goes on forwarding traffic while they do
+    for (auto& thread : m_threads)
+    {
+        Event event;
+        event.type = Event::Type::ReloadPlugins;
+        event.plugin_name = String(plugin_name);
+        thread->post_event(move(event));
+    }
+}
+
+void Host::send_default_status_response(Client& who)
+{
+    if (!m_default_status_response)
+    {
+        auto data = Minecraft::Net::Packets::Status::Clientbound::Response::Data(
+            create<Minecraft::Chat::TextComponent>("A Minecraft Server"));
+        Types::set_default_status_response_version(data);
+        m_default_status_response = Frame::encode(Minecraft::Net::Packets::Status::Clientbound::Response(data));
+    }
+
+    who.send(*m_default_status_response);
+}
+
+void Host::client_did_request_status(Badge<Server>, Client& who)
+{
+    auto request_id = m_next_status_request_id++;
+    size_t expected_responses = 0;
+
+    for (auto& thread : m_threads)
+    {
+        if (!thread->has_subscribers(Hook::RequestStatus))
+            continue;
+
+        Event event;
+        event.type = Event::Type::RequestStatus;
+        event.client_id = who.id();
+        event.request_id = request_id;
+        thread->post_event(move(event));
+
+        expected_responses += thread->plugin_count();
+    }
+
+    if (expected_responses == 0)
+    {
+        send_default_status_response(who);
+        return;
+    }
+
+    m_pending_status_requests.set(request_id, {who.id(), expected_responses, {}, {}});
+}
+
+void Host::client_did_request_login(Badge<Server>, Client& who,
+                                    Minecraft::Net::Packets::Login::Serverbound::LoginStart& packet)
+{
+    auto request_id = m_next_login_request_id++;
+    size_t expected_responses = 0;
+
+    for (auto& thread : m_threads)
+    {
+        if (!thread->has_subscribers(Hook::RequestLogin))
+            continue;
+
+        Event event;
+        event.type = Event::Type::RequestLogin;
+        event.client_id = who.id();
+        event.username = String(packet.username().view());
+        event.request_id = request_id;
+        thread->post_event(move(event));
+
+        expected_responses += thread->plugin_count();
+    }
+
+    if (expected_responses == 0)
+    {
+        who.connect_to_destination_server({});
+        return;
+    }
+
+    m_pending_login_requests.set(request_id, {who.id(), expected_responses});
+}
+
+void Host::client_did_connect_to_destination_server(Badge<Server>, Client& who)
+{
+    post_to_all_threads(Event::Type::ClientConnectedToDestinationServer, who.id());
+}
+
+void Host::client_did_disconnect(Badge<Server>, Client& who)
+{
+    m_packet_watches.remove_client(who.id());
+    post_to_all_threads(Event::Type::ClientDisconnected, who.id());
+}
+
+void Host::client_did_receive_packet(Badge<Server>, Client& who, i32 packet_id, ReadonlyBytes bytes)
+{
+    if (!m_packet_watches.is_watching(who.id(), packet_id))
+        return;
+
+    for (auto& thread : m_threads)
+    {
+        Event event;
+        event.type = Event::Type::ClientSentPacket;
+        event.client_id = who.id();
+        event.packet_id = packet_id;
+        event.message = ByteBuffer::copy(bytes);
+        thread->post_event(move(event));
+    }
+}
+
+void Host::perform_actions(Thread& thread)
+{
+    u64 wakeups;
+    [[maybe_unused]] auto rc = read(thread.action_notify_fd(), &wakeups, sizeof(wakeups));
+
+    while (true)
+    {
+        auto action = thread.pop_action();
+        if (!action.has_value())
+            break;
+
+        perform(*action);
+    }
+}
+
+void Host::did_receive_status_response(Action& action)
+{
+    auto pending_request = m_pending_status_requests.find(action.request_id);
+    VERIFY(pending_request != m_pending_status_requests.end());
+
+    auto& request = pending_request->value;
+    if (!action.frame.is_empty() && (!request.plugin_index.has_value() || action.plugin_index > *request.plugin_index))
+    {
+        request.plugin_index = action.plugin_index;
+        request.frame = move(action.frame);
+    }
+
+    if (--request.remaining_responses != 0)
+        return;
+
+    if (auto* client = m_server.client_for_id(request.client_id))
+    {
+        if (request.frame.is_empty())
+            send_default_status_response(*client);
+        else
+            client->send_encoded(request.frame.bytes());
+    }
+
+    m_pending_status_requests.remove(pending_request);
+}
+
+void Host::did_receive_login_response(Action& action)
+{
+    auto pending_request = m_pending_login_requests.find(action.request_id);
+    VERIFY(pending_request != m_pending_login_requests.end());
+
+    if (--pending_request->value.remaining_responses != 0)
+        return;
+
+    auto client_id = pending_request->value.client_id;
+    m_pending_login_requests.remove(pending_request);
+
+    // Either a plugin disconnected the client, or it went away by itself
+    auto* client = m_server.client_for_id(client_id);
+    if (!client)
+        return;
+
+    client->connect_to_destination_server({});
+}
+
+void Host::perform(Action& action)
+{
+    if (action.type == Action::Type::StatusResponse)
+    {
+        did_receive_status_response(action);
+        return;
+    }
+
+    if (action.type == Action::Type::LoginResponse)
+    {
+        did_receive_login_response(action);
+        return;
+    }
+
+    if (action.type == Action::Type::ReloadPlugins)
+    {
+        reload_plugins(action.plugin_name);
+        return;
+    }
+
+    if (action.type == Action::Type::Disconnect)
+    {
+        for (auto client_id : action.client_ids)
+        {
+            if (auto* client = m_server.client_for_id(client_id))
+                client->disconnect(action.frame.bytes());
+        }
+        return;
+    }
+
+    size_t recipients = 0;
+
+    for (auto client_id : action.client_ids)
+    {
+        auto* client = m_server.client_for_id(client_id);
+        // The client may have gone away while the action was queued
+        if (!client)
+            continue;
+
+        if (action.state_hash.has_value())
+        {
+            if (client->suppress_if_unchanged(action.packet_id, *action.state_hash))
+                continue;
+            client->remember_sent_state(action.packet_id, *action.state_hash, action.frame.size());
+        }
+
+        client->send_encoded(action.frame.bytes());
+        recipients++;
+    }
+
+    if (action.is_broadcast)
+        m_server.did_broadcast({}, recipients, action.frame.size(), action.encode_nanoseconds);
+}
+}
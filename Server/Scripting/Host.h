@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2021, James Puleo <james@jame.xyz>
+ *
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#pragma once
+
+#include <AK/Badge.h>
+#include <AK/HashMap.h>
+#include <AK/HashTable.h>
+#include <AK/NonnullOwnPtr.h>
+#include <AK/NonnullRefPtrVector.h>
+#include <LibCore/Notifier.h>
+#include <LibMinecraft/Net/Packets/Login/Serverbound/LoginStart.h>
+#include <Server/Client.h>
+#include <Server/Frame.h>
+#include <Server/Scripting/Bus.h>
+#include <Server/Scripting/PacketWatches.h>
+#include <Server/Scripting/Thread.h>
+
+class Server;
+
+namespace Scripting
+{
+// The I/O thread's side of scripting. Every plugin is loaded into a Lua state of its own, and the plugins are spread
+// over a few scripting Threads. Events are posted to those threads instead of running Lua here, and the actions scripts
+// take are carried out when a thread wakes us up for them.
+class Host
+{
+public:
+    explicit Host(Server&);
+
+    ~Host();
+
+    void client_did_request_status(Badge<Server>, Client&);
+
+    void client_did_request_login(Badge<Server>, Client&, Minecraft::Net::Packets::Login::Serverbound::LoginStart&);
+
+    void client_did_connect_to_destination_server(Badge<Server>, Client&);
+
+    void client_did_disconnect(Badge<Server>, Client&);
+
+    void client_did_receive_packet(Badge<Server>, Client&, i32 packet_id, ReadonlyBytes);
+
+    bool is_watching_packets(u32 client_id) const { return m_packet_watches.is_watching(client_id); }
+
+private:
+    void load_plugins();
+    // The hooks a plugin's manifest says it serves, if it should be loaded once one of them is published
+    static Result<Optional<Vector<Hook>>, String> read_deferred_hooks(const String& manifest_path);
+
+    void post_to_all_threads(Event::Type, u32 client_id);
+
+    // Every plugin if the name is empty
+    void reload_plugins(StringView plugin_name);
+
+    void perform_actions(Thread&);
+    void perform(Action&);
+    void did_receive_status_response(Action&);
+    void did_receive_login_response(Action&);
+
+    Server& m_server;
+    Bus m_bus;
+    PacketWatches m_packet_watches;
+    Vector<NonnullOwnPtr<Thread>> m_threads;
+    NonnullRefPtrVector<Core::Notifier> m_action_notifiers;
+    int m_dump_profiles_signal_id{};
+    int m_reload_signal_id{};
+
+    // Every plugin on the threads a status request went to answers it. Once they all have, the answer from the plugin
+    // that was loaded last wins, just as it would if they all shared one state.
+    struct PendingStatusRequest
+    {
+        u32 client_id;
+        size_t remaining_responses;
+        Optional<u32> plugin_index;
+        ByteBuffer frame;
+    };
+    HashMap<u64, PendingStatusRequest> m_pending_status_requests;
+    u64 m_next_status_request_id{1};
+
+    // Clients are held at login until every plugin on the threads the request went to has answered, so that any of them
+    // can turn the client away
+    struct PendingLoginRequest
+    {
+        u32 client_id;
+        size_t remaining_responses;
+    };
+    HashMap<u64, PendingLoginRequest> m_pending_login_requests;
+    u64 m_next_login_request_id{1};
+
+    // Sent when no plugin answers a status request, encoded once
+    RefPtr<Frame> m_default_status_response;
+    void send_default_status_response(Client&);
+};
+}
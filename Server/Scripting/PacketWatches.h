@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2021, James Puleo <james@jame.xyz>
+ *
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#pragma once
+
+#include <AK/Atomic.h>
+#include <AK/HashMap.h>
+#include <AK/Noncopyable.h>
+#include <pthread.h>
+
+namespace Scripting
+{
+// The packets scripts are waiting for each client to send. Scripts add their watches straight from their own thread,
+// before they start waiting, so a packet that arrives right after can't slip past while an action to watch for it is
+// still queued. Each wait counts as one watch, which is removed once the wait is over, however it ended. The I/O thread
+// posts every watched packet to every thread until then.
+class PacketWatches
+{
+    AK_MAKE_NONCOPYABLE(PacketWatches);
+    AK_MAKE_NONMOVABLE(PacketWatches);
+
+public:
+    PacketWatches() { pthread_mutex_init(&m_mutex, nullptr); }
+    ~PacketWatches() { pthread_mutex_destroy(&m_mutex); }
+
+    void add(u32 client_id, i32 packet_id)
+    {
+        pthread_mutex_lock(&m_mutex);
+        auto watches = m_watches.find(client_id);
+        if (watches == m_watches.end())
+        {
+            m_watches.set(client_id, {});
+            watches = m_watches.find(client_id);
+        }
+        auto waits = watches->value.get(packet_id).value_or(0);
+        watches->value.set(packet_id, waits + 1);
+        m_watched_client_count.store(m_watches.size(), AK::MemoryOrder::memory_order_release);
+        pthread_mutex_unlock(&m_mutex);
+    }
+
+    // This is asked about every packet the client sends once it is handed off, so it doesn't lock while nobody is
+    // waiting for anything
+    bool is_watching(u32 client_id) const
+    {
+        if (m_watched_client_count.load(AK::MemoryOrder::memory_order_acquire) == 0)
+            return false;
+
+        pthread_mutex_lock(&m_mutex);
+        auto is_watching = m_watches.contains(client_id);
+        pthread_mutex_unlock(&m_mutex);
+        return is_watching;
+    }
+
+    bool is_watching(u32 client_id, i32 packet_id) const
+    {
+        if (m_watched_client_count.load(AK::MemoryOrder::memory_order_acquire) == 0)
+            return false;
+
+        pthread_mutex_lock(&m_mutex);
+        auto watches = m_watches.find(client_id);
+        auto is_watching = watches != m_watches.end() && watches->value.contains(packet_id);
+        pthread_mutex_unlock(&m_mutex);
+        return is_watching;
+    }
+
+    // Takes out one wait's watch. Waits for a client that has been removed have nothing left to take out.
+    void remove(u32 client_id, i32 packet_id)
+    {
+        pthread_mutex_lock(&m_mutex);
+        auto watches = m_watches.find(client_id);
+        if (watches != m_watches.end())
+        {
+            auto waits = watches->value.find(packet_id);
+            if (waits != watches->value.end() && --waits->value == 0)
+                watches->value.remove(waits);
+            if (watches->value.is_empty())
+                m_watches.remove(watches);
+        }
+        m_watched_client_count.store(m_watches.size(), AK::MemoryOrder::memory_order_release);
+        pthread_mutex_unlock(&m_mutex);
+    }
+
+    void remove_client(u32 client_id)
+    {
+        pthread_mutex_lock(&m_mutex);
+        m_watches.remove(client_id);
+        m_watched_client_count.store(m_watches.size(), AK::MemoryOrder::memory_order_release);
+        pthread_mutex_unlock(&m_mutex);
+    }
+
+private:
+    mutable pthread_mutex_t m_mutex;
+    // Clients to how many waits there are for each of their packets
+    HashMap<u32, HashMap<i32, u32>> m_watches;
+    Atomic<size_t> m_watched_client_count{0};
+};
+}
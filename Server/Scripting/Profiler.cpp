@@ -0,0 +1,229 @@
+/*
+ * Copyright (c) 2021, James Puleo <james@jame.xyz>
+ *
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#include <AK/StringBuilder.h>
+#include <LibCore/File.h>
+#include <Server/Clock.h>
+#include <Server/Scripting/Lua.h>
+#include <Server/Scripting/Profiler.h>
+
+namespace Scripting
+{
+// The address of this is the registry key the Profiler is kept under, for the count hook to find it
+static const char s_registry_key = 0;
+
+Profiler::Profiler(lua_State* state, String plugin_name) : m_state(state), m_plugin_name(move(plugin_name))
+{
+    lua_pushlightuserdata(m_state, this);
+    lua_rawsetp(m_state, LUA_REGISTRYINDEX, &s_registry_key);
+
+    // Coroutines inherit this from the state they were created from
+    lua_sethook(m_state, count_hook, LUA_MASKCOUNT, instructions_per_check);
+}
+
+void Profiler::count_hook(lua_State* state, lua_Debug*)
+{
+    lua_rawgetp(state, LUA_REGISTRYINDEX, &s_registry_key);
+    auto* profiler = reinterpret_cast<Profiler*>(lua_touserdata(state, -1));
+    lua_pop(state, 1);
+
+    profiler->did_run_instructions(state);
+}
+
+void Profiler::did_run_instructions(lua_State* state)
+{
+    if (m_call_depth == 0)
+        return;
+
+    if (m_is_over_budget)
+    {
+        luaL_error(state, "%s ran for more than its budget of %I instructions", m_current_call.characters(),
+                   static_cast<lua_Integer>(m_instruction_budget));
+    }
+
+    // Threads that were left checking every instruction by a call that ran over go back to normal
+    auto instructions = lua_gethookcount(state);
+    if (instructions != instructions_per_check)
+        lua_sethook(state, count_hook, LUA_MASKCOUNT, instructions_per_check);
+    m_call_instructions += instructions;
+
+    if (m_is_sampling)
+        sample(state);
+
+    if (m_instruction_budget != 0 && m_call_instructions > m_instruction_budget)
+    {
+        m_did_exceed_budget = true;
+        start_enforcing_budget(state);
+        luaL_error(state, "%s ran for more than its budget of %I instructions", m_current_call.characters(),
+                   static_cast<lua_Integer>(m_instruction_budget));
+    }
+}
+
+void Profiler::start_enforcing_budget(lua_State* state)
+{
+    m_is_over_budget = true;
+
+    // The thread that ran over may be a coroutine, which only hands the error back to whoever resumed it
+    lua_sethook(state, count_hook, LUA_MASKCOUNT, 1);
+    auto* unwinding_state = m_hook_state ? m_hook_state : m_call_state;
+    if (unwinding_state && unwinding_state != state)
+        lua_sethook(unwinding_state, count_hook, LUA_MASKCOUNT, 1);
+}
+
+void Profiler::stop_enforcing_budget()
+{
+    if (!m_is_over_budget)
+        return;
+
+    m_is_over_budget = false;
+    auto* unwinding_state = m_hook_state ? m_hook_state : m_call_state;
+    if (unwinding_state)
+        lua_sethook(unwinding_state, count_hook, LUA_MASKCOUNT, instructions_per_check);
+}
+
+void Profiler::sample(lua_State* state)
+{
+    // Walk from the innermost frame out, then fold the stack outermost first, rooted at the plugin and the call
+    Vector<String, 32> frames;
+    lua_Debug activation_record;
+    for (int level = 0; lua_getstack(state, level, &activation_record); level++)
+    {
+        lua_getinfo(state, "Sn", &activation_record);
+
+        auto name = activation_record.name ? activation_record.name : "?";
+        // Semicolons separate frames
+        frames.append(String::formatted("{} ({}:{})", name, StringView(activation_record.short_src),
+                                        activation_record.linedefined)
+                          .replace(";", ":", true));
+    }
+
+    StringBuilder builder;
+    builder.append(m_plugin_name);
+    builder.append(';');
+    builder.append(m_current_call);
+    for (size_t i = frames.size(); i > 0; i--)
+    {
+        builder.append(';');
+        builder.append(frames[i - 1]);
+    }
+
+    auto stack = builder.build();
+    auto count = m_samples.find(stack);
+    if (count == m_samples.end())
+        m_samples.set(stack, 1);
+    else
+        count->value++;
+}
+
+void Profiler::will_call(lua_State* state, StringView what, size_t hook_depth)
+{
+    if (m_call_depth++ != 0)
+        return;
+
+    m_current_call = what.to_string();
+    m_call_instructions = 0;
+    m_did_exceed_budget = false;
+    m_is_over_budget = false;
+    m_call_state = state;
+    m_hook_depth = hook_depth;
+    m_hook_state = hook_depth != 0 ? state : nullptr;
+    m_instructions_outside_hook = 0;
+    m_call_cpu_started_at = Clock::thread_cpu_nanoseconds();
+    m_call_started_at = Clock::monotonic_nanoseconds();
+}
+
+void Profiler::did_call(bool errored)
+{
+    VERIFY(m_call_depth != 0);
+    if (--m_call_depth != 0)
+        return;
+
+    stop_enforcing_budget();
+    m_call_state = nullptr;
+    m_hook_state = nullptr;
+
+    auto wall_nanoseconds = Clock::monotonic_nanoseconds() - m_call_started_at;
+    auto cpu_nanoseconds = Clock::thread_cpu_nanoseconds() - m_call_cpu_started_at;
+
+    auto record = [&](Timing& timing) {
+        timing.calls++;
+        timing.errors += errored;
+        timing.budget_exceeded += m_did_exceed_budget;
+        timing.wall_nanoseconds += wall_nanoseconds;
+        timing.cpu_nanoseconds += cpu_nanoseconds;
+        timing.max_wall_nanoseconds = max(timing.max_wall_nanoseconds, wall_nanoseconds);
+    };
+
+    auto timing = m_timings.find(m_current_call);
+    if (timing == m_timings.end())
+    {
+        m_timings.set(m_current_call, {});
+        timing = m_timings.find(m_current_call);
+    }
+
+    record(timing->value);
+    record(m_total);
+}
+
+void Profiler::will_run_hook(lua_State* state)
+{
+    if (m_call_depth == 0 || m_hook_depth++ != 0)
+        return;
+
+    m_instructions_outside_hook = m_call_instructions;
+    m_call_instructions = 0;
+    m_hook_state = state;
+}
+
+void Profiler::did_run_hook()
+{
+    if (m_call_depth == 0 || m_hook_depth == 0 || --m_hook_depth != 0)
+        return;
+
+    stop_enforcing_budget();
+    m_hook_state = nullptr;
+    // What runs around the hooks, such as the publish itself, carries on with its own count
+    m_call_instructions = m_instructions_outside_hook;
+}
+
+Result<void, String> Profiler::write_folded_stacks(const String& path) const
+{
+    StringBuilder builder;
+    for (auto& sample : m_samples)
+        builder.appendff("{} {}\n", sample.key, sample.value);
+
+    auto file = Core::File::construct(path);
+    if (!file->open(Core::OpenMode::WriteOnly | Core::OpenMode::Truncate))
+        return String::formatted("Unable to open {}: {}", path, file->error_string());
+
+    auto folded_stacks = builder.string_view();
+    if (!file->write(folded_stacks))
+        return String::formatted("Unable to write {}: {}", path, file->error_string());
+
+    return {};
+}
+
+void Profiler::reset()
+{
+    m_timings.clear();
+    m_total = {};
+    m_samples.clear();
+}
+
+void Profiler::print_report() const
+{
+    auto print_timing = [&](StringView what, const Timing& timing) {
+        outln("{:>24} {:>8} calls {:>10.3f}ms wall {:>10.3f}ms cpu {:>10.3f}ms max {:>4} errors {:>4} over budget",
+              what, timing.calls, timing.wall_nanoseconds / 1'000'000.0, timing.cpu_nanoseconds / 1'000'000.0,
+              timing.max_wall_nanoseconds / 1'000'000.0, timing.errors, timing.budget_exceeded);
+    };
+
+    outln("\u001b[36mProfile of plugin {}\u001b[0m", m_plugin_name);
+    for (auto& timing : m_timings)
+        print_timing(timing.key, timing.value);
+    print_timing("total", m_total);
+}
+}
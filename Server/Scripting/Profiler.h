@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2021, James Puleo <james@jame.xyz>
+ *
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#pragma once
+
+#include <AK/HashMap.h>
+#include <AK/Result.h>
+#include <AK/String.h>
+
+typedef struct lua_State lua_State;
+struct lua_Debug;
+
+namespace Scripting
+{
+// Keeps track of where one plugin spends its time. Every call the server makes into the plugin is timed, and attributed
+// to what it was made for (a hook, a timer, a bus channel). A count hook on the Lua state enforces an instruction
+// budget on each of those calls and each hook they run, and when sampling is turned on, records the Lua stack every
+// time it fires.
+class Profiler
+{
+public:
+    // How many instructions run between each time the count hook fires
+    static constexpr int instructions_per_check = 1000;
+
+    // Enough for several seconds of Lua, which no handler should ever need
+    static constexpr u64 default_instruction_budget = 100'000'000;
+
+    Profiler(lua_State*, String plugin_name);
+
+    struct Timing
+    {
+        u64 calls{};
+        u64 errors{};
+        u64 budget_exceeded{};
+        u64 wall_nanoseconds{};
+        u64 cpu_nanoseconds{};
+        u64 max_wall_nanoseconds{};
+    };
+
+    // Calls into the plugin may nest, such as a timer invoked from a hook. Only the outermost one is timed and counted
+    // against the budget. A task resumed in the middle of a hook is still in it, so it says how deep.
+    void will_call(lua_State*, StringView what, size_t hook_depth = 0);
+    void did_call(bool errored);
+
+    // Each hook a publish calls gets a budget of its own, so one that runs away doesn't take the hooks after it down
+    // with it. Hooks published from within a hook count against that hook's budget.
+    void will_run_hook(lua_State*);
+    void did_run_hook();
+    size_t hook_depth() const { return m_hook_depth; }
+
+    // Whether the last call was aborted for running past its budget
+    bool did_exceed_budget() const { return m_did_exceed_budget; }
+
+    u64 instruction_budget() const { return m_instruction_budget; }
+    // 0 turns the budget off
+    void set_instruction_budget(u64 instructions) { m_instruction_budget = instructions; }
+
+    bool is_sampling() const { return m_is_sampling; }
+    void set_sampling(bool is_sampling) { m_is_sampling = is_sampling; }
+
+    const HashMap<String, Timing>& timings() const { return m_timings; }
+    const Timing& total() const { return m_total; }
+
+    // Writes the samples in the folded format flame graph tools take, one stack per line followed by its count.
+    Result<void, String> write_folded_stacks(const String& path) const;
+    size_t sampled_stack_count() const { return m_samples.size(); }
+
+    void reset();
+
+    // Logs a line per hook
+    void print_report() const;
+
+private:
+    static void count_hook(lua_State*, lua_Debug*);
+    void did_run_instructions(lua_State*);
+    // Once over budget, every instruction raises the error again until the hook or call that ran over has unwound, so
+    // that it can't be caught with pcall and carried on from
+    void start_enforcing_budget(lua_State*);
+    void stop_enforcing_budget();
+    void sample(lua_State*);
+
+    lua_State* m_state;
+    String m_plugin_name;
+
+    HashMap<String, Timing> m_timings;
+    Timing m_total;
+
+    // The outermost call into the plugin
+    size_t m_call_depth{};
+    String m_current_call;
+    u64 m_call_started_at{};
+    u64 m_call_cpu_started_at{};
+    u64 m_call_instructions{};
+    bool m_did_exceed_budget{};
+    bool m_is_over_budget{};
+
+    // The threads whose unwinding ends the outermost call and the outermost hook, which are the ones the budget error
+    // has to be raised in
+    lua_State* m_call_state{};
+    lua_State* m_hook_state{};
+    size_t m_hook_depth{};
+    u64 m_instructions_outside_hook{};
+
+    u64 m_instruction_budget{default_instruction_budget};
+    bool m_is_sampling{};
+
+    // Folded stacks to how many times they were sampled
+    HashMap<String, u64> m_samples;
+};
+}
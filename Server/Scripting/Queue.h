@@ -0,0 +1,166 @@
+/*
+ * Copyright (c) 2021, James Puleo <james@jame.xyz>
+ *
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#pragma once
+
+#include <AK/Array.h>
+#include <AK/Atomic.h>
+#include <AK/Noncopyable.h>
+#include <AK/Optional.h>
+#include <Server/Clock.h>
+
+namespace Scripting
+{
+// An unbounded queue that any number of threads can push to, and one thread pops from, without locks. This is Dmitry
+// Vyukov's intrusive MPSC queue: producers swap themselves in as the head, and the consumer follows the links from the
+// tail. The consumer may briefly see the queue as empty while a push is half done, which is fine, as every push is
+// followed by a wakeup.
+template<typename T>
+class MPSCQueue
+{
+    AK_MAKE_NONCOPYABLE(MPSCQueue);
+    AK_MAKE_NONMOVABLE(MPSCQueue);
+
+public:
+    MPSCQueue() : m_head(&m_stub), m_tail(&m_stub) {}
+
+    ~MPSCQueue()
+    {
+        while (pop().has_value())
+            ;
+        if (m_tail != &m_stub)
+            delete m_tail;
+    }
+
+    void push(T value)
+    {
+        auto* node = new Node;
+        node->value = move(value);
+
+        auto* previous = m_head.exchange(node, AK::MemoryOrder::memory_order_acq_rel);
+        previous->next.store(node, AK::MemoryOrder::memory_order_release);
+    }
+
+    // Only to be called from the consumer thread
+    Optional<T> pop()
+    {
+        auto* tail = m_tail;
+        auto* next = tail->next.load(AK::MemoryOrder::memory_order_acquire);
+        if (!next)
+            return {};
+
+        // The popped node becomes the new stub, so its value has to be moved out
+        T value = move(next->value);
+        m_tail = next;
+        if (tail != &m_stub)
+            delete tail;
+
+        return value;
+    }
+
+private:
+    struct Node
+    {
+        Atomic<Node*> next{nullptr};
+        T value{};
+    };
+
+    alignas(64) Atomic<Node*> m_head;
+    alignas(64) Node* m_tail;
+    Node m_stub;
+};
+
+// A bounded ring buffer for exactly one producer thread and one consumer thread.
+template<typename T, size_t Capacity>
+class SPSCQueue
+{
+    static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+    AK_MAKE_NONCOPYABLE(SPSCQueue);
+    AK_MAKE_NONMOVABLE(SPSCQueue);
+
+public:
+    SPSCQueue() = default;
+
+    // Only to be called from the producer thread. Returns false when the queue is full.
+    bool try_push(T&& value)
+    {
+        auto tail = m_tail.load(AK::MemoryOrder::memory_order_relaxed);
+        if (tail - m_head.load(AK::MemoryOrder::memory_order_acquire) == Capacity)
+            return false;
+
+        m_slots[tail & (Capacity - 1)] = move(value);
+        m_tail.store(tail + 1, AK::MemoryOrder::memory_order_release);
+        return true;
+    }
+
+    // Only to be called from the consumer thread
+    Optional<T> try_pop()
+    {
+        auto head = m_head.load(AK::MemoryOrder::memory_order_relaxed);
+        if (head == m_tail.load(AK::MemoryOrder::memory_order_acquire))
+            return {};
+
+        T value = move(m_slots[head & (Capacity - 1)]);
+        m_head.store(head + 1, AK::MemoryOrder::memory_order_release);
+        return value;
+    }
+
+private:
+    alignas(64) Atomic<size_t> m_head{0};
+    alignas(64) Atomic<size_t> m_tail{0};
+    Array<T, Capacity> m_slots;
+};
+
+// How much is waiting in a queue, and how long things wait there. Safe to read from any thread.
+struct QueueStatistics
+{
+    Atomic<u64> posted{0};
+    Atomic<u64> handled{0};
+    Atomic<u64> total_latency_nanoseconds{0};
+    Atomic<u64> max_latency_nanoseconds{0};
+
+    // Called before the message is pushed, so that it is never handled before it was counted
+    void did_post() { posted.fetch_add(1, AK::MemoryOrder::memory_order_relaxed); }
+
+    void did_handle(u64 posted_at)
+    {
+        auto latency = Clock::monotonic_nanoseconds() - posted_at;
+
+        handled.fetch_add(1, AK::MemoryOrder::memory_order_relaxed);
+        total_latency_nanoseconds.fetch_add(latency, AK::MemoryOrder::memory_order_relaxed);
+
+        auto max_latency = max_latency_nanoseconds.load(AK::MemoryOrder::memory_order_relaxed);
+        while (latency > max_latency &&
+               !max_latency_nanoseconds.compare_exchange_strong(max_latency, latency,
+                                                                AK::MemoryOrder::memory_order_relaxed))
+            ;
+    }
+
+    // Posts are counted before the message is pushed, but the counters are still read one after the other, so a
+    // message handled in between could make it look like more were handled than posted
+    u64 depth() const
+    {
+        auto handled_count = handled.load(AK::MemoryOrder::memory_order_relaxed);
+        auto posted_count = posted.load(AK::MemoryOrder::memory_order_relaxed);
+        return posted_count > handled_count ? posted_count - handled_count : 0;
+    }
+
+    double average_latency_milliseconds() const
+    {
+        auto handled_count = handled.load(AK::MemoryOrder::memory_order_relaxed);
+        if (handled_count == 0)
+            return 0;
+
+        return total_latency_nanoseconds.load(AK::MemoryOrder::memory_order_relaxed) / 1'000'000.0 / handled_count;
+    }
+
+    double max_latency_milliseconds() const
+    {
+        return max_latency_nanoseconds.load(AK::MemoryOrder::memory_order_relaxed) / 1'000'000.0;
+    }
+};
+}
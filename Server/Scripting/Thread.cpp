@@ -0,0 +1,400 @@
+/*
+ * Copyright (c) 2021, James Puleo <james@jame.xyz>
+ *
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#include <AK/Format.h>
+#include <Server/Clock.h>
+#include <Server/Scripting/Engine.h>
+#include <Server/Scripting/Thread.h>
+#include <errno.h>
+#include <poll.h>
+#include <sched.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace Scripting
+{
+static void wake(int fd)
+{
+    u64 value = 1;
+    [[maybe_unused]] auto rc = write(fd, &value, sizeof(value));
+}
+
+static void clear_wakeups(int fd)
+{
+    u64 value;
+    [[maybe_unused]] auto rc = read(fd, &value, sizeof(value));
+}
+
+static u64 now_milliseconds() { return Clock::monotonic_nanoseconds() / 1'000'000; }
+
+Thread::Thread(const Server& server, const Bus& bus, PacketWatches& packet_watches)
+    : m_server(server), m_bus(bus), m_packet_watches(packet_watches), m_timers(now_milliseconds())
+{
+    m_event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    m_action_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    VERIFY(m_event_fd >= 0 && m_action_fd >= 0);
+}
+
+Thread::~Thread()
+{
+    // Destroying an Engine answers whoever waits on its unfinished tasks, which stopping has us drop, as the I/O thread
+    // is done performing actions
+    stop();
+
+    // The Engines may still refer to our timers
+    m_plugins.clear();
+
+    close(m_event_fd);
+    close(m_action_fd);
+}
+
+Result<void, String> Thread::load_plugin(u32 plugin_index, String plugin_name, String path)
+{
+    VERIFY(!m_started);
+
+    // Kept even if it fails to load, so that it can be fixed and reloaded
+    m_plugins.append({plugin_index, move(plugin_name), move(path), make<HookSubscriberCounts>()});
+    auto& plugin = m_plugins.last();
+
+    auto engine = Engine::try_create(*this, m_server, plugin.index, plugin.name, plugin.path,
+                                     *plugin.hook_subscriber_counts);
+    if (engine.is_error())
+    {
+        plugin.failed_to_load = true;
+        return engine.release_error();
+    }
+
+    plugin.engine = engine.release_value();
+    return {};
+}
+
+void Thread::defer_plugin(u32 plugin_index, String plugin_name, String path, Vector<Hook> hooks)
+{
+    VERIFY(!m_started);
+
+    Plugin plugin{plugin_index, move(plugin_name), move(path), make<HookSubscriberCounts>()};
+    plugin.is_deferred = true;
+    for (auto hook : hooks)
+        plugin.serves_hooks[static_cast<size_t>(hook)] = true;
+
+    m_plugins.append(move(plugin));
+}
+
+bool Thread::has_subscribers(Hook hook) const
+{
+    for (auto& plugin : m_plugins)
+    {
+        auto index = static_cast<size_t>(hook);
+        if (plugin.serves_hooks[index] ||
+            (*plugin.hook_subscriber_counts)[index].load(AK::MemoryOrder::memory_order_relaxed) != 0)
+            return true;
+    }
+
+    return false;
+}
+
+static Optional<Hook> hook_for_event(Event::Type type)
+{
+    switch (type)
+    {
+        case Event::Type::RequestStatus:
+            return Hook::RequestStatus;
+        case Event::Type::RequestLogin:
+            return Hook::RequestLogin;
+        default:
+            return {};
+    }
+}
+
+void Thread::load_deferred_plugin(Plugin& plugin)
+{
+    auto started_at = Clock::monotonic_nanoseconds();
+    auto engine = Engine::try_create(*this, m_server, plugin.index, plugin.name, plugin.path,
+                                     *plugin.hook_subscriber_counts);
+    if (engine.is_error())
+    {
+        // Not tried again, so that a broken plugin doesn't cost us a load on every event
+        plugin.failed_to_load = true;
+        warnln("\u001b[31mFailed to load deferred plugin from path {}\u001b[0m", plugin.path);
+        warnln("\u001b[31m{}\u001b[0m", engine.error());
+        return;
+    }
+
+    plugin.engine = engine.release_value();
+    outln("\u001b[36mLoaded deferred plugin {} in {:.3f}ms\u001b[0m", plugin.path,
+          (Clock::monotonic_nanoseconds() - started_at) / 1'000'000.0);
+}
+
+void Thread::reload_plugins(StringView plugin_name)
+{
+    for (auto& plugin : m_plugins)
+    {
+        if (!plugin_name.is_empty() && plugin.name != plugin_name)
+            continue;
+
+        // It loads whatever is on disk once it is needed
+        if (plugin.is_deferred && !plugin.engine)
+        {
+            plugin.failed_to_load = false;
+            continue;
+        }
+
+        reload_plugin(plugin);
+    }
+}
+
+void Thread::reload_plugin(Plugin& plugin)
+{
+    // The running Engine goes on handling events until the new one is ready, as they both only run on this thread. A
+    // reload that fails leaves it running.
+    auto started_at = Clock::monotonic_nanoseconds();
+    auto engine = Engine::try_create(*this, m_server, plugin.index, plugin.name, plugin.path,
+                                     *plugin.hook_subscriber_counts);
+    if (engine.is_error())
+    {
+        warnln("\u001b[31mFailed to reload plugin from path {}\u001b[0m", plugin.path);
+        warnln("\u001b[31m{}\u001b[0m", engine.error());
+        return;
+    }
+
+    // Destroying the previous Engine cancels its timers, and drops its hooks from the subscriber counts
+    plugin.engine = engine.release_value();
+    plugin.failed_to_load = false;
+    outln("\u001b[36mReloaded plugin {} in {:.3f}ms\u001b[0m", plugin.path,
+          (Clock::monotonic_nanoseconds() - started_at) / 1'000'000.0);
+}
+
+void Thread::answer_request(const Plugin& plugin, Action::Type type, u64 request_id)
+{
+    Action action;
+    action.type = type;
+    action.request_id = request_id;
+    action.plugin_index = plugin.index;
+    post_action(move(action));
+}
+
+void Thread::track_client(const Event& event)
+{
+    switch (event.type)
+    {
+        case Event::Type::RequestStatus:
+        case Event::Type::RequestLogin:
+        case Event::Type::ClientSentPacket:
+            if (!m_clients.contains(event.client_id))
+                m_clients.set(event.client_id, false);
+            break;
+        case Event::Type::ClientConnectedToDestinationServer:
+            m_clients.set(event.client_id, true);
+            break;
+        case Event::Type::ClientDisconnected:
+            m_clients.remove(event.client_id);
+            break;
+        default:
+            break;
+    }
+}
+
+void Thread::start()
+{
+    VERIFY(!m_started);
+    auto rc = pthread_create(&m_thread, nullptr, thread_main, this);
+    VERIFY(rc == 0);
+    m_started = true;
+}
+
+void Thread::stop()
+{
+    // The I/O thread stops performing actions while it waits for us, so if we are waiting for room in a full action
+    // queue, we would never get to the Shutdown event. From here on, actions are dropped instead.
+    m_is_shutting_down.store(true, AK::MemoryOrder::memory_order_release);
+
+    if (!m_started)
+        return;
+
+    post_event({Event::Type::Shutdown});
+    pthread_join(m_thread, nullptr);
+    m_started = false;
+}
+
+void* Thread::thread_main(void* thread)
+{
+    reinterpret_cast<Thread*>(thread)->run();
+    return nullptr;
+}
+
+void Thread::run()
+{
+    while (true)
+    {
+        Vector<pollfd, 16> pollfds;
+        pollfds.append({m_event_fd, POLLIN, 0});
+        for (auto& watched_fd : m_watched_fds)
+            pollfds.append({watched_fd.key, watched_fd.value.events, 0});
+
+        // With garbage to collect, we only check whether anything is ready, and collect if nothing is
+        auto has_garbage_to_collect = false;
+        for (auto& plugin : m_plugins)
+        {
+            if (plugin.engine && plugin.engine->has_garbage_to_collect())
+            {
+                has_garbage_to_collect = true;
+                break;
+            }
+        }
+
+        auto ready_count = poll(pollfds.data(), pollfds.size(), has_garbage_to_collect ? 0 : poll_timeout());
+        if (ready_count < 0 && errno != EINTR)
+        {
+            perror("poll");
+            VERIFY_NOT_REACHED();
+        }
+
+        if (ready_count == 0 && has_garbage_to_collect)
+        {
+            collect_garbage(false);
+            fire_due_timers();
+            continue;
+        }
+
+        if (pollfds[0].revents & POLLIN)
+            clear_wakeups(m_event_fd);
+
+        // Callbacks may unwatch any fd, including ones that are ready too
+        for (size_t i = 1; i < pollfds.size(); i++)
+        {
+            if (pollfds[i].revents == 0)
+                continue;
+
+            auto watched_fd = m_watched_fds.find(pollfds[i].fd);
+            if (watched_fd == m_watched_fds.end())
+                continue;
+
+            auto callback = move(watched_fd->value.callback);
+            callback(pollfds[i].revents);
+
+            watched_fd = m_watched_fds.find(pollfds[i].fd);
+            if (watched_fd != m_watched_fds.end() && !watched_fd->value.callback)
+                watched_fd->value.callback = move(callback);
+        }
+
+        while (true)
+        {
+            auto event = m_events.pop();
+            if (!event.has_value())
+                break;
+
+            m_event_statistics.did_handle(event->posted_at);
+
+            if (event->type == Event::Type::Shutdown)
+                return;
+
+            if (event->type == Event::Type::ReloadPlugins)
+            {
+                reload_plugins(event->plugin_name);
+                continue;
+            }
+
+            track_client(*event);
+
+            auto hook = hook_for_event(event->type);
+            for (auto& plugin : m_plugins)
+            {
+                if (!plugin.engine && !plugin.failed_to_load && hook.has_value() &&
+                    plugin.serves_hooks[static_cast<size_t>(*hook)])
+                    load_deferred_plugin(plugin);
+
+                if (plugin.engine)
+                    plugin.engine->handle_event({}, *event);
+                else if (event->type == Event::Type::RequestStatus)
+                    answer_request(plugin, Action::Type::StatusResponse, event->request_id);
+                else if (event->type == Event::Type::RequestLogin)
+                    answer_request(plugin, Action::Type::LoginResponse, event->request_id);
+            }
+        }
+
+        fire_due_timers();
+        collect_garbage(true);
+    }
+}
+
+void Thread::collect_garbage(bool is_forced)
+{
+    for (auto& plugin : m_plugins)
+    {
+        if (!plugin.engine)
+            continue;
+
+        if (is_forced && plugin.engine->is_over_garbage_limit())
+            plugin.engine->collect_garbage({}, Engine::forced_garbage_collection_budget_nanoseconds, true);
+        else if (!is_forced && plugin.engine->has_garbage_to_collect())
+            plugin.engine->collect_garbage({}, Engine::idle_garbage_collection_budget_nanoseconds, false);
+    }
+}
+
+void Thread::post_event(Event event)
+{
+    event.posted_at = Clock::monotonic_nanoseconds();
+    m_event_statistics.did_post();
+    m_events.push(move(event));
+    wake(m_event_fd);
+}
+
+Optional<Action> Thread::pop_action()
+{
+    auto action = m_actions.try_pop();
+    if (action.has_value())
+        m_action_statistics.did_handle(action->posted_at);
+
+    return action;
+}
+
+void Thread::post_action(Action action)
+{
+    if (m_is_shutting_down.load(AK::MemoryOrder::memory_order_acquire))
+        return;
+
+    action.posted_at = Clock::monotonic_nanoseconds();
+    m_action_statistics.did_post();
+
+    // When the I/O thread falls this far behind, waiting for it is the only thing we can do, unless it is waiting for
+    // us to stop.
+    while (!m_actions.try_push(move(action)))
+    {
+        if (m_is_shutting_down.load(AK::MemoryOrder::memory_order_acquire))
+            return;
+
+        wake(m_action_fd);
+        sched_yield();
+    }
+
+    wake(m_action_fd);
+}
+
+u64 Thread::add_timer(u64 interval_milliseconds, Function<bool(u64)> callback)
+{
+    return m_timers.add(now_milliseconds(), interval_milliseconds, move(callback));
+}
+
+void Thread::remove_timer(u64 timer_id) { m_timers.remove(timer_id); }
+
+void Thread::watch_fd(int fd, short events, Function<void(short)> callback)
+{
+    m_watched_fds.set(fd, {events, move(callback)});
+}
+
+void Thread::unwatch_fd(int fd) { m_watched_fds.remove(fd); }
+
+void Thread::fire_due_timers() { m_timers.advance(now_milliseconds()); }
+
+int Thread::poll_timeout() const
+{
+    auto timeout = m_timers.milliseconds_until_next_tick(now_milliseconds());
+    if (!timeout.has_value())
+        return -1;
+
+    return static_cast<int>(min<u64>(*timeout, NumericLimits<int>::max()));
+}
+}
@@ -0,0 +1,238 @@
+/*
+ * Copyright (c) 2021, James Puleo <james@jame.xyz>
+ *
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#pragma once
+
+#include <AK/Array.h>
+#include <AK/Atomic.h>
+#include <AK/ByteBuffer.h>
+#include <AK/Function.h>
+#include <AK/HashMap.h>
+#include <AK/NonnullOwnPtr.h>
+#include <AK/OwnPtr.h>
+#include <AK/Result.h>
+#include <AK/String.h>
+#include <AK/Vector.h>
+#include <Server/Scripting/Queue.h>
+#include <Server/Scripting/TimingWheel.h>
+#include <pthread.h>
+
+class Server;
+
+namespace Scripting
+{
+class Bus;
+class Engine;
+class PacketWatches;
+
+// Hooks the server publishes itself, which it checks for subscribers before posting an event at all
+enum class Hook
+{
+    RequestStatus,
+    RequestLogin,
+    __Count
+};
+
+// How many functions one plugin has subscribed to each hook. These belong to the plugin's Thread rather than its
+// Engine, so that the I/O thread can go on reading them while the Engine is replaced.
+using HookSubscriberCounts = Array<Atomic<u32>, static_cast<size_t>(Hook::__Count)>;
+
+// Something that happened on the I/O thread, which scripts may want to know about. Nothing in here may be shared with
+// the I/O thread, which is why clients are referred to by their ID, and strings are deep copies (String's reference
+// count isn't atomic).
+struct Event
+{
+    enum class Type
+    {
+        RequestStatus,
+        RequestLogin,
+        ClientConnectedToDestinationServer,
+        ClientDisconnected,
+        BusMessage,
+        // A client sent a packet that a script was waiting for
+        ClientSentPacket,
+        // Every plugin logs its profile, and writes out its sampled stacks
+        DumpProfiles,
+        // Builds a fresh Engine for the plugin, or for every plugin if no name is given, and replaces the running one
+        // with it
+        ReloadPlugins,
+        Shutdown
+    };
+
+    Type type{Type::Shutdown};
+    u32 client_id{};
+    String username;
+    // Every plugin answers a status or login request, so the I/O thread can tell when it has all the answers
+    u64 request_id{};
+    // For packets clients sent, with the packet's data in message
+    i32 packet_id{};
+
+    // For bus messages
+    String channel;
+    u32 sender_index{};
+    String sender_name;
+    ByteBuffer message;
+
+    // For reloads
+    String plugin_name;
+
+    u64 posted_at{};
+};
+
+// Something a script asked the I/O thread to do. Packets are encoded on the scripting thread, so only bytes cross over.
+struct Action
+{
+    enum class Type
+    {
+        // Sends the frame to every client listed
+        Send,
+        // Sends the frame, which holds a Login::Clientbound::Disconnect, and disconnects the client
+        Disconnect,
+        // One plugin's answer to a status request, with the frame empty if it had nothing to say
+        StatusResponse,
+        // One plugin is done with a login request. Any disconnect it wanted has been posted before this.
+        LoginResponse,
+        // Has the I/O thread post a reload of the plugin to every thread, or of every plugin if no name is given
+        ReloadPlugins
+    };
+
+    Type type{Type::Send};
+    Vector<u32> client_ids;
+    // Already prefixed with its length
+    ByteBuffer frame;
+    i32 packet_id{};
+    Optional<u64> state_hash;
+    bool is_broadcast{};
+    u64 encode_nanoseconds{};
+    u64 request_id{};
+    u32 plugin_index{};
+    String plugin_name;
+    u64 posted_at{};
+};
+
+// One of the threads Lua runs on, so that slow scripts never hold up forwarding traffic. Each plugin has its own
+// Engine, and stays on the thread it was loaded onto. The thread waits on its own poll loop for events from the I/O
+// thread, other plugins and timers, and sends actions back, which the I/O thread is woken up for.
+class Thread
+{
+    AK_MAKE_NONCOPYABLE(Thread);
+    AK_MAKE_NONMOVABLE(Thread);
+
+public:
+    Thread(const Server&, const Bus&, PacketWatches&);
+
+    ~Thread();
+
+    // Only to be called before the thread is started, on the thread that creates it.
+    Result<void, String> load_plugin(u32 plugin_index, String plugin_name, String path);
+    // Has the plugin loaded on this thread the first time one of the hooks is published instead. Until then, the
+    // thread answers status requests for it.
+    void defer_plugin(u32 plugin_index, String plugin_name, String path, Vector<Hook> hooks);
+
+    void start();
+
+    // Waits for the thread to finish what it is doing and exit. Every thread has to be stopped before any of them are
+    // destroyed, as they can post bus messages to each other.
+    void stop();
+
+    // Including deferred plugins that haven't been loaded yet
+    size_t plugin_count() const { return m_plugins.size(); }
+
+    // Whether any plugin on this thread has subscribed to the hook. Safe to call from any thread.
+    bool has_subscribers(Hook) const;
+
+    const Bus& bus() const { return m_bus; }
+    // Shared with the I/O thread, and every other Thread
+    PacketWatches& packet_watches() { return m_packet_watches; }
+
+    // I/O thread side
+    void post_event(Event);
+    int action_notify_fd() const { return m_action_fd; }
+    // Call until empty whenever the notify fd becomes readable
+    Optional<Action> pop_action();
+
+    // Scripting thread side
+    void post_action(Action);
+
+    // Calls the callback with the timer's ID every interval, until it returns true.
+    u64 add_timer(u64 interval_milliseconds, Function<bool(u64 timer_id)> callback);
+    void remove_timer(u64 timer_id);
+
+    // Calls the callback whenever poll() says the fd is ready for any of the events, until it is unwatched.
+    void watch_fd(int fd, short events, Function<void(short revents)> callback);
+    void unwatch_fd(int fd);
+
+    // The clients the I/O thread has told this thread about, and whether each has been handed off to the destination
+    // server. An Engine that is loaded late, or reloaded, starts out knowing these.
+    const HashMap<u32, bool>& clients() const { return m_clients; }
+
+    const QueueStatistics& event_statistics() const { return m_event_statistics; }
+    const QueueStatistics& action_statistics() const { return m_action_statistics; }
+
+private:
+    struct Plugin
+    {
+        u32 index;
+        String name;
+        String path;
+        NonnullOwnPtr<HookSubscriberCounts> hook_subscriber_counts;
+        OwnPtr<Engine> engine;
+        bool is_deferred{};
+        // For deferred plugins, which are always treated as subscribed to these, whether they've been loaded or not
+        Array<bool, static_cast<size_t>(Hook::__Count)> serves_hooks{};
+        bool failed_to_load{};
+    };
+
+    static void* thread_main(void*);
+    void run();
+
+    void fire_due_timers();
+    int poll_timeout() const;
+
+    // Gives each Engine with garbage a step of its collector while the thread is idle, or, when forced, only those that
+    // can't wait for that any longer
+    void collect_garbage(bool is_forced);
+
+    void load_deferred_plugin(Plugin&);
+    // Only ever called between events, never while an Engine is running
+    void reload_plugins(StringView plugin_name);
+    void reload_plugin(Plugin&);
+    // Answers for a plugin that hasn't been loaded, or failed to, with nothing to say
+    void answer_request(const Plugin&, Action::Type, u64 request_id);
+
+    void track_client(const Event&);
+    HashMap<u32, bool> m_clients;
+
+    const Server& m_server;
+    const Bus& m_bus;
+    PacketWatches& m_packet_watches;
+    // The vector never changes once the thread has started, so the I/O thread can read the subscriber counts, but
+    // never the Engines, which are loaded and replaced on this thread.
+    Vector<Plugin> m_plugins;
+
+    MPSCQueue<Event> m_events;
+    QueueStatistics m_event_statistics;
+    int m_event_fd{-1};
+
+    SPSCQueue<Action, 1024> m_actions;
+    QueueStatistics m_action_statistics;
+    int m_action_fd{-1};
+
+    pthread_t m_thread{};
+    bool m_started{};
+    // Set by the I/O thread as it starts stopping us, after which actions are dropped
+    Atomic<bool> m_is_shutting_down{false};
+
+    TimingWheel m_timers;
+
+    struct WatchedFd
+    {
+        short events;
+        Function<void(short)> callback;
+    };
+    HashMap<int, WatchedFd> m_watched_fds;
+};
+}
@@ -0,0 +1,181 @@
+/*
+ * Copyright (c) 2021, James Puleo <james@jame.xyz>
+ *
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#include <Server/Scripting/TimingWheel.h>
+
+namespace Scripting
+{
+TimingWheel::TimingWheel(u64 now_milliseconds) : m_current_tick(now_milliseconds) {}
+
+TimingWheel::~TimingWheel() = default;
+
+u64 TimingWheel::add(u64 now_milliseconds, u64 interval_milliseconds, Callback callback)
+{
+    // Nothing is due while the wheel is empty, so it can skip ahead rather than tick through the idle time
+    if (m_timers.is_empty())
+        m_current_tick = max(m_current_tick, now_milliseconds);
+
+    auto timer_id = m_next_timer_id++;
+    auto timer = adopt_own(*new Timer{timer_id, interval_milliseconds, now_milliseconds + interval_milliseconds,
+                                      move(callback)});
+
+    insert(*timer, m_current_tick + 1);
+    m_timers.set(timer_id, move(timer));
+    return timer_id;
+}
+
+void TimingWheel::remove(u64 timer_id)
+{
+    if (m_firing_timer_id == timer_id)
+    {
+        m_firing_timer_was_removed = true;
+        return;
+    }
+
+    auto timer = m_timers.find(timer_id);
+    if (timer == m_timers.end())
+        return;
+
+    unlink(*timer->value);
+    m_timers.remove(timer);
+}
+
+void TimingWheel::insert(Timer& timer, u64 earliest_tick)
+{
+    auto deadline = max(timer.deadline, earliest_tick);
+    auto ticks_left = deadline - m_current_tick;
+
+    size_t level = 0;
+    while (level < level_count - 1 && ticks_left >= (1ull << (slot_bits * (level + 1))))
+        level++;
+
+    // Deadlines past what the top level covers go as far out as it can, and are put back when they are cascaded
+    if (level == level_count - 1 && ticks_left >= (1ull << (slot_bits * level_count)))
+        deadline = m_current_tick + (1ull << (slot_bits * level_count)) - 1;
+
+    auto& slot = m_slots[level][(deadline >> (slot_bits * level)) & slot_mask];
+
+    timer.previous = nullptr;
+    timer.next = slot;
+    timer.slot = &slot;
+    if (slot)
+        slot->previous = &timer;
+    slot = &timer;
+}
+
+void TimingWheel::unlink(Timer& timer)
+{
+    if (timer.previous)
+        timer.previous->next = timer.next;
+    else
+        *timer.slot = timer.next;
+
+    if (timer.next)
+        timer.next->previous = timer.previous;
+
+    timer.previous = nullptr;
+    timer.next = nullptr;
+    timer.slot = nullptr;
+}
+
+void TimingWheel::cascade(size_t level, size_t slot_index)
+{
+    auto* timer = m_slots[level][slot_index];
+    m_slots[level][slot_index] = nullptr;
+
+    while (timer)
+    {
+        auto* next = timer->next;
+        // This tick's slot of the first level hasn't fired yet, so timers due right now can still go in it
+        insert(*timer, m_current_tick);
+        timer = next;
+    }
+}
+
+void TimingWheel::tick()
+{
+    m_current_tick++;
+
+    // Cascade from the top down, so that timers coming down from one level are cascaded further right away, if their
+    // new slot is also due
+    for (size_t level = level_count - 1; level > 0; level--)
+    {
+        auto ticks_per_slot_below = 1ull << (slot_bits * level);
+        if ((m_current_tick & (ticks_per_slot_below - 1)) == 0)
+            cascade(level, (m_current_tick >> (slot_bits * level)) & slot_mask);
+    }
+
+    auto& slot = m_slots[0][m_current_tick & slot_mask];
+
+    // Callbacks may add and remove any timer, so only ever take the first one
+    while (slot)
+    {
+        auto& timer = *slot;
+        unlink(timer);
+
+        m_firing_timer_id = timer.id;
+        m_firing_timer_was_removed = false;
+        auto is_done = timer.callback(timer.id);
+        m_firing_timer_id = {};
+
+        if (is_done || m_firing_timer_was_removed)
+        {
+            m_timers.remove(timer.id);
+            continue;
+        }
+
+        // Periodic timers are due again an interval from when they were last due, so they don't drift
+        timer.deadline += timer.interval;
+        // After falling behind by more than an interval, skip the runs that were missed rather than catching up at once
+        if (timer.deadline <= m_current_tick)
+            timer.deadline = m_current_tick + timer.interval;
+        insert(timer, m_current_tick + 1);
+    }
+}
+
+void TimingWheel::advance(u64 now_milliseconds)
+{
+    if (m_timers.is_empty())
+    {
+        m_current_tick = max(m_current_tick, now_milliseconds);
+        return;
+    }
+
+    while (m_current_tick < now_milliseconds)
+        tick();
+}
+
+Optional<u64> TimingWheel::milliseconds_until_next_tick(u64 now_milliseconds) const
+{
+    if (m_timers.is_empty())
+        return {};
+
+    // Already behind
+    if (m_current_tick < now_milliseconds)
+        return 0;
+
+    // The first occupied slot of the first level is exactly when its timers are due. The slots of the levels above
+    // hold timers due no sooner than the slot is cascaded, so that is when to look again.
+    Optional<u64> next_tick;
+    for (size_t level = 0; level < level_count; level++)
+    {
+        auto current_slot = m_current_tick >> (slot_bits * level);
+        for (size_t offset = 1; offset <= slot_count; offset++)
+        {
+            if (!m_slots[level][(current_slot + offset) & slot_mask])
+                continue;
+
+            auto slot_start = (current_slot + offset) << (slot_bits * level);
+            if (!next_tick.has_value() || slot_start < *next_tick)
+                next_tick = slot_start;
+            break;
+        }
+    }
+
+    VERIFY(next_tick.has_value());
+    return *next_tick - now_milliseconds;
+}
+}
@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2021, James Puleo <james@jame.xyz>
+ *
+ * SPDX-License-Identifier: GPL-3.0-only
+ */
+
+#pragma once
+
+#include <AK/Array.h>
+#include <AK/Function.h>
+#include <AK/HashMap.h>
+#include <AK/NonnullOwnPtr.h>
+#include <AK/Noncopyable.h>
+#include <AK/Optional.h>
+
+namespace Scripting
+{
+// Hashed hierarchical timing wheel, ticking once a millisecond. Adding, removing and firing a timer are all O(1), no
+// matter how many timers there are.
+//
+// Each level has 256 slots, a slot of level n covering 256^n ticks. A timer goes in the lowest level that reaches its
+// deadline, and whenever the level below wraps around, the slot of the level above it that comes due is cascaded down,
+// each of its timers going into a finer slot, until they reach the first level and fire.
+class TimingWheel
+{
+    AK_MAKE_NONCOPYABLE(TimingWheel);
+    AK_MAKE_NONMOVABLE(TimingWheel);
+
+public:
+    // Called with the timer's ID, until it returns true
+    using Callback = Function<bool(u64 timer_id)>;
+
+    explicit TimingWheel(u64 now_milliseconds);
+
+    ~TimingWheel();
+
+    u64 add(u64 now_milliseconds, u64 interval_milliseconds, Callback);
+
+    void remove(u64 timer_id);
+
+    // Fires every timer that is due, in order of their deadlines, give or take a millisecond
+    void advance(u64 now_milliseconds);
+
+    // How long until advance() has anything to do, which may be before a timer is due, when a slot needs cascading.
+    // Empty if there are no timers at all.
+    Optional<u64> milliseconds_until_next_tick(u64 now_milliseconds) const;
+
+    size_t size() const { return m_timers.size(); }
+    bool is_empty() const { return m_timers.is_empty(); }
+
+private:
+    static constexpr size_t level_count = 4;
+    static constexpr size_t slot_bits = 8;
+    static constexpr size_t slot_count = 1 << slot_bits;
+    static constexpr u64 slot_mask = slot_count - 1;
+
+    struct Timer
+    {
+        u64 id;
+        u64 interval;
+        u64 deadline;
+        Callback callback;
+
+        Timer* previous{};
+        Timer* next{};
+        Timer** slot{};
+    };
+
+    // Timers due before the earliest tick go in its slot
+    void insert(Timer&, u64 earliest_tick);
+    static void unlink(Timer&);
+    void cascade(size_t level, size_t slot_index);
+    void tick();
+
+    Array<Array<Timer*, slot_count>, level_count> m_slots{};
+    HashMap<u64, NonnullOwnPtr<Timer>> m_timers;
+    u64 m_next_timer_id{1};
+    u64 m_current_tick;
+
+    // The timer whose callback is running, which is out of the wheel while it does
+    Optional<u64> m_firing_timer_id;
+    bool m_firing_timer_was_removed{};
+};
+}
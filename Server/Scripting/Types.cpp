@@ -4,88 +4,28 @@
  * SPDX-License-Identifier: GPL-3.0-only
  */
 
+#include <LibMinecraft/Net/Packets/Play/Clientbound/ChatMessage.h>
+#include <LibMinecraft/Net/Packets/Play/Clientbound/PlayerListHeaderAndFooter.h>
 #include <LibMinecraft/Net/Packets/Status/Clientbound/Response.h>
+#include <Server/Scripting/ComponentLibrary.h>
 #include <Server/Scripting/Lua.h>
 #include <Server/Scripting/Types.h>
 
 namespace Scripting
 {
-void Types::chat_component(lua_State* state, const Minecraft::Chat::Component& component)
+void Types::chat_component(lua_State* state, NonnullRefPtr<Minecraft::Chat::Component> component)
 {
-    lua_newtable(state);
-    if (component.is_bold().has_value())
-    {
-        lua_pushstring(state, "bold");
-        lua_pushboolean(state, *component.is_bold());
-        lua_settable(state, -3);
-    }
-
-    if (component.is_italic().has_value())
-    {
-        lua_pushstring(state, "italic");
-        lua_pushboolean(state, *component.is_italic());
-        lua_settable(state, -3);
-    }
-
-    if (component.is_underlined().has_value())
-    {
-        lua_pushstring(state, "underlined");
-        lua_pushboolean(state, *component.is_underlined());
-        lua_settable(state, -3);
-    }
-
-    if (component.has_strikethrough().has_value())
-    {
-        lua_pushstring(state, "strikethrough");
-        lua_pushboolean(state, *component.has_strikethrough());
-        lua_settable(state, -3);
-    }
-
-    if (component.is_obfuscated().has_value())
-    {
-        lua_pushstring(state, "obfuscated");
-        lua_pushboolean(state, *component.is_obfuscated());
-        lua_settable(state, -3);
-    }
-
-    if (component.font().has_value())
-    {
-        lua_pushstring(state, "font");
-        lua_pushstring(state, component.font()->characters());
-        lua_settable(state, -3);
-    }
-
-    if (component.color().has_value())
-    {
-        lua_pushstring(state, "color");
-        component.color()->visit(
-            [&](Minecraft::Chat::Component::NamedColor& named_color) {
-                lua_pushstring(state, Minecraft::Chat::Component::named_color_name_for_value(named_color).characters());
-            },
-            [&](Gfx::Color& color) { lua_pushinteger(state, color.value()); });
-        lua_settable(state, -3);
-    }
-
-    if (auto* text_component = dynamic_cast<const Minecraft::Chat::TextComponent*>(&component))
-    {
-        lua_pushstring(state, "text");
-        lua_pushstring(state, text_component->text().characters());
-        lua_settable(state, -3);
-    }
-    else if (auto* translation_component = dynamic_cast<const Minecraft::Chat::TranslationComponent*>(&component))
-    {
-        lua_pushstring(state, "translate");
-        lua_pushstring(state, translation_component->translation_key().characters());
-        lua_settable(state, -3);
-    }
-    else
-    {
-        VERIFY_NOT_REACHED();
-    }
+    ComponentLibrary::push(state, move(component));
 }
 
 NonnullRefPtr<Minecraft::Chat::Component> Types::chat_component(lua_State* state, int index)
 {
+    // Components built in Lua already hold a native component, so there is nothing to convert
+    if (auto component = ComponentLibrary::to_component(state, index))
+        return component.release_nonnull();
+
+    luaL_checktype(state, index, LUA_TTABLE);
+
     auto parse_base_component_values = [state, index](Minecraft::Chat::Component& component) {
         lua_pushstring(state, "bold");
         lua_gettable(state, index);
@@ -148,9 +88,6 @@ NonnullRefPtr<Minecraft::Chat::Component> Types::chat_component(lua_State* state
             lua_pushnil(state);
             while (lua_next(state, extra_index) != 0)
             {
-                if (!lua_istable(state, -1))
-                    luaL_error(state, "\"extra\" components must be a table");
-
                 component.append(chat_component(state, lua_gettop(state)));
 
                 lua_pop(state, 1);
@@ -205,12 +142,61 @@ Minecraft::Net::Packets::Status::Clientbound::Response::Data Types::status_reque
     lua_pop(state, 1);
 
     Minecraft::Net::Packets::Status::Clientbound::Response::Data data(description);
+    set_default_status_response_version(data);
+
+    // FIXME: There are more fields to parse here
+
+    return data;
+}
+
+void Types::set_default_status_response_version(Minecraft::Net::Packets::Status::Clientbound::Response::Data& data)
+{
     // FIXME: This is NOT where a constant like this should live.
     data.version.protocol = 756;
     data.version.name = "1.17.1";
+}
 
-    // FIXME: There are more fields to parse here
+NonnullOwnPtr<Minecraft::Net::Packet> Types::clientbound_play_packet(lua_State* state, int index)
+{
+    luaL_checktype(state, index, LUA_TTABLE);
 
-    return data;
+    auto optional_chat_component = [&](const char* name) -> NonnullRefPtr<Minecraft::Chat::Component> {
+        lua_getfield(state, index, name);
+        auto component = lua_isnil(state, -1) ? create<Minecraft::Chat::TextComponent>("")
+                                              : chat_component(state, lua_gettop(state));
+        lua_pop(state, 1);
+        return component;
+    };
+
+    lua_getfield(state, index, "type");
+    auto type = StringView(luaL_checkstring(state, -1));
+    lua_pop(state, 1);
+
+    if (type == "ChatMessage")
+    {
+        auto packet = make<Minecraft::Net::Packets::Play::Clientbound::ChatMessage>();
+
+        // Tables and Component userdata are both checked by chat_component()
+        lua_getfield(state, index, "message");
+        packet->set_message(chat_component(state, lua_gettop(state)));
+        lua_pop(state, 1);
+
+        lua_getfield(state, index, "position");
+        packet->set_position(luaL_optinteger(state, -1, 0));
+        lua_pop(state, 1);
+
+        return packet;
+    }
+
+    if (type == "PlayerListHeaderAndFooter")
+    {
+        auto packet = make<Minecraft::Net::Packets::Play::Clientbound::PlayerListHeaderAndFooter>();
+        packet->set_header(optional_chat_component("header"));
+        packet->set_footer(optional_chat_component("footer"));
+        return packet;
+    }
+
+    luaL_error(state, "\"%s\" is not a packet that can be sent", type.to_string().characters());
+    VERIFY_NOT_REACHED();
+}
 }
-}
\ No newline at end of file
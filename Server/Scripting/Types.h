@@ -6,7 +6,9 @@
 
 #pragma once
 
+#include <AK/NonnullOwnPtr.h>
 #include <LibMinecraft/Chat/Component.h>
+#include <LibMinecraft/Net/Packet.h>
 #include <LibMinecraft/Net/Packets/Status/Clientbound/Response.h>
 
 typedef struct lua_State lua_State;
@@ -16,11 +18,18 @@ namespace Scripting
 class Types
 {
 public:
-    static void chat_component(lua_State*, const Minecraft::Chat::Component&);
+    // Pushes a Component userdata, see ComponentLibrary
+    static void chat_component(lua_State*, NonnullRefPtr<Minecraft::Chat::Component>);
 
+    // Accepts either a Component userdata, or a table describing a component
     static NonnullRefPtr<Minecraft::Chat::Component> chat_component(lua_State*, int index);
 
     static Minecraft::Net::Packets::Status::Clientbound::Response::Data status_request_response_data(lua_State*,
                                                                                                      int index);
+
+    static void set_default_status_response_version(Minecraft::Net::Packets::Status::Clientbound::Response::Data&);
+
+    // Builds a clientbound Play packet from a table such as { type = "ChatMessage", message = { text = "Hi!" } }
+    static NonnullOwnPtr<Minecraft::Net::Packet> clientbound_play_packet(lua_State*, int index);
 };
 }
\ No newline at end of file
@@ -4,18 +4,22 @@
  * SPDX-License-Identifier: GPL-3.0-only
  */
 
+#include <Server/Clock.h>
 #include <Server/Server.h>
 
 Server::Server() : m_server(Core::TCPServer::construct())
 {
-    m_engine = make<Scripting::Engine>(*this);
+    m_filters.load_plugins();
+    m_scripting_host = make<Scripting::Host>(*this);
 
     m_server->on_ready_to_accept = [this] {
         auto maybe_socket = m_server->accept();
         if (!maybe_socket)
             return;
 
-        m_clients.append(make<Client>(maybe_socket.release_nonnull(), *this));
+        auto client_id = m_next_client_id++;
+        m_clients.append(make<Client>(maybe_socket.release_nonnull(), *this, client_id));
+        m_clients_by_id.set(client_id, &m_clients.last());
     };
 }
 
@@ -34,15 +38,125 @@ int Server::exec() { return m_event_loop.exec(); }
 
 void Server::client_did_disconnect(Badge<Client>, Client& who, Client::DisconnectReason)
 {
+    // Anything scripts still have queued up for this client is dropped from here on
+    m_clients_by_id.remove(who.id());
+    m_scripting_host->client_did_disconnect({}, who);
+
     deferred_invoke([this, &who](auto&) {
         m_clients.template remove_all_matching([&who](auto& client) { return client.ptr() == &who; });
     });
 }
 
-void Server::client_did_request_status(Badge<Client>, Client& who) { m_engine->client_did_request_status({}, who); }
+void Server::client_did_request_status(Badge<Client>, Client& who)
+{
+    m_scripting_host->client_did_request_status({}, who);
+}
 
 void Server::client_did_request_login(Badge<Client>, Client& who,
                                       Minecraft::Net::Packets::Login::Serverbound::LoginStart& packet)
 {
-    m_engine->client_did_request_login({}, who, packet);
+    m_scripting_host->client_did_request_login({}, who, packet);
+}
+
+void Server::client_did_connect_to_destination_server(Badge<Client>, Client& who)
+{
+    m_scripting_host->client_did_connect_to_destination_server({}, who);
+}
+
+void Server::client_did_receive_packet(Badge<Client>, Client& who, i32 packet_id, ReadonlyBytes bytes)
+{
+    m_scripting_host->client_did_receive_packet({}, who, packet_id, bytes);
+}
+
+void Server::client_did_forward_packet(Badge<Forwarder>, Client& who, i32 packet_id, ReadonlyBytes bytes)
+{
+    m_scripting_host->client_did_receive_packet({}, who, packet_id, bytes);
+}
+
+bool Server::is_watching_packets(const Client& who) const { return m_scripting_host->is_watching_packets(who.id()); }
+
+void Server::client_did_suppress_packet(Badge<Client>, Client&, size_t bytes)
+{
+    m_broadcast_statistics.packets_suppressed++;
+    m_broadcast_statistics.bytes_suppressed += bytes;
+}
+
+size_t Server::broadcast(const Minecraft::Net::Packet& packet, Function<bool(Client&)> filter)
+{
+    auto state_hash = packet.idempotent_state_hash();
+
+    // The filter may disconnect clients, so we don't call it while iterating the clients, and look each one up again
+    // once it has returned
+    Vector<u32> candidate_ids;
+    candidate_ids.ensure_capacity(m_clients_by_id.size());
+    for (auto& client : m_clients_by_id)
+    {
+        if (client.value->is_connected_to_destination_server())
+            candidate_ids.unchecked_append(client.key);
+    }
+
+    Vector<Client*> recipients;
+    for (auto client_id : candidate_ids)
+    {
+        auto* client = client_for_id(client_id);
+        if (!client)
+            continue;
+
+        if (filter && (!filter(*client) || !client_for_id(client_id)))
+            continue;
+
+        if (state_hash.has_value() && client->suppress_if_unchanged(packet.id(), *state_hash))
+            continue;
+
+        recipients.append(client);
+    }
+
+    // A later filter may have disconnected a client that an earlier one let through
+    recipients.remove_all_matching([&](auto* client) { return !client_for_id(client->id()); });
+
+    m_broadcast_statistics.broadcasts++;
+
+    if (recipients.is_empty())
+        return 0;
+
+    auto encode_start = Clock::monotonic_nanoseconds();
+    auto frame = Frame::encode(packet);
+    auto encode_time = Clock::monotonic_nanoseconds() - encode_start;
+
+    for (auto* client : recipients)
+    {
+        if (state_hash.has_value())
+            client->remember_sent_state(packet.id(), *state_hash, frame->size());
+
+        client->send(*frame);
+    }
+
+    record_broadcast(recipients.size(), frame->size(), encode_time);
+
+    return recipients.size();
+}
+
+void Server::did_broadcast(Badge<Scripting::Host>, size_t recipients, size_t frame_size, u64 encode_nanoseconds)
+{
+    m_broadcast_statistics.broadcasts++;
+
+    if (recipients != 0)
+        record_broadcast(recipients, frame_size, encode_nanoseconds);
+}
+
+void Server::record_broadcast(size_t recipients, size_t frame_size, u64 encode_nanoseconds)
+{
+    m_broadcast_statistics.frames_sent += recipients;
+    m_broadcast_statistics.bytes_sent += recipients * frame_size;
+    m_broadcast_statistics.bytes_not_reencoded += (recipients - 1) * frame_size;
+    m_broadcast_statistics.nanoseconds_saved += (recipients - 1) * encode_nanoseconds;
+}
+
+Client* Server::client_for_id(u32 id) const
+{
+    auto client = m_clients_by_id.find(id);
+    if (client == m_clients_by_id.end())
+        return nullptr;
+
+    return client->value;
 }
\ No newline at end of file
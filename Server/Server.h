@@ -6,13 +6,18 @@
 
 #pragma once
 
+#include <AK/Atomic.h>
+#include <AK/Function.h>
+#include <AK/HashMap.h>
 #include <AK/NonnullOwnPtrVector.h>
 #include <LibCore/EventLoop.h>
 #include <LibCore/Object.h>
 #include <LibCore/TCPServer.h>
 #include <LibMinecraft/Net/Packets/Login/Serverbound/LoginStart.h>
 #include <Server/Client.h>
-#include <Server/Scripting/Engine.h>
+#include <Server/Filters/Registry.h>
+#include <Server/Forwarder.h>
+#include <Server/Scripting/Host.h>
 
 class Server : public Core::Object
 {
@@ -30,9 +35,60 @@ public:
 
     void client_did_request_login(Badge<Client>, Client&, Minecraft::Net::Packets::Login::Serverbound::LoginStart&);
 
+    void client_did_connect_to_destination_server(Badge<Client>, Client&);
+
+    void client_did_receive_packet(Badge<Client>, Client&, i32 packet_id, ReadonlyBytes);
+
+    // For Play packets the client sent after it was handed off, when is_watching_packets() said we wanted them
+    void client_did_forward_packet(Badge<Forwarder>, Client&, i32 packet_id, ReadonlyBytes);
+
+    // Whether scripts are waiting for any packet from the client
+    bool is_watching_packets(const Client&) const;
+
+    void client_did_suppress_packet(Badge<Client>, Client&, size_t bytes);
+
+    // For broadcasts scripts have encoded on the scripting thread
+    void did_broadcast(Badge<Scripting::Host>, size_t recipients, size_t frame_size, u64 encode_nanoseconds);
+
+    // Written by the I/O thread, and read by scripts
+    struct BroadcastStatistics
+    {
+        Atomic<u64> broadcasts{0};
+        Atomic<u64> frames_sent{0};
+        Atomic<u64> bytes_sent{0};
+        // What sending the packet to each client separately would have cost on top of encoding it once: the bytes that
+        // would have been encoded again for every recipient after the first, and the time that would have taken. The
+        // bytes are still sent to every recipient.
+        Atomic<u64> bytes_not_reencoded{0};
+        Atomic<u64> nanoseconds_saved{0};
+        // Idempotent packets which weren't sent at all, as the client already had the same state
+        Atomic<u64> packets_suppressed{0};
+        Atomic<u64> bytes_suppressed{0};
+    };
+
+    // Encodes the packet once, and sends it to every client that is connected to a destination server and passes the
+    // filter. Idempotent packets are skipped for clients that already have the same state, and aren't encoded at all
+    // when every client does. Returns how many clients it was sent to.
+    //
+    // The filter may disconnect clients, including the one it is called with, which are then skipped.
+    size_t broadcast(const Minecraft::Net::Packet&, Function<bool(Client&)> filter = {});
+
+    const BroadcastStatistics& broadcast_statistics() const { return m_broadcast_statistics; }
+
+    // Returns null if the client has disconnected
+    Client* client_for_id(u32 id) const;
+
+    Filters::Registry& filters() { return m_filters; }
+
 private:
-    OwnPtr<Scripting::Engine> m_engine;
+    void record_broadcast(size_t recipients, size_t frame_size, u64 encode_nanoseconds);
+
+    Filters::Registry m_filters;
+    OwnPtr<Scripting::Host> m_scripting_host;
     NonnullRefPtr<Core::TCPServer> m_server;
     NonnullOwnPtrVector<Client> m_clients;
+    HashMap<u32, Client*> m_clients_by_id;
+    u32 m_next_client_id{1};
+    BroadcastStatistics m_broadcast_statistics;
     Core::EventLoop m_event_loop;
 };
\ No newline at end of file
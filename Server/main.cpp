@@ -4,12 +4,72 @@
  * SPDX-License-Identifier: GPL-3.0-only
  */
 
+#include <LibCore/File.h>
+#include <LibMinecraft/GlobalPalette.h>
+#include <Server/Clock.h>
 #include <Server/Server.h>
 
 static Server* s_server;
 
+static void load_global_palette()
+{
+    // The precompiled palette is generated from the data report the first time we start, and is much quicker to load.
+    // It is regenerated whenever the data report changes, or if it is deleted.
+    static const String precompiled_palette_path = "Data/blocks.palette";
+    static const String data_report_path = "Data/reports/blocks.json";
+
+    if (Core::File::exists(precompiled_palette_path))
+    {
+        // Without a data report, the precompiled palette is all we have
+        Optional<u64> data_report_hash;
+        if (Core::File::exists(data_report_path))
+        {
+            auto maybe_hash = Minecraft::GlobalPalette::hash_data_report(data_report_path);
+            if (!maybe_hash.is_error())
+                data_report_hash = maybe_hash.value();
+        }
+
+        auto maybe_palette = Minecraft::GlobalPalette::load_precompiled(precompiled_palette_path, data_report_hash);
+        if (!maybe_palette.is_error())
+        {
+            outln("Loaded global palette with {} states from {}", maybe_palette.value()->size(),
+                  precompiled_palette_path);
+            Minecraft::GlobalPalette::install(maybe_palette.release_value());
+            return;
+        }
+
+        warnln("Failed to load precompiled global palette: {}", maybe_palette.error());
+    }
+
+    if (!Core::File::exists(data_report_path))
+    {
+        warnln("No block data report found, not loading the global palette.");
+        return;
+    }
+
+    auto maybe_palette = Minecraft::GlobalPalette::load_from_data_report(data_report_path);
+    if (maybe_palette.is_error())
+    {
+        warnln("Failed to load global palette: {}", maybe_palette.error());
+        return;
+    }
+
+    outln("Loaded global palette with {} states from {}", maybe_palette.value()->size(), data_report_path);
+
+    auto written = maybe_palette.value()->write_precompiled(precompiled_palette_path);
+    if (written.is_error())
+        warnln("Failed to write precompiled global palette: {}", written.error());
+
+    Minecraft::GlobalPalette::install(maybe_palette.release_value());
+}
+
 int main(int, char**)
 {
+    // Restarts are only over once we accept connections again, so keep an eye on this
+    auto started_at = Clock::monotonic_nanoseconds();
+
+    load_global_palette();
+
     s_server = new Server;
 
     if (!s_server->listen())
@@ -18,5 +78,7 @@ int main(int, char**)
         return 1;
     }
 
+    outln("Accepting connections {:.3f}ms after starting", (Clock::monotonic_nanoseconds() - started_at) / 1'000'000.0);
+
     return s_server->exec();
-}
\ No newline at end of file
+}